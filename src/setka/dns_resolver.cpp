@@ -2,10 +2,10 @@
 #include <list>
 #include <cstring>
 #include <memory>
+#include <vector>
 
 #include <utki/config.hpp>
 #include <utki/types.hpp>
-#include <utki/time.hpp>
 
 #include <nitki/thread.hpp>
 #include <nitki/queue.hpp>
@@ -19,6 +19,7 @@
 #include "dns_resolver.hpp"
 #include "udp_socket.hpp"
 #include "init_guard.hpp"
+#include "timer_wheel.hpp"
 
 using namespace setka;
 
@@ -68,9 +69,6 @@ std::string ParseHostNameFromDNSPacket(const uint8_t* & p, const uint8_t* end){
 // this mutex is used to protect the dns::thread access.
 std::mutex mutex;
 
-typedef std::multimap<uint32_t, Resolver*> T_ResolversTimeMap;
-typedef T_ResolversTimeMap::iterator T_ResolversTimeIter;
-
 typedef std::map<uint16_t, Resolver*> T_IdMap;
 typedef T_IdMap::iterator T_IdIter;
 
@@ -86,9 +84,10 @@ struct Resolver{
 	std::string hostName; // host name to resolve
 	
 	uint16_t recordType; // type of DNS record to get
+
+	bool fallbackToA; // whether to try getting record type A if there is no record type AAAA
 	
-	T_ResolversTimeMap* timeMap;
-	T_ResolversTimeIter timeMapIter;
+	setka::timer deadline;
 	
 	uint16_t id;
 	T_IdIter idIter;
@@ -102,8 +101,6 @@ class LookupThread : public nitki::thread{
 	setka::udp_socket socket;
 	opros::wait_set waitSet;
 	
-	T_ResolversTimeMap resolversByTime1, resolversByTime2;
-	
 public:
 	volatile bool quitFlag = false;
 	nitki::queue queue;
@@ -121,13 +118,11 @@ public:
 	// a new thread.
 	volatile bool isExiting = true; // initially the thread is not running, so set to true
 	
-	// This variable is for detecting system clock ticks warp around.
-	// True if last call to ting::GetTicks() returned value in first half.
-	// False otherwise.
-	bool lastTicksInFirstHalf;
+	// timeouts of the requests
+	setka::timer_wheel timers;
 	
-	T_ResolversTimeMap* timeMap1;
-	T_ResolversTimeMap* timeMap2;
+	// resolvers whose timeouts have expired, filled by the timer handlers
+	std::vector<dns_resolver*> timedOutResolvers;
 	
 	T_RequestsToSendList sendList;
 	
@@ -482,9 +477,7 @@ public:
 	
 public:
 	LookupThread() :
-			waitSet(2),
-			timeMap1(&resolversByTime1),
-			timeMap2(&resolversByTime2)
+			waitSet(2)
 	{
 		ASSERT_INFO(setka::init_guard::is_created(), "ting::net::Lib is not initialized before doing the DNS request")
 	}
@@ -492,8 +485,7 @@ public:
 	~LookupThread()noexcept{
 		ASSERT(this->sendList.size() == 0)
 		ASSERT(this->resolversMap.size() == 0)
-		ASSERT(this->resolversByTime1.size() == 0)
-		ASSERT(this->resolversByTime2.size() == 0)
+		ASSERT(this->timers.size() == 0)
 		ASSERT(this->idMap.size() == 0)		
 	}
 	
@@ -518,7 +510,7 @@ public:
 			this->sendList.erase(r->sendIter);
 		}
 
-		r->timeMap->erase(r->timeMapIter);
+		this->timers.disarm(r->deadline);
 
 		this->idMap.erase(r->idIter);
 		
@@ -726,7 +718,7 @@ private:
 								if(host == i->second->hostName){
 									ParseResult res = this->ParseReplyFromDNS(i->second, utki::span<uint8_t>(&*buf.begin(), ret));
 									
-									if(res.result == setka::dns_result::not_found && i->second->recordType == D_DNSRecordAAAA){
+									if(res.result == setka::dns_result::not_found && i->second->recordType == D_DNSRecordAAAA && i->second->fallbackToA){
 										// try getting record type A
 										TRACE(<< "no record AAAA found, trying to get record type A" << std::endl)
 										
@@ -816,37 +808,29 @@ private:
 					}
 				}
 				
-				uint32_t curTime = utki::get_ticks_ms();
-				{ // check if time has wrapped around and it is necessary to swap time maps
-					bool isFirstHalf = curTime < (uint32_t(-1) / 2);
-					if(isFirstHalf && !this->lastTicksInFirstHalf){
-						// Time wrapped.
-						// Timeout all requests from first time map
-						while(this->timeMap1->size() != 0){
-							std::unique_ptr<dns::Resolver> r = this->RemoveResolver(this->timeMap1->begin()->second->hnr);
-							ASSERT(r)
-
-							// Notify about timeout.
-							this->CallCallback(r.operator->(), dns_result::timeout, 0);
+				// The timer handlers only collect the timed out resolvers, because the timer is a part of the resolver
+				// and it cannot be destroyed from within its handler.
+				this->timers.advance();
+				
+				{
+					std::vector<dns_resolver*> timedOut;
+					std::swap(timedOut, this->timedOutResolvers);
+					
+					for(auto hnr : timedOut){
+						// the mutex is unlocked while calling the callback, so the request could have been canceled
+						// or restarted meanwhile
+						T_ResolversIter i = this->resolversMap.find(hnr);
+						if(i == this->resolversMap.end() || i->second->deadline.is_armed()){
+							continue;
 						}
 						
-						ASSERT(this->timeMap1->size() == 0)
-						std::swap(this->timeMap1, this->timeMap2);
-					}
-					this->lastTicksInFirstHalf = isFirstHalf;
-				}
-				
-				while(this->timeMap1->size() != 0){
-					if(this->timeMap1->begin()->first > curTime){
-						break;
+						// timeout
+						std::unique_ptr<dns::Resolver> r = this->RemoveResolver(hnr);
+						ASSERT(r)
+						
+						// Notify about timeout. OnCompleted_ts() does not throw any exceptions, so no worries about that.
+						this->CallCallback(r.operator->(), dns_result::timeout, 0);
 					}
-					
-					// timeout
-					std::unique_ptr<dns::Resolver> r = this->RemoveResolver(this->timeMap1->begin()->second->hnr);
-					ASSERT(r)
-					
-					// Notify about timeout. OnCompleted_ts() does not throw any exceptions, so no worries about that.
-					this->CallCallback(r.operator->(), dns_result::timeout, 0);
 				}
 				
 				if(this->resolversMap.size() == 0){
@@ -854,18 +838,11 @@ private:
 					break; // exit thread
 				}
 				
-				ASSERT(this->timeMap1->size() > 0)
-				ASSERT(this->timeMap1->begin()->first > curTime)
+				ASSERT(this->timers.size() > 0)
 				
-//				TRACE(<< "DNS thread: curTime = " << curTime << std::endl)
-//				TRACE(<< "DNS thread: this->timeMap1->begin()->first = " << (this->timeMap1->begin()->first) << std::endl)
-				
-				timeout = this->timeMap1->begin()->first - curTime;
+				timeout = this->timers.get_time_to_next_expiry();
 			}
 			
-			// Make sure that ting::GetTicks is called at least 4 times per full time warp around cycle.
-			timeout = std::min(timeout, uint32_t(-1) / 4); // clamp top
-			
 // Workaround for strange bug on Win32 (reproduced on WinXP at least).
 // For some reason waiting for WRITE on UDP socket does not work. It hangs in the
 // Wait() method until timeout is hit. So, just check every 100ms if it is OK to write to UDP socket.
@@ -917,7 +894,7 @@ dns_resolver::~dns_resolver(){
 #endif
 }
 
-void dns_resolver::resolve(const std::string& hostName, uint32_t timeoutMillis, const setka::address& dnsIP){
+void dns_resolver::resolve(const std::string& hostName, uint32_t timeoutMillis, const setka::address& dnsIP, ip_version version){
 //	TRACE(<< "dns_resolver::Resolve_ts(): enter" << std::endl)
 	
 	ASSERT(setka::init_guard::is_created())
@@ -958,6 +935,7 @@ void dns_resolver::resolve(const std::string& hostName, uint32_t timeoutMillis,
 	r->hnr = this;
 	r->hostName = hostName;
 	r->dns = dnsIP;
+	r->fallbackToA = version == ip_version::any;
 	
 #if M_OS == M_OS_WINDOWS
 	// check OS version, if WinXP then start from record A, since setka does not support IPv6 on WinXP
@@ -986,13 +964,13 @@ void dns_resolver::resolve(const std::string& hostName, uint32_t timeoutMillis,
 
 			// Windows version is WinXP or before
 
-			r->recordType = D_DNSRecordA;
+			r->recordType = version == ip_version::v6 ? D_DNSRecordAAAA : D_DNSRecordA;
 		}else{
-			r->recordType = D_DNSRecordAAAA; // start with IPv6 first
+			r->recordType = version == ip_version::v4 ? D_DNSRecordA : D_DNSRecordAAAA; // start with IPv6 first
 		}
 	}
 #else
-	r->recordType = D_DNSRecordAAAA; // start with IPv6 first
+	r->recordType = version == ip_version::v4 ? D_DNSRecordA : D_DNSRecordAAAA; // start with IPv6 first
 #endif
 	
 	std::lock_guard<decltype(dns::thread->mutex)> mutexGuard2(dns::thread->mutex);
@@ -1006,30 +984,19 @@ void dns_resolver::resolve(const std::string& hostName, uint32_t timeoutMillis,
 		r->idIter = res.first;
 	}
 	
-	// calculate time
-	uint32_t curTime = utki::get_ticks_ms();
+	// arm the timeout timer, destroying the resolver disarms it
 	{
-		uint32_t endTime = curTime + timeoutMillis;
-//		TRACE(<< "dns_resolver::Resolve_ts(): curTime = " << curTime << std::endl)
-//		TRACE(<< "dns_resolver::Resolve_ts(): endTime = " << endTime << std::endl)
-		if(endTime < curTime){ // if warped around
-			r->timeMap = dns::thread->timeMap2;
-		}else{
-			r->timeMap = dns::thread->timeMap1;
-		}
-		try{
-			r->timeMapIter = r->timeMap->insert(std::pair<uint32_t, dns::Resolver*>(endTime, r.operator->()));
-		}catch(...){
-			dns::thread->idMap.erase(r->idIter);
-			throw;
-		}
+		dns::LookupThread* t = dns::thread.get();
+		r->deadline.handler = [t, hnr = this](){
+			t->timedOutResolvers.push_back(hnr);
+		};
+		t->timers.arm(r->deadline, timeoutMillis);
 	}
 	
 	// add resolver to send queue
 	try{
 		dns::thread->sendList.push_back(r.operator->());
 	}catch(...){
-		r->timeMap->erase(r->timeMapIter);
 		dns::thread->idMap.erase(r->idIter);
 		throw;
 	}
@@ -1051,7 +1018,6 @@ void dns_resolver::resolve(const std::string& hostName, uint32_t timeoutMillis,
 
 		// Start the thread if we created the new one.
 		if(needStartTheThread){
-			dns::thread->lastTicksInFirstHalf = curTime < (uint32_t(-1) / 2);
 			dns::thread->start();
 			dns::thread->isExiting = false; // thread has just started, clear the exiting flag
 			TRACE(<< "dns_resolver::Resolve_ts(): thread started" << std::endl)
@@ -1059,7 +1025,6 @@ void dns_resolver::resolve(const std::string& hostName, uint32_t timeoutMillis,
 	}catch(...){
 		dns::thread->resolversMap.erase(this);
 		dns::thread->sendList.pop_back();
-		r->timeMap->erase(r->timeMapIter);
 		dns::thread->idMap.erase(r->idIter);
 		throw;
 	}
@@ -43,6 +43,27 @@ enum class dns_result{
 	error
 };
 
+/**
+ * @brief Enumeration of IP versions.
+ */
+enum class ip_version{
+	/**
+	 * @brief Any IP version.
+	 * For DNS lookup it means that IPv6 address is preferred, and IPv4 address is looked up if there is no IPv6 one.
+	 */
+	any,
+
+	/**
+	 * @brief IPv4 only.
+	 */
+	v4,
+
+	/**
+	 * @brief IPv6 only.
+	 */
+	v6
+};
+
 /**
  * @brief Class for resolving IP-address of the host by its domain name.
  * This class allows asynchronous DNS lookup.
@@ -72,6 +93,7 @@ public:
      * @param timeoutMillis - timeout for waiting for DNS server response in milliseconds.
 	 * @param dnsIP - IP-address of the DNS to use for host name resolving. The default value is invalid IP-address
 	 *                in which case the DNS IP-address will be retrieved from underlying OS.
+	 * @param version - version of IP-address to look up.
 	 * @throw std::logic_error when supplied for resolution domain name is too long. Must be 253 characters at most.
 	 * @throw std::logic_error when DNS lookup operation served by this resolver object is already in progress.
 	 * @throw too_many_requests when there are too much active DNS lookup requests are in progress, no resources for another one.
@@ -79,7 +101,8 @@ public:
 	void resolve(
 			const std::string& hostName,
 			uint32_t timeoutMillis = 20000,
-			const setka::address& dnsIP = setka::address(setka::address::ip(0), 0)
+			const setka::address& dnsIP = setka::address(setka::address::ip(0), 0),
+			ip_version version = ip_version::any
 		);
 	
 	/**
@@ -0,0 +1,687 @@
+#pragma once
+
+// the coroutines are only available when compiling as C++20 or later
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <utki/config.hpp>
+#include <utki/span.hpp>
+
+#include "reactor.hpp"
+#include "timer_wheel.hpp"
+#include "tcp_socket.hpp"
+#include "tcp_server_socket.hpp"
+#include "dns_resolver.hpp"
+
+namespace setka{
+
+/**
+ * @brief Coroutine started by the user.
+ * The coroutine starts executing right away when called and runs until its first suspension.
+ * Then it is resumed by the event_loop when the operation it awaits completes.
+ * The task object owns the coroutine, destroying the task destroys the coroutine.
+ */
+class task{
+public:
+	struct promise_type{
+		std::exception_ptr exception;
+
+		task get_return_object()noexcept{
+			return task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+
+		std::suspend_never initial_suspend()noexcept{
+			return {};
+		}
+
+		std::suspend_always final_suspend()noexcept{
+			return {};
+		}
+
+		void return_void()noexcept{}
+
+		void unhandled_exception()noexcept{
+			this->exception = std::current_exception();
+		}
+	};
+
+private:
+	std::coroutine_handle<promise_type> handle;
+
+	task(std::coroutine_handle<promise_type> handle)noexcept :
+			handle(handle)
+	{}
+
+public:
+	task(const task&) = delete;
+	task& operator=(const task&) = delete;
+
+	task(task&& t)noexcept :
+			handle(t.handle)
+	{
+		t.handle = nullptr;
+	}
+
+	task& operator=(task&& t)noexcept{
+		std::swap(this->handle, t.handle);
+		return *this;
+	}
+
+	/**
+	 * @brief Destroy the coroutine.
+	 * The coroutine must not be suspended on an event_loop operation, i.e. it has to be finished.
+	 */
+	~task()noexcept{
+		if(this->handle){
+			this->handle.destroy();
+		}
+	}
+
+	/**
+	 * @brief Check if the coroutine has finished.
+	 * @return true if the coroutine has returned or has thrown an exception.
+	 * @return false otherwise.
+	 */
+	bool is_done()const noexcept{
+		return !this->handle || this->handle.done();
+	}
+
+	/**
+	 * @brief Rethrow the exception thrown by the coroutine, if any.
+	 */
+	void get()const{
+		if(this->handle && this->handle.promise().exception){
+			std::rethrow_exception(this->handle.promise().exception);
+		}
+	}
+};
+
+/**
+ * @brief Result of DNS lookup.
+ */
+struct dns_lookup_result{
+	dns_result result;
+
+	/**
+	 * @brief Resolved IP address.
+	 * Only valid if result is dns_result::ok.
+	 */
+	address::ip ip;
+};
+
+/**
+ * @brief Event loop for coroutines.
+ * Allows writing non-blocking socket code as C++20 coroutines, e.g. 'size_t n = co_await loop.async_recieve(sock, buf);'.
+ * The operations are first tried right away and the coroutine is only suspended if the operation would block.
+ * Suspended coroutines are resumed from within run_once() when the operations complete.
+ * Awaiting an operation does not allocate memory, the state of the operation is stored in the coroutine frame.
+ *
+ * The event loop is built on top of the reactor, so the sockets have to be attached to the event loop before
+ * awaiting operations on them. At most one reading operation (recieve or accept) and one writing operation
+ * (send or connect) can be awaited on a socket at a time.
+ * The socket operations can be given a timeout, if the operation does not complete in time, then awaiting it
+ * throws std::system_error with std::errc::timed_out error code. The timeouts are served by the timer wheel
+ * of the underlying reactor.
+ * The coroutine awaiting an operation must not be destroyed until the operation completes.
+ * The event loop is not thread-safe, all its methods must be called from the same thread.
+ * Only available when compiling as C++20 or later.
+ */
+class event_loop{
+	class awaiter{
+		friend class event_loop;
+
+		event_loop& loop;
+		bool write;
+
+		uint32_t timeout_ms;
+		timer deadline;
+
+		std::exception_ptr exception;
+		std::coroutine_handle<> handle;
+
+	protected:
+		socket& s;
+
+		awaiter(event_loop& loop, socket& s, bool write, uint32_t timeout_ms) :
+				loop(loop),
+				write(write),
+				timeout_ms(timeout_ms),
+				deadline([this](){
+					this->loop.on_timeout(*this);
+				}),
+				s(s)
+		{}
+
+		// returns true if the operation has completed
+		virtual bool try_complete() = 0;
+
+		void check()const{
+			if(this->exception){
+				std::rethrow_exception(this->exception);
+			}
+		}
+
+	public:
+		awaiter(const awaiter&) = delete;
+		awaiter& operator=(const awaiter&) = delete;
+
+		virtual ~awaiter()noexcept{}
+
+		bool await_ready(){
+			return this->try_complete();
+		}
+
+		void await_suspend(std::coroutine_handle<> h){
+			this->handle = h;
+			this->loop.suspend(*this);
+		}
+	};
+
+	struct record{
+		socket& s;
+		awaiter* reader = nullptr;
+		awaiter* writer = nullptr;
+
+		record(socket& s) :
+				s(s)
+		{}
+	};
+
+	reactor r;
+
+	std::unordered_map<const socket*, record> records;
+
+	unsigned num_lookups = 0;
+
+	// coroutines to resume after the reactor iteration, e.g. the ones whose operations have timed out
+	std::vector<std::coroutine_handle<>> resumable;
+	std::vector<std::coroutine_handle<>> resuming;
+
+	record& get_record(const socket& s){
+		auto i = this->records.find(&s);
+		if(i == this->records.end()){
+			throw std::logic_error("event_loop: socket is not attached to the event loop");
+		}
+		return i->second;
+	}
+
+	void suspend(awaiter& a){
+		record& rec = this->get_record(a.s);
+
+		awaiter*& w = a.write ? rec.writer : rec.reader;
+		if(w){
+			throw std::logic_error("event_loop: another operation of the same direction is already awaited on the socket");
+		}
+		w = &a;
+
+		if(a.write){
+			this->r.set_write_interest(a.s, true);
+		}else{
+			this->r.set_read_interest(a.s, true);
+		}
+
+		if(a.timeout_ms != 0){
+			this->r.get_timers().arm(a.deadline, a.timeout_ms);
+		}
+	}
+
+	void on_timeout(awaiter& a){
+		record& rec = this->get_record(a.s);
+
+		awaiter*& w = a.write ? rec.writer : rec.reader;
+		ASSERT(w == &a)
+		w = nullptr;
+		if(a.write){
+			this->r.set_write_interest(rec.s, false);
+		}else{
+			this->r.set_read_interest(rec.s, false);
+		}
+
+		a.exception = std::make_exception_ptr(std::system_error(std::make_error_code(std::errc::timed_out), "operation timed out"));
+
+		// resuming the coroutine destroys the awaiter along with the timer, so resume it after the timer handler returns
+		this->resumable.push_back(a.handle);
+	}
+
+	bool on_ready(record& rec, bool write){
+		awaiter*& w = write ? rec.writer : rec.reader;
+		if(!w){
+			return true;
+		}
+
+		awaiter& a = *w;
+		try{
+			if(!a.try_complete()){
+				return true;
+			}
+		}catch(...){
+			a.exception = std::current_exception();
+		}
+
+		w = nullptr;
+		if(write){
+			this->r.set_write_interest(rec.s, false);
+		}else{
+			this->r.set_read_interest(rec.s, false);
+		}
+		this->r.get_timers().disarm(a.deadline);
+
+		// the coroutine can detach the socket, so don't touch the record after resuming
+		a.handle.resume();
+		return false;
+	}
+
+public:
+	/**
+	 * @brief Create event loop.
+	 * @param capacity - capacity of the underlying reactor, see reactor::reactor().
+	 */
+	event_loop(unsigned capacity = 1024) :
+			r(capacity)
+	{}
+
+	event_loop(const event_loop&) = delete;
+	event_loop& operator=(const event_loop&) = delete;
+
+	~event_loop()noexcept{
+		ASSERT_INFO(this->records.empty(), "event_loop::~event_loop(): some sockets are still attached")
+		ASSERT_INFO(this->num_lookups == 0, "event_loop::~event_loop(): some DNS lookups are still in progress")
+	}
+
+	/**
+	 * @brief Get underlying reactor.
+	 * The reactor can be used to serve sockets with plain handlers along with the coroutines.
+	 * @return reactor of the event loop.
+	 */
+	reactor& get_reactor()noexcept{
+		return this->r;
+	}
+
+	/**
+	 * @brief Attach socket to the event loop.
+	 * Adds the socket to the reactor of the event loop.
+	 * @param s - socket to attach.
+	 */
+	void attach(socket& s){
+		if(this->records.find(&s) != this->records.end()){
+			throw std::logic_error("event_loop::attach(): socket is already attached");
+		}
+
+		auto i = this->records.emplace(&s, record(s)).first;
+		record* rec = &i->second;
+
+		try{
+			this->r.add(
+					s,
+					[this, rec](){
+						return this->on_ready(*rec, false);
+					},
+					[this, rec](){
+						return this->on_ready(*rec, true);
+					}
+				);
+			this->r.set_read_interest(s, false);
+		}catch(...){
+			this->r.remove(s);
+			this->records.erase(i);
+			throw;
+		}
+	}
+
+	/**
+	 * @brief Detach socket from the event loop.
+	 * No operations must be awaited on the socket.
+	 * @param s - socket to detach.
+	 */
+	void detach(socket& s)noexcept{
+		auto i = this->records.find(&s);
+		if(i == this->records.end()){
+			return;
+		}
+		ASSERT_INFO(!i->second.reader && !i->second.writer, "event_loop::detach(): some operations are still awaited on the socket")
+
+		this->r.remove(s);
+		this->records.erase(i);
+	}
+
+	/**
+	 * @brief Run one iteration of the event loop.
+	 * Waits for readiness of the sockets and resumes the coroutines whose operations have completed or timed out.
+	 * @param timeout_ms - maximum time to wait, in milliseconds.
+	 * @return number of sockets, DNS lookups and timers served.
+	 */
+	unsigned run_once(uint32_t timeout_ms){
+		unsigned ret = this->r.run_once(this->resumable.empty() ? timeout_ms : 0);
+
+		std::swap(this->resuming, this->resumable);
+		for(auto& h : this->resuming){
+			h.resume();
+		}
+		this->resuming.clear();
+
+		return ret;
+	}
+
+	/**
+	 * @brief Awaitable receiving of data.
+	 * Awaiting returns the number of bytes received, 0 means that the connection was closed by peer.
+	 * Throws std::system_error in case of error.
+	 */
+	class recieve_awaitable : public awaiter{
+		friend class event_loop;
+
+		utki::span<uint8_t> buf;
+		size_t num_bytes;
+
+		recieve_awaitable(event_loop& loop, tcp_socket& s, utki::span<uint8_t> buf, uint32_t timeout_ms) :
+				awaiter(loop, s, false, timeout_ms),
+				buf(buf)
+		{}
+
+		// tcp_socket::recieve() reports both "no data available" and "connection closed" as 0 bytes received,
+		// so call recv() directly to tell them apart without extra system calls
+		bool try_complete()override{
+			// same as tcp_socket::recieve(), clear the "can read" flag at the beginning
+			this->s.readiness_flags.clear(opros::ready::read);
+
+			for(;;){
+				auto res = ::recv(
+						this->s.sock,
+						reinterpret_cast<char*>(this->buf.data()),
+						int(this->buf.size()),
+						0
+					);
+				if(res == socket::socket_error){
+#if M_OS == M_OS_WINDOWS
+					int errorCode = WSAGetLastError();
+#else
+					int errorCode = errno;
+#endif
+					if(errorCode == socket::error_interrupted){
+						continue;
+					}else if(errorCode == socket::error_again){
+						return false;
+					}
+					throw std::system_error(errorCode, std::generic_category(), "could not receive data over network, recv() failed");
+				}
+
+				ASSERT(res >= 0)
+				this->num_bytes = size_t(res);
+				return true;
+			}
+		}
+
+	public:
+		size_t await_resume(){
+			this->check();
+			return this->num_bytes;
+		}
+	};
+
+	/**
+	 * @brief Receive data.
+	 * @param s - connected socket attached to the event loop.
+	 * @param buf - buffer where to put received data.
+	 * @param timeout_ms - timeout in milliseconds, 0 means no timeout.
+	 * @return awaitable.
+	 */
+	recieve_awaitable async_recieve(tcp_socket& s, utki::span<uint8_t> buf, uint32_t timeout_ms = 0){
+		return recieve_awaitable(*this, s, buf, timeout_ms);
+	}
+
+	/**
+	 * @brief Awaitable sending of all the data.
+	 * Awaiting completes when all the data is sent.
+	 * Throws std::system_error in case of error.
+	 */
+	class send_all_awaitable : public awaiter{
+		friend class event_loop;
+
+		utki::span<uint8_t> buf;
+		size_t num_sent = 0;
+
+		send_all_awaitable(event_loop& loop, tcp_socket& s, utki::span<uint8_t> buf, uint32_t timeout_ms) :
+				awaiter(loop, s, true, timeout_ms),
+				buf(buf)
+		{}
+
+		bool try_complete()override{
+			while(this->num_sent != this->buf.size()){
+				size_t n = static_cast<tcp_socket&>(this->s).send(this->buf.subspan(this->num_sent));
+				if(n == 0){
+					return false;
+				}
+				this->num_sent += n;
+			}
+			return true;
+		}
+
+	public:
+		void await_resume(){
+			this->check();
+		}
+	};
+
+	/**
+	 * @brief Send all the data.
+	 * @param s - connected socket attached to the event loop.
+	 * @param buf - data to send, must remain valid until awaiting completes.
+	 * @param timeout_ms - timeout in milliseconds, 0 means no timeout.
+	 * @return awaitable.
+	 */
+	send_all_awaitable async_send_all(tcp_socket& s, const utki::span<uint8_t> buf, uint32_t timeout_ms = 0){
+		return send_all_awaitable(*this, s, buf, timeout_ms);
+	}
+
+	/**
+	 * @brief Awaitable accepting of a connection.
+	 * Awaiting returns the accepted connection.
+	 * Throws std::system_error in case of error.
+	 */
+	class accept_awaitable : public awaiter{
+		friend class event_loop;
+
+		tcp_socket accepted;
+
+		accept_awaitable(event_loop& loop, tcp_server_socket& s, uint32_t timeout_ms) :
+				awaiter(loop, s, false, timeout_ms)
+		{}
+
+		bool try_complete()override{
+			this->accepted = static_cast<tcp_server_socket&>(this->s).accept();
+			return this->accepted.is_open();
+		}
+
+	public:
+		tcp_socket await_resume(){
+			this->check();
+			return std::move(this->accepted);
+		}
+	};
+
+	/**
+	 * @brief Accept a connection.
+	 * @param s - listening socket attached to the event loop.
+	 * @param timeout_ms - timeout in milliseconds, 0 means no timeout.
+	 * @return awaitable.
+	 */
+	accept_awaitable async_accept(tcp_server_socket& s, uint32_t timeout_ms = 0){
+		return accept_awaitable(*this, s, timeout_ms);
+	}
+
+	/**
+	 * @brief Awaitable connecting.
+	 * Awaiting completes when the connection is established.
+	 * Throws std::system_error if the connection has failed.
+	 */
+	class connect_awaitable : public awaiter{
+		friend class event_loop;
+
+		connect_awaitable(event_loop& loop, tcp_socket& s, uint32_t timeout_ms) :
+				awaiter(loop, s, true, timeout_ms)
+		{}
+
+		bool try_complete()override{
+			return static_cast<tcp_socket&>(this->s).get_connection_state() != tcp_socket::connection_state::pending;
+		}
+
+	public:
+		void await_resume(){
+			this->check();
+
+			auto& ts = static_cast<tcp_socket&>(this->s);
+			if(ts.get_connection_state() == tcp_socket::connection_state::failed){
+				throw std::system_error(ts.get_connection_error(), "could not connect");
+			}
+		}
+	};
+
+	/**
+	 * @brief Connect socket.
+	 * Opens the socket, attaches it to the event loop and starts connecting.
+	 * @param s - socket to connect, must not be opened.
+	 * @param destination_address - address to connect to.
+	 * @param disable_naggle - enable/disable Naggle algorithm.
+	 * @param timeout_ms - timeout in milliseconds, 0 means no timeout.
+	 * @return awaitable.
+	 */
+	connect_awaitable async_connect(tcp_socket& s, const address& destination_address, bool disable_naggle = false, uint32_t timeout_ms = 0){
+		s.open(destination_address, disable_naggle);
+		try{
+			this->attach(s);
+		}catch(...){
+			s.close();
+			throw;
+		}
+		return connect_awaitable(*this, s, timeout_ms);
+	}
+
+	/**
+	 * @brief Awaitable sleeping.
+	 * Awaiting completes when the time passes.
+	 */
+	class sleep_awaitable{
+		friend class event_loop;
+
+		event_loop& loop;
+
+		uint32_t duration_ms;
+		timer t;
+
+		sleep_awaitable(event_loop& loop, uint32_t duration_ms) :
+				loop(loop),
+				duration_ms(duration_ms)
+		{}
+
+	public:
+		sleep_awaitable(const sleep_awaitable&) = delete;
+		sleep_awaitable& operator=(const sleep_awaitable&) = delete;
+
+		bool await_ready()const noexcept{
+			return this->duration_ms == 0;
+		}
+
+		void await_suspend(std::coroutine_handle<> h){
+			this->t.handler = [this, h](){
+				this->loop.resumable.push_back(h);
+			};
+			this->loop.r.get_timers().arm(this->t, this->duration_ms);
+		}
+
+		void await_resume()const noexcept{}
+	};
+
+	/**
+	 * @brief Sleep.
+	 * Suspends the coroutine for the given time without blocking the event loop.
+	 * @param duration_ms - time to sleep in milliseconds.
+	 * @return awaitable.
+	 */
+	sleep_awaitable async_sleep(uint32_t duration_ms){
+		return sleep_awaitable(*this, duration_ms);
+	}
+
+	/**
+	 * @brief Awaitable DNS lookup.
+	 * Awaiting returns dns_lookup_result.
+	 * Throws the same exceptions as dns_resolver::resolve() in case the lookup could not be started.
+	 */
+	class resolve_awaitable : private dns_resolver{
+		friend class event_loop;
+
+		event_loop& loop;
+
+		const std::string& host_name;
+		uint32_t timeout_ms;
+		address dns_ip;
+		ip_version version;
+
+		dns_lookup_result result;
+		std::coroutine_handle<> handle;
+
+		resolve_awaitable(event_loop& loop, const std::string& host_name, uint32_t timeout_ms, const address& dns_ip, ip_version version) :
+				loop(loop),
+				host_name(host_name),
+				timeout_ms(timeout_ms),
+				dns_ip(dns_ip),
+				version(version)
+		{}
+
+		void on_completed(dns_result r, address::ip ip)noexcept override{
+			// called from DNS lookup thread, pass the result to the thread which runs the event loop
+			this->result.result = r;
+			this->result.ip = ip;
+			this->loop.r.post([this](){
+				--this->loop.num_lookups;
+				this->handle.resume();
+			});
+		}
+
+	public:
+		resolve_awaitable(const resolve_awaitable&) = delete;
+		resolve_awaitable& operator=(const resolve_awaitable&) = delete;
+
+		bool await_ready()const noexcept{
+			return false;
+		}
+
+		void await_suspend(std::coroutine_handle<> h){
+			this->handle = h;
+			this->resolve(this->host_name, this->timeout_ms, this->dns_ip, this->version);
+			++this->loop.num_lookups;
+		}
+
+		dns_lookup_result await_resume()const noexcept{
+			return this->result;
+		}
+	};
+
+	/**
+	 * @brief Look up IP address of a host.
+	 * The library must be initialized, see init_guard.
+	 * @param host_name - host name to resolve IP address for, must remain valid until awaiting completes.
+	 * @param timeout_ms - timeout for waiting for DNS server response in milliseconds.
+	 * @param dns_ip - IP address of the DNS to use, see dns_resolver::resolve().
+	 * @param version - version of IP address to look up.
+	 * @return awaitable.
+	 */
+	resolve_awaitable async_resolve(
+			const std::string& host_name,
+			uint32_t timeout_ms = 20000,
+			const address& dns_ip = address(address::ip(0), 0),
+			ip_version version = ip_version::any
+		)
+	{
+		return resolve_awaitable(*this, host_name, timeout_ms, dns_ip, version);
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,1002 @@
+#include "io_ring.hpp"
+
+#if M_OS == M_OS_LINUX
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <deque>
+#include <unordered_map>
+#include <cstring>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>)
+#	include <linux/io_uring.h>
+#endif
+
+using namespace setka;
+
+class io_ring::backend{
+public:
+	struct slot{
+		operation op;
+		uint64_t user_data;
+		int fd;
+
+		iovec iov;
+		msghdr msg;
+		native_address addr;
+
+		tcp_socket* connecting_socket;
+		native_address* out_sender_address;
+
+		bool connect_started; // for fallback implementation
+
+		bool in_progress;
+		bool cancel_requested;
+
+		int result; // number of bytes, accepted socket handle, or negative error code
+	};
+
+	const bool uring;
+
+	std::vector<slot> slots;
+	std::vector<unsigned> free_slots;
+
+	backend(bool uring) :
+			uring(uring)
+	{}
+
+	virtual ~backend()noexcept{}
+
+	void init_slots(unsigned num_slots){
+		this->slots.resize(num_slots);
+		this->free_slots.reserve(num_slots);
+		for(unsigned i = num_slots; i != 0; --i){
+			this->free_slots.push_back(i - 1);
+		}
+	}
+
+	slot* allocate(){
+		if(this->free_slots.empty()){
+			return nullptr;
+		}
+		slot* ret = &this->slots[this->free_slots.back()];
+		this->free_slots.pop_back();
+		ret->in_progress = true;
+		ret->cancel_requested = false;
+		return ret;
+	}
+
+	void release(slot& s){
+		s.in_progress = false;
+		this->free_slots.push_back(unsigned(&s - this->slots.data()));
+	}
+
+	size_t num_in_progress()const noexcept{
+		return this->slots.size() - this->free_slots.size();
+	}
+
+	virtual int get_handle() = 0;
+
+	// returns false if the operation cannot be queued at the moment
+	virtual bool start(slot& s) = 0;
+
+	// releases the slot if the operation could not be started
+	bool try_start(slot& s){
+		bool started;
+		try{
+			started = this->start(s);
+		}catch(...){
+			this->release(s);
+			throw;
+		}
+		if(!started){
+			this->release(s);
+		}
+		return started;
+	}
+
+	virtual void submit() = 0;
+
+	// requests cancellation of the operation in progress, the operation completes with ECANCELED error
+	// unless it has already completed
+	virtual void cancel(slot& s) = 0;
+
+	virtual slot* pop_completed() = 0;
+
+	// blocks until there are completions
+	virtual void wait_completions() = 0;
+
+	virtual bool register_sockets(utki::span<const int> fds){
+		return false;
+	}
+
+	virtual void unregister_sockets(){}
+};
+
+namespace{
+
+bool is_write(io_ring::operation op){
+	switch(op){
+		case io_ring::operation::connect:
+		case io_ring::operation::send:
+		case io_ring::operation::send_to:
+			return true;
+		default:
+			return false;
+	}
+}
+
+#if defined(IORING_OFF_SQ_RING) && defined(__NR_io_uring_setup)
+
+class uring_backend : public io_ring::backend{
+	// user data of the cancellation requests, their completions are not reported
+	static constexpr uint64_t cancel_user_data = ~uint64_t(0);
+
+	int ring_fd;
+
+	void* sq_ring = MAP_FAILED;
+	size_t sq_ring_size;
+	void* cq_ring = MAP_FAILED;
+	size_t cq_ring_size;
+	io_uring_sqe* sqes = reinterpret_cast<io_uring_sqe*>(MAP_FAILED);
+	size_t sqes_size;
+
+	unsigned* sq_head;
+	unsigned* sq_tail;
+	unsigned* sq_array;
+	unsigned sq_mask;
+	unsigned sq_entries;
+
+	unsigned* cq_head;
+	unsigned* cq_tail;
+	io_uring_cqe* cqes;
+	unsigned cq_mask;
+
+	unsigned sq_local_tail;
+	unsigned num_unsubmitted = 0;
+
+	std::unordered_map<int, unsigned> registered; // socket handle to registered file index
+
+	void destroy()noexcept{
+		if(this->sqes != MAP_FAILED){
+			munmap(this->sqes, this->sqes_size);
+		}
+		if(this->cq_ring != MAP_FAILED && this->cq_ring != this->sq_ring){
+			munmap(this->cq_ring, this->cq_ring_size);
+		}
+		if(this->sq_ring != MAP_FAILED){
+			munmap(this->sq_ring, this->sq_ring_size);
+		}
+		close(this->ring_fd);
+	}
+
+	// returns nullptr if the submission queue is full and the kernel cannot take the queued entries at the moment
+	io_uring_sqe* get_sqe(){
+		if(this->sq_local_tail - __atomic_load_n(this->sq_head, __ATOMIC_ACQUIRE) == this->sq_entries){
+			// submission queue is full, submit the queued entries to free it up
+			this->submit();
+			if(this->sq_local_tail - __atomic_load_n(this->sq_head, __ATOMIC_ACQUIRE) == this->sq_entries){
+				return nullptr;
+			}
+		}
+
+		unsigned index = this->sq_local_tail & this->sq_mask;
+		io_uring_sqe& sqe = this->sqes[index];
+		memset(&sqe, 0, sizeof(sqe));
+		this->sq_array[index] = index;
+
+		++this->sq_local_tail;
+		++this->num_unsubmitted;
+
+		return &sqe;
+	}
+
+public:
+	uring_backend(unsigned queue_size) :
+			backend(true)
+	{
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+
+		// room for completions of the cancellation requests, see init_slots() below
+		params.flags = IORING_SETUP_CQSIZE;
+		params.cq_entries = queue_size * 4;
+
+		this->ring_fd = int(syscall(__NR_io_uring_setup, queue_size, &params));
+		if(this->ring_fd < 0){
+			throw std::system_error(errno, std::generic_category(), "could not create io_uring, io_uring_setup() failed");
+		}
+
+		// without fast poll the operations on sockets which are not ready are performed by kernel worker threads,
+		// which is slower than the fallback implementation
+		if(!(params.features & IORING_FEAT_FAST_POLL)){
+			close(this->ring_fd);
+			throw std::system_error(int(std::errc::not_supported), std::generic_category(), "io_uring does not support fast poll");
+		}
+
+		this->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		this->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+		bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if(single_mmap){
+			this->sq_ring_size = std::max(this->sq_ring_size, this->cq_ring_size);
+			this->cq_ring_size = this->sq_ring_size;
+		}
+
+		this->sq_ring = mmap(nullptr, this->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ring_fd, IORING_OFF_SQ_RING);
+		if(this->sq_ring == MAP_FAILED){
+			int errorCode = errno;
+			this->destroy();
+			throw std::system_error(errorCode, std::generic_category(), "could not map io_uring submission queue, mmap() failed");
+		}
+
+		if(single_mmap){
+			this->cq_ring = this->sq_ring;
+		}else{
+			this->cq_ring = mmap(nullptr, this->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ring_fd, IORING_OFF_CQ_RING);
+			if(this->cq_ring == MAP_FAILED){
+				int errorCode = errno;
+				this->destroy();
+				throw std::system_error(errorCode, std::generic_category(), "could not map io_uring completion queue, mmap() failed");
+			}
+		}
+
+		this->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+		this->sqes = reinterpret_cast<io_uring_sqe*>(
+				mmap(nullptr, this->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ring_fd, IORING_OFF_SQES)
+			);
+		if(this->sqes == MAP_FAILED){
+			int errorCode = errno;
+			this->destroy();
+			throw std::system_error(errorCode, std::generic_category(), "could not map io_uring submission queue entries, mmap() failed");
+		}
+
+		auto sq = reinterpret_cast<uint8_t*>(this->sq_ring);
+		this->sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+		this->sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+		this->sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+		this->sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+		this->sq_entries = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+
+		auto cq = reinterpret_cast<uint8_t*>(this->cq_ring);
+		this->cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+		this->cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+		this->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+		this->cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+
+		this->sq_local_tail = *this->sq_tail;
+
+		// Not more operations than half of the completion queue can hold are allowed to be in progress,
+		// so the completion queue never overflows, even if cancellation is requested for each of the operations.
+		this->init_slots(params.cq_entries / 2);
+	}
+
+	~uring_backend()noexcept{
+		this->destroy();
+	}
+
+	int get_handle()override{
+		// io_uring file descriptor becomes ready for reading when there are completions
+		return this->ring_fd;
+	}
+
+	bool start(slot& s)override{
+		io_uring_sqe* e = this->get_sqe();
+		if(!e){
+			return false;
+		}
+		io_uring_sqe& sqe = *e;
+
+		auto i = this->registered.find(s.fd);
+		if(i == this->registered.end()){
+			sqe.fd = s.fd;
+		}else{
+			sqe.fd = int(i->second);
+			sqe.flags |= IOSQE_FIXED_FILE;
+		}
+
+		switch(s.op){
+			case io_ring::operation::accept:
+				sqe.opcode = IORING_OP_ACCEPT;
+				sqe.accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+				break;
+			case io_ring::operation::connect:
+				sqe.opcode = IORING_OP_CONNECT;
+				sqe.addr = reinterpret_cast<uintptr_t>(s.addr.get_sockaddr());
+				sqe.off = s.addr.get_size();
+				break;
+			case io_ring::operation::send:
+				sqe.opcode = IORING_OP_SEND;
+				sqe.addr = reinterpret_cast<uintptr_t>(s.iov.iov_base);
+				sqe.len = unsigned(s.iov.iov_len);
+				sqe.msg_flags = MSG_NOSIGNAL;
+				break;
+			case io_ring::operation::recieve:
+				sqe.opcode = IORING_OP_RECV;
+				sqe.addr = reinterpret_cast<uintptr_t>(s.iov.iov_base);
+				sqe.len = unsigned(s.iov.iov_len);
+				break;
+			case io_ring::operation::send_to:
+				sqe.opcode = IORING_OP_SENDMSG;
+				sqe.addr = reinterpret_cast<uintptr_t>(&s.msg);
+				sqe.len = 1;
+				sqe.msg_flags = MSG_NOSIGNAL;
+				break;
+			case io_ring::operation::recieve_from:
+				sqe.opcode = IORING_OP_RECVMSG;
+				sqe.addr = reinterpret_cast<uintptr_t>(&s.msg);
+				sqe.len = 1;
+				break;
+		}
+
+		sqe.user_data = uint64_t(&s - this->slots.data());
+		return true;
+	}
+
+	void submit()override{
+		if(this->num_unsubmitted == 0){
+			return;
+		}
+
+		__atomic_store_n(this->sq_tail, this->sq_local_tail, __ATOMIC_RELEASE);
+
+		while(this->num_unsubmitted != 0){
+			int res = int(syscall(__NR_io_uring_enter, this->ring_fd, this->num_unsubmitted, 0, 0, nullptr, 0));
+			if(res < 0){
+				int errorCode = errno;
+				if(errorCode == EINTR){
+					continue;
+				}else if(errorCode == EAGAIN || errorCode == EBUSY){
+					// kernel is short of resources, the operations will be submitted next time
+					return;
+				}
+				throw std::system_error(errorCode, std::generic_category(), "could not submit I/O operations, io_uring_enter() failed");
+			}
+			ASSERT(unsigned(res) <= this->num_unsubmitted)
+			this->num_unsubmitted -= unsigned(res);
+		}
+	}
+
+	void cancel(slot& s)override{
+		if(s.cancel_requested){
+			return;
+		}
+
+		io_uring_sqe* sqe = this->get_sqe();
+		if(!sqe){
+			throw std::system_error(int(std::errc::device_or_resource_busy), std::generic_category(), "could not cancel I/O operation, submission queue is full");
+		}
+
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = uint64_t(&s - this->slots.data());
+		sqe->user_data = cancel_user_data;
+
+		s.cancel_requested = true;
+
+		this->submit();
+	}
+
+	slot* pop_completed()override{
+		for(;;){
+			unsigned head = *this->cq_head;
+			if(head == __atomic_load_n(this->cq_tail, __ATOMIC_ACQUIRE)){
+				// retry submitting the operations which could not be submitted before
+				this->submit();
+				return nullptr;
+			}
+
+			const io_uring_cqe& cqe = this->cqes[head & this->cq_mask];
+
+			if(cqe.user_data == cancel_user_data){
+				// the cancelled operation completes on its own
+				__atomic_store_n(this->cq_head, head + 1, __ATOMIC_RELEASE);
+				continue;
+			}
+
+			ASSERT(cqe.user_data < this->slots.size())
+			slot& s = this->slots[size_t(cqe.user_data)];
+			s.result = cqe.res;
+
+			__atomic_store_n(this->cq_head, head + 1, __ATOMIC_RELEASE);
+
+			return &s;
+		}
+	}
+
+	void wait_completions()override{
+		__atomic_store_n(this->sq_tail, this->sq_local_tail, __ATOMIC_RELEASE);
+
+		for(;;){
+			int res = int(syscall(__NR_io_uring_enter, this->ring_fd, this->num_unsubmitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+			if(res < 0){
+				int errorCode = errno;
+				if(errorCode == EINTR){
+					continue;
+				}
+				throw std::system_error(errorCode, std::generic_category(), "could not wait for I/O completions, io_uring_enter() failed");
+			}
+			ASSERT(unsigned(res) <= this->num_unsubmitted)
+			this->num_unsubmitted -= unsigned(res);
+			return;
+		}
+	}
+
+	bool register_sockets(utki::span<const int> fds)override{
+		this->unregister_sockets();
+
+		if(fds.size() == 0){
+			return true;
+		}
+
+		if(syscall(__NR_io_uring_register, this->ring_fd, IORING_REGISTER_FILES, fds.data(), unsigned(fds.size())) < 0){
+			throw std::system_error(errno, std::generic_category(), "could not register sockets, io_uring_register() failed");
+		}
+
+		for(unsigned i = 0; i != fds.size(); ++i){
+			this->registered[fds[i]] = i;
+		}
+		return true;
+	}
+
+	void unregister_sockets()override{
+		if(this->registered.empty()){
+			return;
+		}
+		syscall(__NR_io_uring_register, this->ring_fd, IORING_UNREGISTER_FILES, nullptr, 0);
+		this->registered.clear();
+	}
+};
+
+#endif
+
+// performs the operations in non-blocking mode when the sockets become ready
+class fallback_backend : public io_ring::backend{
+	int epoll_fd;
+	int event_fd; // signaled when there are completions
+
+	bool signaled = false;
+
+	std::vector<slot*> started;
+	std::vector<slot*> waiting;
+	std::deque<slot*> completed;
+
+	// numbers of operations waiting for reading and writing readiness, per socket handle
+	std::unordered_map<int, std::pair<unsigned, unsigned>> interests;
+
+	std::unordered_map<int, uint32_t> ready; // ready socket handles with epoll events
+
+	std::array<epoll_event, 64> events;
+
+	void watch(int fd, bool write, bool add){
+		auto& c = this->interests[fd];
+		unsigned& n = write ? c.second : c.first;
+		if(add){
+			++n;
+		}else{
+			ASSERT(n != 0)
+			--n;
+		}
+
+		epoll_event e;
+		e.events = (c.first != 0 ? EPOLLIN : 0) | (c.second != 0 ? EPOLLOUT : 0);
+		e.data.fd = fd;
+
+		if(e.events == 0){
+			epoll_ctl(this->epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+			this->interests.erase(fd);
+			return;
+		}
+
+		if(epoll_ctl(this->epoll_fd, EPOLL_CTL_MOD, fd, &e) != 0){
+			if(errno != ENOENT || epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, fd, &e) != 0){
+				throw std::system_error(errno, std::generic_category(), "could not wait for socket readiness, epoll_ctl() failed");
+			}
+		}
+	}
+
+	// returns true if the operation has completed
+	static bool perform(slot& s){
+		for(;;){
+			ssize_t res = 0;
+			switch(s.op){
+				case io_ring::operation::accept:
+					res = accept4(s.fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+					break;
+				case io_ring::operation::connect:
+					if(!s.connect_started){
+						res = ::connect(s.fd, s.addr.get_sockaddr(), s.addr.get_size());
+						if(res != 0 && errno == EINPROGRESS){
+							s.connect_started = true;
+							return false;
+						}
+					}else{
+						int error = 0;
+						socklen_t len = sizeof(error);
+						if(getsockopt(s.fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0){
+							error = errno;
+						}
+						s.result = -error;
+						return true;
+					}
+					break;
+				case io_ring::operation::send:
+					res = ::send(s.fd, s.iov.iov_base, s.iov.iov_len, MSG_NOSIGNAL | MSG_DONTWAIT);
+					break;
+				case io_ring::operation::recieve:
+					res = ::recv(s.fd, s.iov.iov_base, s.iov.iov_len, MSG_DONTWAIT);
+					break;
+				case io_ring::operation::send_to:
+					res = ::sendmsg(s.fd, &s.msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+					break;
+				case io_ring::operation::recieve_from:
+					res = ::recvmsg(s.fd, &s.msg, MSG_DONTWAIT);
+					break;
+			}
+
+			if(res < 0){
+				int errorCode = errno;
+				if(errorCode == EINTR){
+					continue;
+				}else if(errorCode == EAGAIN || errorCode == EWOULDBLOCK){
+					return false;
+				}
+				s.result = -errorCode;
+				return true;
+			}
+
+			s.result = int(res);
+			return true;
+		}
+	}
+
+	void complete(slot& s){
+		this->completed.push_back(&s);
+		if(!this->signaled){
+			uint64_t one = 1;
+			if(write(this->event_fd, &one, sizeof(one)) < 0){
+				throw std::system_error(errno, std::generic_category(), "could not signal completion, write() failed");
+			}
+			this->signaled = true;
+		}
+	}
+
+	void poll(){
+		int num_events;
+		do{
+			num_events = epoll_wait(this->epoll_fd, this->events.data(), int(this->events.size()), 0);
+		}while(num_events < 0 && errno == EINTR);
+
+		if(num_events < 0){
+			throw std::system_error(errno, std::generic_category(), "could not check socket readiness, epoll_wait() failed");
+		}
+
+		this->ready.clear();
+		for(int i = 0; i != num_events; ++i){
+			if(this->events[i].data.fd != this->event_fd){
+				this->ready[this->events[i].data.fd] = this->events[i].events;
+			}
+		}
+
+		if(this->ready.empty()){
+			return;
+		}
+
+		for(auto i = this->waiting.begin(); i != this->waiting.end();){
+			slot& s = **i;
+
+			auto r = this->ready.find(s.fd);
+			if(r == this->ready.end() || !(r->second & (EPOLLERR | EPOLLHUP | (is_write(s.op) ? EPOLLOUT : EPOLLIN)))){
+				++i;
+				continue;
+			}
+
+			if(!perform(s)){
+				++i;
+				continue;
+			}
+
+			this->watch(s.fd, is_write(s.op), false);
+			i = this->waiting.erase(i);
+			this->complete(s);
+		}
+	}
+
+public:
+	fallback_backend(unsigned queue_size) :
+			backend(false)
+	{
+		this->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if(this->epoll_fd < 0){
+			throw std::system_error(errno, std::generic_category(), "could not create io_ring, epoll_create1() failed");
+		}
+
+		this->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if(this->event_fd < 0){
+			int errorCode = errno;
+			close(this->epoll_fd);
+			throw std::system_error(errorCode, std::generic_category(), "could not create io_ring, eventfd() failed");
+		}
+
+		epoll_event e;
+		e.events = EPOLLIN;
+		e.data.fd = this->event_fd;
+		if(epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, this->event_fd, &e) != 0){
+			int errorCode = errno;
+			close(this->event_fd);
+			close(this->epoll_fd);
+			throw std::system_error(errorCode, std::generic_category(), "could not create io_ring, epoll_ctl() failed");
+		}
+
+		// same number of operations in progress as with io_uring
+		this->init_slots(queue_size * 2);
+		this->started.reserve(this->slots.size());
+		this->waiting.reserve(this->slots.size());
+	}
+
+	~fallback_backend()noexcept{
+		close(this->event_fd);
+		close(this->epoll_fd);
+	}
+
+	int get_handle()override{
+		// epoll file descriptor becomes ready for reading when there are completions or some socket is ready
+		return this->epoll_fd;
+	}
+
+	bool start(slot& s)override{
+		s.connect_started = false;
+		this->started.push_back(&s);
+		return true;
+	}
+
+	void cancel(slot& s)override{
+		auto i = std::find(this->started.begin(), this->started.end(), &s);
+		if(i != this->started.end()){
+			this->started.erase(i);
+		}else{
+			i = std::find(this->waiting.begin(), this->waiting.end(), &s);
+			if(i == this->waiting.end()){
+				// the operation has already completed
+				return;
+			}
+			this->waiting.erase(i);
+			this->watch(s.fd, is_write(s.op), false);
+		}
+
+		s.result = -ECANCELED;
+		this->complete(s);
+	}
+
+	void submit()override{
+		for(auto p : this->started){
+			slot& s = *p;
+			if(perform(s)){
+				this->complete(s);
+			}else{
+				this->watch(s.fd, is_write(s.op), true);
+				this->waiting.push_back(&s);
+			}
+		}
+		this->started.clear();
+	}
+
+	slot* pop_completed()override{
+		if(this->completed.empty()){
+			this->poll();
+		}
+
+		if(this->completed.empty()){
+			return nullptr;
+		}
+
+		slot* ret = this->completed.front();
+		this->completed.pop_front();
+
+		if(this->completed.empty() && this->signaled){
+			uint64_t value;
+			if(read(this->event_fd, &value, sizeof(value)) < 0){
+				throw std::system_error(errno, std::generic_category(), "could not reset completion signal, read() failed");
+			}
+			this->signaled = false;
+		}
+
+		return ret;
+	}
+
+	void wait_completions()override{
+		// the operations complete only when the completions are retrieved,
+		// so waiting makes sense only if there are completed operations already
+		ASSERT(!this->completed.empty())
+	}
+};
+
+}
+
+io_ring::io_ring(unsigned queue_size, bool use_io_uring){
+#if defined(IORING_OFF_SQ_RING) && defined(__NR_io_uring_setup)
+	if(use_io_uring){
+		try{
+			this->impl = std::make_unique<uring_backend>(queue_size);
+		}catch(std::system_error&){
+			// io_uring is not available, use fallback implementation
+		}
+	}
+#endif
+
+	if(!this->impl){
+		this->impl = std::make_unique<fallback_backend>(queue_size);
+	}
+}
+
+io_ring::~io_ring()noexcept{
+	ASSERT_INFO(!this->is_added(), "io_ring::~io_ring(): io_ring is added to a wait set")
+
+	// cancel the operations in progress and wait until they complete, so that the OS does not access
+	// the buffers after the io_ring is destroyed, and close accepted connections which were not retrieved
+	try{
+		for(auto& s : this->impl->slots){
+			if(s.in_progress){
+				this->impl->cancel(s);
+			}
+		}
+
+		while(this->impl->num_in_progress() != 0){
+			auto s = this->impl->pop_completed();
+			if(!s){
+				this->impl->wait_completions();
+				continue;
+			}
+			if(s->op == operation::accept && s->result >= 0){
+				close(s->result);
+			}
+			this->impl->release(*s);
+		}
+	}catch(...){
+		ASSERT_INFO(false, "io_ring::~io_ring(): could not cancel the operations in progress")
+	}
+}
+
+int io_ring::get_handle(){
+	return this->impl->get_handle();
+}
+
+bool io_ring::is_io_uring()const noexcept{
+	return this->impl->uring;
+}
+
+bool io_ring::accept(tcp_server_socket& s, uint64_t user_data){
+	if(!s.is_open()){
+		throw std::logic_error("io_ring::accept(): socket is not opened");
+	}
+
+	auto sl = this->impl->allocate();
+	if(!sl){
+		return false;
+	}
+
+	sl->op = operation::accept;
+	sl->user_data = user_data;
+	sl->fd = s.sock;
+
+	return this->impl->try_start(*sl);
+}
+
+bool io_ring::connect(tcp_socket& s, const address& destination_address, uint64_t user_data, bool disable_naggle){
+	if(s.is_open()){
+		throw std::logic_error("io_ring::connect(): socket is already opened");
+	}
+
+	auto sl = this->impl->allocate();
+	if(!sl){
+		return false;
+	}
+
+	sl->addr = native_address(destination_address);
+
+	try{
+		s.create(sl->addr, disable_naggle, socket_options());
+	}catch(...){
+		this->impl->release(*sl);
+		throw;
+	}
+
+	sl->op = operation::connect;
+	sl->user_data = user_data;
+	sl->fd = s.sock;
+	sl->connecting_socket = &s;
+
+	bool started;
+	try{
+		started = this->impl->try_start(*sl);
+	}catch(...){
+		s.close();
+		throw;
+	}
+	if(!started){
+		s.close();
+	}
+	return started;
+}
+
+bool io_ring::send(socket& s, const utki::span<uint8_t> buf, uint64_t user_data){
+	if(!s.is_open()){
+		throw std::logic_error("io_ring::send(): socket is not opened");
+	}
+
+	auto sl = this->impl->allocate();
+	if(!sl){
+		return false;
+	}
+
+	sl->op = operation::send;
+	sl->user_data = user_data;
+	sl->fd = s.sock;
+	sl->iov.iov_base = buf.data();
+	sl->iov.iov_len = buf.size();
+
+	return this->impl->try_start(*sl);
+}
+
+bool io_ring::recieve(socket& s, utki::span<uint8_t> buf, uint64_t user_data){
+	if(!s.is_open()){
+		throw std::logic_error("io_ring::recieve(): socket is not opened");
+	}
+
+	auto sl = this->impl->allocate();
+	if(!sl){
+		return false;
+	}
+
+	sl->op = operation::recieve;
+	sl->user_data = user_data;
+	sl->fd = s.sock;
+	sl->iov.iov_base = buf.data();
+	sl->iov.iov_len = buf.size();
+
+	return this->impl->try_start(*sl);
+}
+
+bool io_ring::send(udp_socket& s, const utki::span<uint8_t> buf, const native_address& destination_address, uint64_t user_data){
+	if(!s.is_open()){
+		throw std::logic_error("io_ring::send(): socket is not opened");
+	}
+
+	auto sl = this->impl->allocate();
+	if(!sl){
+		return false;
+	}
+
+	sl->op = operation::send_to;
+	sl->user_data = user_data;
+	sl->fd = s.sock;
+	sl->iov.iov_base = buf.data();
+	sl->iov.iov_len = buf.size();
+	sl->addr = destination_address;
+
+	memset(&sl->msg, 0, sizeof(sl->msg));
+	sl->msg.msg_name = &sl->addr.storage;
+	sl->msg.msg_namelen = sl->addr.length;
+	sl->msg.msg_iov = &sl->iov;
+	sl->msg.msg_iovlen = 1;
+
+	return this->impl->try_start(*sl);
+}
+
+bool io_ring::recieve(udp_socket& s, utki::span<uint8_t> buf, native_address& out_sender_address, uint64_t user_data){
+	if(!s.is_open()){
+		throw std::logic_error("io_ring::recieve(): socket is not opened");
+	}
+
+	auto sl = this->impl->allocate();
+	if(!sl){
+		return false;
+	}
+
+	sl->op = operation::recieve_from;
+	sl->user_data = user_data;
+	sl->fd = s.sock;
+	sl->iov.iov_base = buf.data();
+	sl->iov.iov_len = buf.size();
+	sl->out_sender_address = &out_sender_address;
+
+	memset(&sl->msg, 0, sizeof(sl->msg));
+	sl->msg.msg_name = &out_sender_address.storage;
+	sl->msg.msg_namelen = sizeof(out_sender_address.storage);
+	sl->msg.msg_iov = &sl->iov;
+	sl->msg.msg_iovlen = 1;
+
+	return this->impl->try_start(*sl);
+}
+
+bool io_ring::cancel(uint64_t user_data){
+	bool found = false;
+	for(auto& s : this->impl->slots){
+		if(s.in_progress && s.user_data == user_data){
+			this->impl->cancel(s);
+			found = true;
+		}
+	}
+	return found;
+}
+
+void io_ring::submit(){
+	this->impl->submit();
+}
+
+size_t io_ring::get_completions(utki::span<completion> out_completions){
+	this->readiness_flags.clear(opros::ready::read);
+
+	size_t num_completions = 0;
+
+	for(auto& c : out_completions){
+		auto s = this->impl->pop_completed();
+		if(!s){
+			break;
+		}
+
+		c.user_data = s->user_data;
+		c.op = s->op;
+		c.num_bytes = 0;
+		c.accepted.close();
+
+		if(s->result < 0){
+			c.error.assign(-s->result, std::generic_category());
+		}else{
+			c.error.clear();
+		}
+
+		switch(s->op){
+			case operation::accept:
+				if(s->result >= 0){
+					c.accepted.sock = s->result;
+				}
+				break;
+			case operation::connect:
+				s->connecting_socket->state = c.error ? tcp_socket::connection_state::failed : tcp_socket::connection_state::connected;
+				s->connecting_socket->connection_error = c.error;
+				break;
+			case operation::recieve_from:
+				if(!c.error){
+					s->out_sender_address->length = s->msg.msg_namelen;
+				}
+				[[fallthrough]];
+			default:
+				if(!c.error){
+					c.num_bytes = size_t(s->result);
+				}
+				break;
+		}
+
+		this->impl->release(*s);
+		++num_completions;
+	}
+
+	return num_completions;
+}
+
+bool io_ring::register_sockets(utki::span<socket* const> sockets){
+	std::vector<int> fds;
+	fds.reserve(sockets.size());
+	for(auto s : sockets){
+		if(!s->is_open()){
+			throw std::logic_error("io_ring::register_sockets(): socket is not opened");
+		}
+		fds.push_back(s->sock);
+	}
+	return this->impl->register_sockets(utki::make_span(fds));
+}
+
+void io_ring::unregister_sockets(){
+	this->impl->unregister_sockets();
+}
+
+#endif
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <utki/config.hpp>
+
+#if M_OS == M_OS_LINUX
+
+#include <memory>
+#include <system_error>
+
+#include <utki/span.hpp>
+
+#include <opros/waitable.hpp>
+
+#include "tcp_socket.hpp"
+#include "tcp_server_socket.hpp"
+#include "udp_socket.hpp"
+
+namespace setka{
+
+/**
+ * @brief Completion based I/O on sockets.
+ * Instead of waiting for readiness of the sockets and then performing I/O, the I/O operations are started
+ * and their results are reported when the operations complete. The operations are batched, i.e. the operations
+ * started since the last submit() are handed over to the OS by a single system call.
+ * Completion of the operations is indicated by the io_ring itself, which is a waitable becoming ready for reading
+ * when there are completions to get with get_completions().
+ *
+ * Uses io_uring on Linux. In case io_uring is not available, e.g. the kernel is too old or io_uring is disabled,
+ * the operations are performed in non-blocking mode when the sockets become ready, which gives the same results
+ * but without saving the system calls.
+ *
+ * The sockets and buffers used by the operations must remain valid, and the sockets must not be moved,
+ * until the operations complete. Closing the socket does not complete the operations in progress on it,
+ * so the operations, e.g. receiving from an idle connection, have to be cancelled with cancel() before.
+ * Destroying the io_ring cancels the operations in progress and waits for them to complete.
+ * The io_ring is not thread-safe.
+ * Only available on Linux.
+ */
+class io_ring : public opros::waitable{
+public:
+	/**
+	 * @brief Type of I/O operation.
+	 */
+	enum class operation{
+		accept,
+		connect,
+		send,
+		recieve,
+		send_to,
+		recieve_from
+	};
+
+	/**
+	 * @brief Completion of I/O operation.
+	 */
+	struct completion{
+		/**
+		 * @brief User data given when the operation was started.
+		 */
+		uint64_t user_data;
+
+		/**
+		 * @brief Type of the completed operation.
+		 */
+		operation op;
+
+		/**
+		 * @brief Error of the operation.
+		 * Empty error code means success.
+		 */
+		std::error_code error;
+
+		/**
+		 * @brief Number of bytes sent or received.
+		 * Receiving 0 bytes means that the connection was closed by peer.
+		 */
+		size_t num_bytes;
+
+		/**
+		 * @brief Accepted connection.
+		 * Only for accept operation.
+		 */
+		tcp_socket accepted;
+	};
+
+	class backend;
+
+private:
+	std::unique_ptr<backend> impl;
+
+	int get_handle()override;
+
+public:
+	/**
+	 * @brief Create io_ring.
+	 * @param queue_size - size of the submission queue. The started operations are handed over to the OS
+	 *                     by submit(), or right away in case the submission queue gets full.
+	 *                     Twice as many operations can be in progress at once.
+	 * @param use_io_uring - whether to use io_uring if it is available.
+	 */
+	io_ring(unsigned queue_size = 256, bool use_io_uring = true);
+
+	io_ring(const io_ring&) = delete;
+	io_ring& operator=(const io_ring&) = delete;
+
+	~io_ring()noexcept;
+
+	/**
+	 * @brief Check if io_uring is used.
+	 * @return true if io_uring is used.
+	 * @return false if the fallback implementation is used.
+	 */
+	bool is_io_uring()const noexcept;
+
+	/**
+	 * @brief Start accepting a connection.
+	 * @param s - listening socket.
+	 * @param user_data - user data to report along with the completion.
+	 * @return true if the operation was started.
+	 * @return false if too many operations are in progress, get completions and try again.
+	 */
+	bool accept(tcp_server_socket& s, uint64_t user_data);
+
+	/**
+	 * @brief Start connecting a socket.
+	 * Opens the socket and starts connecting it. Once the operation is completed the connection state
+	 * of the socket is updated accordingly, see tcp_socket::get_connection_state().
+	 * @param s - socket to connect, must not be opened.
+	 * @param destination_address - address to connect to.
+	 * @param user_data - user data to report along with the completion.
+	 * @param disable_naggle - enable/disable Naggle algorithm.
+	 * @return true if the operation was started.
+	 * @return false if too many operations are in progress, get completions and try again.
+	 */
+	bool connect(tcp_socket& s, const address& destination_address, uint64_t user_data, bool disable_naggle = false);
+
+	/**
+	 * @brief Start sending data.
+	 * @param s - connected TCP or UDP socket.
+	 * @param buf - data to send.
+	 * @param user_data - user data to report along with the completion.
+	 * @return true if the operation was started.
+	 * @return false if too many operations are in progress, get completions and try again.
+	 */
+	bool send(socket& s, const utki::span<uint8_t> buf, uint64_t user_data);
+
+	/**
+	 * @brief Start receiving data.
+	 * @param s - connected TCP or UDP socket.
+	 * @param buf - buffer where to put received data.
+	 * @param user_data - user data to report along with the completion.
+	 * @return true if the operation was started.
+	 * @return false if too many operations are in progress, get completions and try again.
+	 */
+	bool recieve(socket& s, utki::span<uint8_t> buf, uint64_t user_data);
+
+	/**
+	 * @brief Start sending datagram.
+	 * @param s - UDP socket.
+	 * @param buf - datagram to send.
+	 * @param destination_address - the destination address to send the datagram to.
+	 * @param user_data - user data to report along with the completion.
+	 * @return true if the operation was started.
+	 * @return false if too many operations are in progress, get completions and try again.
+	 */
+	bool send(udp_socket& s, const utki::span<uint8_t> buf, const native_address& destination_address, uint64_t user_data);
+
+	/**
+	 * @brief Start receiving datagram.
+	 * @param s - UDP socket.
+	 * @param buf - buffer where to put the received datagram.
+	 * @param out_sender_address - where to put the sender address once the operation completes.
+	 * @param user_data - user data to report along with the completion.
+	 * @return true if the operation was started.
+	 * @return false if too many operations are in progress, get completions and try again.
+	 */
+	bool recieve(udp_socket& s, utki::span<uint8_t> buf, native_address& out_sender_address, uint64_t user_data);
+
+	/**
+	 * @brief Cancel operations.
+	 * Requests cancellation of all the operations in progress which were started with the given user data.
+	 * The cancelled operations complete with std::errc::operation_canceled error, the completions are retrieved
+	 * with get_completions() as usual. In case an operation completes before the cancellation takes effect,
+	 * its completion is reported as if it was not cancelled.
+	 * @param user_data - user data of the operations to cancel.
+	 * @return true if there were operations in progress with the given user data.
+	 * @return false otherwise.
+	 */
+	bool cancel(uint64_t user_data);
+
+	/**
+	 * @brief Submit the started operations to the OS.
+	 */
+	void submit();
+
+	/**
+	 * @brief Get completions of the operations.
+	 * If there is no completed operations this function does not block, instead it returns 0.
+	 * @param out_completions - where to put completions.
+	 * @return number of completions written.
+	 */
+	size_t get_completions(utki::span<completion> out_completions);
+
+	/**
+	 * @brief Register sockets for faster access.
+	 * Operations on the registered sockets save the cost of looking up the socket by the OS.
+	 * Previously registered sockets are unregistered.
+	 * The registered sockets must remain open until unregistered.
+	 * @param sockets - sockets to register.
+	 * @return true if the sockets were registered.
+	 * @return false if registering sockets is not supported, e.g. when io_uring is not used.
+	 */
+	bool register_sockets(utki::span<socket* const> sockets);
+
+	/**
+	 * @brief Unregister sockets registered with register_sockets().
+	 */
+	void unregister_sockets();
+};
+
+}
+
+#endif
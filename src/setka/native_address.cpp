@@ -0,0 +1,105 @@
+#include "native_address.hpp"
+
+#include <cstring>
+
+#include <utki/debug.hpp>
+
+#if M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX || M_OS == M_OS_UNIX
+#	include <netinet/in.h>
+#endif
+
+using namespace setka;
+
+native_address::native_address(const address& addr)noexcept{
+	if(addr.host.is_v4()){
+		sockaddr_in& a = reinterpret_cast<sockaddr_in&>(this->storage);
+		memset(&a, 0, sizeof(a));
+		a.sin_family = AF_INET;
+		a.sin_addr.s_addr = htonl(addr.host.get_v4());
+		a.sin_port = htons(addr.port);
+		this->length = sizeof(a);
+	}else{
+		sockaddr_in6& a = reinterpret_cast<sockaddr_in6&>(this->storage);
+		memset(&a, 0, sizeof(a));
+		a.sin6_family = AF_INET6;
+#if M_OS == M_OS_MACOSX || M_OS == M_OS_WINDOWS || (M_OS == M_OS_LINUX && M_OS_NAME == M_OS_NAME_ANDROID)
+		a.sin6_addr.s6_addr[0] = addr.host.quad[0] >> 24;
+		a.sin6_addr.s6_addr[1] = (addr.host.quad[0] >> 16) & 0xff;
+		a.sin6_addr.s6_addr[2] = (addr.host.quad[0] >> 8) & 0xff;
+		a.sin6_addr.s6_addr[3] = addr.host.quad[0] & 0xff;
+		a.sin6_addr.s6_addr[4] = addr.host.quad[1] >> 24;
+		a.sin6_addr.s6_addr[5] = (addr.host.quad[1] >> 16) & 0xff;
+		a.sin6_addr.s6_addr[6] = (addr.host.quad[1] >> 8) & 0xff;
+		a.sin6_addr.s6_addr[7] = addr.host.quad[1] & 0xff;
+		a.sin6_addr.s6_addr[8] = addr.host.quad[2] >> 24;
+		a.sin6_addr.s6_addr[9] = (addr.host.quad[2] >> 16) & 0xff;
+		a.sin6_addr.s6_addr[10] = (addr.host.quad[2] >> 8) & 0xff;
+		a.sin6_addr.s6_addr[11] = addr.host.quad[2] & 0xff;
+		a.sin6_addr.s6_addr[12] = addr.host.quad[3] >> 24;
+		a.sin6_addr.s6_addr[13] = (addr.host.quad[3] >> 16) & 0xff;
+		a.sin6_addr.s6_addr[14] = (addr.host.quad[3] >> 8) & 0xff;
+		a.sin6_addr.s6_addr[15] = addr.host.quad[3] & 0xff;
+#else
+		a.sin6_addr.__in6_u.__u6_addr32[0] = htonl(addr.host.quad[0]);
+		a.sin6_addr.__in6_u.__u6_addr32[1] = htonl(addr.host.quad[1]);
+		a.sin6_addr.__in6_u.__u6_addr32[2] = htonl(addr.host.quad[2]);
+		a.sin6_addr.__in6_u.__u6_addr32[3] = htonl(addr.host.quad[3]);
+#endif
+		a.sin6_port = htons(addr.port);
+		this->length = sizeof(a);
+	}
+}
+
+address native_address::to_address()const noexcept{
+	if(this->length == 0){
+		// undefined native address
+		return address(address::ip(0, 0, 0, 0), 0);
+	}
+
+	if(this->storage.ss_family == AF_INET){
+		const sockaddr_in& a = reinterpret_cast<const sockaddr_in&>(this->storage);
+		return address(
+				uint32_t(ntohl(a.sin_addr.s_addr)),
+				uint16_t(ntohs(a.sin_port))
+			);
+	}else{
+		ASSERT_INFO(this->storage.ss_family == AF_INET6, "ss_family = " << unsigned(this->storage.ss_family) << " AF_INET = " << AF_INET << " AF_INET6 = " << AF_INET6)
+		const sockaddr_in6& a = reinterpret_cast<const sockaddr_in6&>(this->storage);
+		return address(
+				address::ip(
+#if M_OS == M_OS_MACOSX || M_OS == M_OS_WINDOWS || (M_OS == M_OS_LINUX && M_OS_NAME == M_OS_NAME_ANDROID)
+						(uint32_t(a.sin6_addr.s6_addr[0]) << 24) | (uint32_t(a.sin6_addr.s6_addr[1]) << 16) | (uint32_t(a.sin6_addr.s6_addr[2]) << 8) | uint32_t(a.sin6_addr.s6_addr[3]),
+						(uint32_t(a.sin6_addr.s6_addr[4]) << 24) | (uint32_t(a.sin6_addr.s6_addr[5]) << 16) | (uint32_t(a.sin6_addr.s6_addr[6]) << 8) | uint32_t(a.sin6_addr.s6_addr[7]),
+						(uint32_t(a.sin6_addr.s6_addr[8]) << 24) | (uint32_t(a.sin6_addr.s6_addr[9]) << 16) | (uint32_t(a.sin6_addr.s6_addr[10]) << 8) | uint32_t(a.sin6_addr.s6_addr[11]),
+						(uint32_t(a.sin6_addr.s6_addr[12]) << 24) | (uint32_t(a.sin6_addr.s6_addr[13]) << 16) | (uint32_t(a.sin6_addr.s6_addr[14]) << 8) | uint32_t(a.sin6_addr.s6_addr[15])
+#else
+						uint32_t(ntohl(a.sin6_addr.__in6_u.__u6_addr32[0])),
+						uint32_t(ntohl(a.sin6_addr.__in6_u.__u6_addr32[1])),
+						uint32_t(ntohl(a.sin6_addr.__in6_u.__u6_addr32[2])),
+						uint32_t(ntohl(a.sin6_addr.__in6_u.__u6_addr32[3]))
+#endif
+					),
+				uint16_t(ntohs(a.sin6_port))
+			);
+	}
+}
+
+native_address native_address::to_v6()const noexcept{
+	if(!this->is_v4()){
+		return *this;
+	}
+
+	const sockaddr_in& a = reinterpret_cast<const sockaddr_in&>(this->storage);
+
+	native_address ret;
+	sockaddr_in6& b = reinterpret_cast<sockaddr_in6&>(ret.storage);
+	memset(&b, 0, sizeof(b));
+	b.sin6_family = AF_INET6;
+	b.sin6_addr.s6_addr[10] = 0xff;
+	b.sin6_addr.s6_addr[11] = 0xff;
+	memcpy(&b.sin6_addr.s6_addr[12], &a.sin_addr, sizeof(a.sin_addr));
+	b.sin6_port = a.sin_port;
+	ret.length = sizeof(b);
+
+	return ret;
+}
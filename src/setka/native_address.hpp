@@ -0,0 +1,99 @@
+#pragma once
+
+#include <utki/config.hpp>
+
+#if M_OS == M_OS_WINDOWS
+#	include <winsock2.h>
+#	include <ws2tcpip.h>
+#	include <utki/windows.hpp>
+
+#elif M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX || M_OS == M_OS_UNIX
+#	include <sys/socket.h>
+
+#else
+#	error "Unsupported OS"
+#endif
+
+#include "address.hpp"
+
+namespace setka{
+
+class udp_socket;
+class tcp_socket;
+class io_ring;
+
+/**
+ * @brief IP address in OS native format.
+ * Holds IP address converted to the socket address structure used by the OS.
+ * Converting the address to native format has a cost, so, when communicating with the same
+ * peers repeatedly, it makes sense to convert their addresses once and use the native_address objects
+ * for sending data or connecting.
+ * Receiving functions can also report the sender address as native_address,
+ * in which case it is converted to address only when needed.
+ */
+class native_address{
+	friend class setka::udp_socket;
+	friend class setka::tcp_socket;
+	friend class setka::io_ring;
+
+	sockaddr_storage storage;
+	socklen_t length;
+public:
+	/**
+	 * @brief Create an undefined native address.
+	 * The address family of undefined native address is AF_UNSPEC.
+	 */
+	native_address()noexcept :
+			storage{},
+			length(0)
+	{}
+
+	/**
+	 * @brief Convert address to native format.
+	 * IPv4 addresses are converted to native IPv4 addresses, the rest are converted to native IPv6 addresses.
+	 * @param a - address to convert.
+	 */
+	explicit native_address(const address& a)noexcept;
+
+	/**
+	 * @brief Convert native address back to address.
+	 * @return address corresponding to this native address.
+	 *         Invalid address, i.e. all zeroes host and zero port, for undefined native address.
+	 */
+	address to_address()const noexcept;
+
+	/**
+	 * @brief Convert to native IPv6 address.
+	 * Native IPv4 addresses are converted to native IPv4 mapped to IPv6 addresses,
+	 * native IPv6 addresses are returned as is.
+	 * @return native IPv6 address.
+	 */
+	native_address to_v6()const noexcept;
+
+	/**
+	 * @brief Check if it is native IPv4 address.
+	 * @return true if this object holds native IPv4 address.
+	 * @return false otherwise, including undefined native address.
+	 */
+	bool is_v4()const noexcept{
+		return this->length != 0 && this->storage.ss_family == AF_INET;
+	}
+
+	/**
+	 * @brief Get native socket address structure.
+	 * @return pointer to the native socket address structure.
+	 */
+	const sockaddr* get_sockaddr()const noexcept{
+		return reinterpret_cast<const sockaddr*>(&this->storage);
+	}
+
+	/**
+	 * @brief Get size of the native socket address structure.
+	 * @return size of the native socket address structure in bytes, 0 for undefined native address.
+	 */
+	socklen_t get_size()const noexcept{
+		return this->length;
+	}
+};
+
+}
@@ -0,0 +1,387 @@
+#include "reactor.hpp"
+
+#include <algorithm>
+
+#if M_OS == M_OS_LINUX
+#	include <unistd.h>
+#	include <sys/eventfd.h>
+#endif
+
+using namespace setka;
+
+reactor::reactor(unsigned capacity)
+#if M_OS == M_OS_LINUX
+		: events(capacity)
+#else
+		: wait_set(capacity + 1), // one extra for the queue of posted procedures
+		triggered(capacity + 1)
+#endif
+{
+#if M_OS == M_OS_LINUX
+	this->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if(this->epoll_fd < 0){
+		throw std::system_error(errno, std::generic_category(), "could not create reactor, epoll_create1() failed");
+	}
+
+	this->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(this->event_fd < 0){
+		int errorCode = errno;
+		close(this->epoll_fd);
+		throw std::system_error(errorCode, std::generic_category(), "could not create reactor, eventfd() failed");
+	}
+
+	// sockets are identified by their entries, and the event fd is identified by null pointer
+	epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = nullptr;
+	if(epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, this->event_fd, &ev) != 0){
+		int errorCode = errno;
+		close(this->event_fd);
+		close(this->epoll_fd);
+		throw std::system_error(errorCode, std::generic_category(), "could not create reactor, epoll_ctl() failed");
+	}
+#else
+	this->wait_set.add(this->posted, utki::make_flags({opros::ready::read}));
+#endif
+}
+
+reactor::~reactor()noexcept{
+	ASSERT_INFO(this->entries.empty(), "reactor::~reactor(): some sockets are still added to the reactor")
+
+#if M_OS == M_OS_LINUX
+	close(this->event_fd);
+	close(this->epoll_fd);
+#else
+	for(auto& e : this->entries){
+		this->wait_set.remove(e.second->s);
+	}
+	this->wait_set.remove(this->posted);
+#endif
+}
+
+#if M_OS != M_OS_LINUX
+utki::flags<opros::ready> reactor::get_wait_flags(const entry& e)noexcept{
+	utki::flags<opros::ready> flags;
+	if(e.want_read && e.read_handler){
+		flags.set(opros::ready::read);
+	}
+	if(e.want_write && e.write_handler){
+		flags.set(opros::ready::write);
+	}
+	return flags;
+}
+#endif
+
+reactor::entry& reactor::get_entry(const socket& s){
+	auto i = this->entries.find(&s);
+	if(i == this->entries.end()){
+		throw std::logic_error("reactor: socket is not added to the reactor");
+	}
+	return *i->second;
+}
+
+void reactor::enqueue(entry& e){
+	if(e.queued || !e.needs_dispatch()){
+		return;
+	}
+	this->pending.push_back(&e);
+	e.queued = true;
+}
+
+void reactor::add(socket& s, handler_type read_handler, handler_type write_handler, bool want_write){
+	if(!s.is_open()){
+		throw std::logic_error("reactor::add(): socket is not opened");
+	}
+	if(s.is_added()){
+		throw std::logic_error("reactor::add(): socket is added to a wait set");
+	}
+	if(this->entries.find(&s) != this->entries.end()){
+		throw std::logic_error("reactor::add(): socket is already added to the reactor");
+	}
+
+	auto e = std::make_unique<entry>(s, std::move(read_handler), std::move(write_handler), want_write);
+
+#if M_OS == M_OS_LINUX
+	// always watch for both reading and writing, in edge-triggered mode it does not cause extra wake ups
+	epoll_event ev;
+	ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	ev.data.ptr = e.get();
+
+	if(epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, s.sock, &ev) != 0){
+		throw std::system_error(errno, std::generic_category(), "could not add socket to reactor, epoll_ctl() failed");
+	}
+#else
+	this->wait_set.add(s, get_wait_flags(*e));
+#endif
+
+	// use the readiness already known from the socket
+	e->readable = s.flags().get(opros::ready::read) || s.flags().get(opros::ready::error);
+	e->writable = s.flags().get(opros::ready::write) || s.flags().get(opros::ready::error);
+
+	entry& ent = *e;
+	this->entries.insert(std::make_pair(&s, std::move(e)));
+
+	this->enqueue(ent);
+}
+
+void reactor::set_write_interest(socket& s, bool want_write){
+	entry& e = this->get_entry(s);
+
+	if(e.want_write == want_write){
+		return;
+	}
+	e.want_write = want_write;
+
+#if M_OS == M_OS_LINUX
+	// the socket is always watched for writing, the known readiness is used right away
+	this->enqueue(e);
+#else
+	this->wait_set.change(s, get_wait_flags(e));
+#endif
+}
+
+void reactor::set_read_interest(socket& s, bool want_read){
+	entry& e = this->get_entry(s);
+
+	if(e.want_read == want_read){
+		return;
+	}
+	e.want_read = want_read;
+
+#if M_OS == M_OS_LINUX
+	// the socket is always watched for reading, the known readiness is used right away
+	this->enqueue(e);
+#else
+	this->wait_set.change(s, get_wait_flags(e));
+#endif
+}
+
+void reactor::remove(socket& s)noexcept{
+	auto i = this->entries.find(&s);
+	if(i == this->entries.end()){
+		return;
+	}
+
+	entry& e = *i->second;
+
+#if M_OS == M_OS_LINUX
+	epoll_ctl(this->epoll_fd, EPOLL_CTL_DEL, s.sock, nullptr);
+#else
+	this->wait_set.remove(s);
+#endif
+
+	e.removed = true;
+
+	// keep the known readiness in the socket's readiness flags, e.g. for adding the socket to another reactor
+	if(e.readable){
+		s.readiness_flags.set(opros::ready::read);
+	}
+	if(e.writable){
+		s.readiness_flags.set(opros::ready::write);
+	}
+
+	if(e.queued){
+		auto p = std::find(this->pending.begin(), this->pending.end(), &e);
+		if(p != this->pending.end()){
+			this->pending.erase(p);
+		}
+		e.queued = false;
+	}
+
+	// the entry can be in the middle of dispatching, so keep it until dispatching is finished
+	this->removed_entries.push_back(std::move(i->second));
+	this->entries.erase(i);
+
+	if(this->dispatching.empty()){
+		this->removed_entries.clear();
+	}
+}
+
+bool reactor::wait(uint32_t timeout_ms){
+	bool has_posted = false;
+
+#if M_OS == M_OS_LINUX
+	int num_events = epoll_wait(this->epoll_fd, this->events.data(), int(this->events.size()), int(timeout_ms));
+	if(num_events < 0){
+		if(errno == EINTR){
+			return false;
+		}
+		throw std::system_error(errno, std::generic_category(), "could not wait for readiness, epoll_wait() failed");
+	}
+
+	for(int i = 0; i != num_events; ++i){
+		auto& ev = this->events[i];
+
+		if(!ev.data.ptr){
+			// event fd is signaled, reset it
+			uint64_t value;
+			if(read(this->event_fd, &value, sizeof(value)) < 0 && errno != EAGAIN){
+				throw std::system_error(errno, std::generic_category(), "could not reset reactor event, read() failed");
+			}
+			has_posted = true;
+			continue;
+		}
+
+		auto& e = *reinterpret_cast<entry*>(ev.data.ptr);
+
+		if(ev.events & (EPOLLIN | EPOLLRDHUP)){
+			e.readable = true;
+			e.s.readiness_flags.set(opros::ready::read);
+		}
+		if(ev.events & EPOLLOUT){
+			e.writable = true;
+			e.s.readiness_flags.set(opros::ready::write);
+		}
+		if(ev.events & (EPOLLERR | EPOLLHUP)){
+			// let the handlers find out the error by performing I/O
+			e.readable = true;
+			e.writable = true;
+			e.s.readiness_flags.set(opros::ready::error);
+		}
+
+		this->enqueue(e);
+	}
+#else
+	unsigned num_triggered = this->wait_set.wait(timeout_ms, utki::make_span(this->triggered));
+
+	for(unsigned i = 0; i != num_triggered; ++i){
+		if(this->triggered[i] == &this->posted){
+			has_posted = true;
+			continue;
+		}
+
+		auto& s = static_cast<socket&>(*this->triggered[i]);
+
+		auto j = this->entries.find(&s);
+		ASSERT(j != this->entries.end())
+		entry& e = *j->second;
+
+		if(s.flags().get(opros::ready::read)){
+			e.readable = true;
+		}
+		if(s.flags().get(opros::ready::write)){
+			e.writable = true;
+		}
+		if(s.flags().get(opros::ready::error)){
+			e.readable = true;
+			e.writable = true;
+		}
+
+		this->enqueue(e);
+	}
+#endif
+
+	return has_posted;
+}
+
+unsigned reactor::run_posted(){
+	unsigned num_run = 0;
+
+#if M_OS == M_OS_LINUX
+	for(;;){
+		std::function<void()> proc;
+		{
+			std::lock_guard<decltype(this->posted_mutex)> lock(this->posted_mutex);
+			if(this->posted.empty()){
+				break;
+			}
+			proc = std::move(this->posted.front());
+			this->posted.pop_front();
+		}
+
+		try{
+			proc();
+		}catch(...){
+			// the event fd is reset already, signal it again so that the rest of procedures are not forgotten
+			uint64_t one = 1;
+			if(write(this->event_fd, &one, sizeof(one)) < 0){
+				TRACE(<< "reactor::run_posted(): write() failed" << std::endl)
+			}
+			throw;
+		}
+		++num_run;
+	}
+#else
+	while(auto proc = this->posted.pop_front()){
+		proc();
+		++num_run;
+	}
+#endif
+
+	return num_run;
+}
+
+void reactor::post(std::function<void()> proc){
+#if M_OS == M_OS_LINUX
+	{
+		std::lock_guard<decltype(this->posted_mutex)> lock(this->posted_mutex);
+		this->posted.push_back(std::move(proc));
+	}
+
+	uint64_t one = 1;
+	if(write(this->event_fd, &one, sizeof(one)) < 0){
+		throw std::system_error(errno, std::generic_category(), "could not post procedure, write() failed");
+	}
+#else
+	this->posted.push_back(std::move(proc));
+#endif
+}
+
+unsigned reactor::run_once(uint32_t timeout_ms){
+	ASSERT(this->dispatching.empty())
+
+	// don't wait if some sockets are known to be ready, and don't wait past the earliest timer expiry
+	bool has_posted = this->wait(this->pending.empty() ? std::min(timeout_ms, this->timers.get_time_to_next_expiry()) : 0);
+
+	unsigned num_dispatched = has_posted ? this->run_posted() : 0;
+
+	std::swap(this->dispatching, this->pending);
+
+	size_t i = 0;
+	try{
+		for(; i != this->dispatching.size(); ++i){
+			entry& e = *this->dispatching[i];
+			if(e.removed){
+				continue;
+			}
+
+			e.queued = false;
+			++num_dispatched;
+
+			if(e.readable && e.want_read && e.read_handler){
+				if(e.read_handler()){
+					e.readable = false;
+				}
+			}
+
+			if(!e.removed && e.writable && e.want_write && e.write_handler){
+				if(e.write_handler()){
+					e.writable = false;
+				}
+			}
+
+			if(!e.removed){
+				this->enqueue(e);
+			}
+		}
+	}catch(...){
+		// keep the readiness of the sockets which were not dispatched
+		for(; i != this->dispatching.size(); ++i){
+			entry& e = *this->dispatching[i];
+			if(!e.removed){
+				e.queued = false;
+				this->enqueue(e);
+			}
+		}
+		this->dispatching.clear();
+		this->removed_entries.clear();
+		throw;
+	}
+
+	this->dispatching.clear();
+	this->removed_entries.clear();
+
+	num_dispatched += unsigned(this->timers.advance());
+
+	return num_dispatched;
+}
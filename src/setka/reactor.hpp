@@ -0,0 +1,216 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+#include <utki/config.hpp>
+
+#if M_OS == M_OS_LINUX
+#	include <sys/epoll.h>
+#else
+#	include <opros/wait_set.hpp>
+#	include <nitki/queue.hpp>
+#endif
+
+#include "socket.hpp"
+#include "timer_wheel.hpp"
+
+namespace setka{
+
+/**
+ * @brief Reactor dispatching socket readiness to handlers.
+ * Waits for readiness of many sockets at once and calls the read and write handlers of the sockets which became ready.
+ * On Linux the sockets are registered with epoll in edge-triggered mode, so the OS reports readiness of a socket
+ * only when it changes. The reactor remembers the reported readiness of each socket until the handler reports that
+ * the socket has no more data to read or no more space to write, i.e. the handler is expected to perform I/O in a loop
+ * until send()/recieve()/accept() report that the operation would block (e.g. return 0), and return true in that case.
+ * If the handler returns false, e.g. to let other sockets be served, then the socket is still considered ready and
+ * the handler is called again on the next iteration of the reactor loop without waiting for the OS to report readiness.
+ * On other OSes the reactor is implemented on top of opros::wait_set, i.e. the readiness is level-triggered.
+ *
+ * The reactor also has a timer wheel, the handlers of the timers armed on it are called from within run_once()
+ * after the socket handlers. E.g. connect, read and idle deadlines of the sockets can be implemented with the timers.
+ *
+ * The reactor also sets the readiness flags of the sockets, same as opros::wait_set does, so the readiness flags API
+ * can be used from within the handlers, e.g. tcp_socket::get_connection_state().
+ *
+ * A socket added to the reactor must not be added to any opros::wait_set, and it must not be moved or closed
+ * until it is removed from the reactor.
+ * The reactor is not thread-safe, all its methods, except post(), must be called from the same thread.
+ */
+class reactor{
+public:
+	/**
+	 * @brief Readiness handler.
+	 * @return true if the socket has no more readiness, i.e. the last I/O operation on the socket would block.
+	 * @return false if the socket can still be ready and the handler has to be called again.
+	 */
+	typedef std::function<bool()> handler_type;
+
+private:
+	struct entry{
+		socket& s;
+
+		handler_type read_handler;
+		handler_type write_handler;
+
+		bool want_read = true;
+		bool want_write;
+
+		bool readable = false;
+		bool writable = false;
+
+		bool queued = false; // whether the entry is in the pending list
+		bool removed = false;
+
+		entry(socket& s, handler_type&& read_handler, handler_type&& write_handler, bool want_write) :
+				s(s),
+				read_handler(std::move(read_handler)),
+				write_handler(std::move(write_handler)),
+				want_write(want_write)
+		{}
+
+		bool needs_dispatch()const noexcept{
+			return (this->readable && this->want_read && this->read_handler) || (this->writable && this->want_write && this->write_handler);
+		}
+	};
+
+	std::unordered_map<const socket*, std::unique_ptr<entry>> entries;
+
+	// entries which have to be dispatched without waiting for readiness
+	std::vector<entry*> pending;
+
+	std::vector<entry*> dispatching;
+
+	// entries removed while dispatching, they are destroyed after dispatching is finished
+	std::vector<std::unique_ptr<entry>> removed_entries;
+
+#if M_OS == M_OS_LINUX
+	int epoll_fd;
+	std::vector<epoll_event> events;
+
+	// signaled when procedures are posted
+	int event_fd;
+
+	std::mutex posted_mutex;
+	std::deque<std::function<void()>> posted;
+#else
+	opros::wait_set wait_set;
+	std::vector<opros::waitable*> triggered;
+
+	nitki::queue posted;
+#endif
+
+	timer_wheel timers;
+
+	void enqueue(entry& e);
+
+	// returns true if there are posted procedures to run
+	bool wait(uint32_t timeout_ms);
+
+	unsigned run_posted();
+
+	entry& get_entry(const socket& s);
+
+#if M_OS != M_OS_LINUX
+	static utki::flags<opros::ready> get_wait_flags(const entry& e)noexcept;
+#endif
+
+public:
+	/**
+	 * @brief Create reactor.
+	 * @param capacity - maximum number of sockets the reactor can serve. On Linux the number of sockets
+	 *                   is not limited, and the capacity only limits the number of readiness events retrieved from the OS at once.
+	 */
+	reactor(unsigned capacity = 1024);
+
+	reactor(const reactor&) = delete;
+	reactor& operator=(const reactor&) = delete;
+
+	~reactor()noexcept;
+
+	/**
+	 * @brief Add socket to the reactor.
+	 * If the readiness flags of the socket indicate readiness, e.g. the socket was moved from another reactor,
+	 * then the handlers are called on the next iteration of the reactor loop without waiting for the OS to report readiness.
+	 * @param s - socket to add.
+	 * @param read_handler - handler to call when the socket is ready for reading, can be empty.
+	 * @param write_handler - handler to call when the socket is ready for writing, can be empty.
+	 * @param want_write - whether the write handler should be called, see set_write_interest().
+	 */
+	void add(socket& s, handler_type read_handler, handler_type write_handler = nullptr, bool want_write = false);
+
+	/**
+	 * @brief Set whether the write handler of the socket should be called.
+	 * Usually, the write handler is only needed when there is some data waiting to be sent.
+	 * If the socket is known to be ready for writing, then the write handler is called on the next
+	 * iteration of the reactor loop.
+	 * @param s - socket added to the reactor.
+	 * @param want_write - whether the write handler should be called.
+	 */
+	void set_write_interest(socket& s, bool want_write);
+
+	/**
+	 * @brief Set whether the read handler of the socket should be called.
+	 * By default, the read handler is called whenever the socket is ready for reading.
+	 * Turning the read interest off allows leaving the socket unread without the reactor
+	 * calling the read handler over and over again.
+	 * If the socket is known to be ready for reading, then the read handler is called on the next
+	 * iteration of the reactor loop after the read interest is turned back on.
+	 * @param s - socket added to the reactor.
+	 * @param want_read - whether the read handler should be called.
+	 */
+	void set_read_interest(socket& s, bool want_read);
+
+	/**
+	 * @brief Remove socket from the reactor.
+	 * Can be called from within the handlers, including the handlers of the socket being removed.
+	 * The readiness of the socket known to the reactor is kept in the socket's readiness flags.
+	 * @param s - socket to remove.
+	 */
+	void remove(socket& s)noexcept;
+
+	/**
+	 * @brief Get number of sockets added to the reactor.
+	 * @return number of sockets added to the reactor.
+	 */
+	size_t size()const noexcept{
+		return this->entries.size();
+	}
+
+	/**
+	 * @brief Get timer wheel of the reactor.
+	 * The timers armed on the reactor's timer wheel expire from within run_once().
+	 * @return timer wheel of the reactor.
+	 */
+	timer_wheel& get_timers()noexcept{
+		return this->timers;
+	}
+
+	/**
+	 * @brief Run one iteration of the reactor loop.
+	 * Waits for readiness of the sockets and calls the handlers of the ready sockets.
+	 * If there are sockets known to be ready, then it does not wait.
+	 * It does not wait longer than until the earliest armed timer expires either.
+	 * Also runs the posted procedures and calls the handlers of the expired timers.
+	 * @param timeout_ms - maximum time to wait for readiness, in milliseconds.
+	 * @return number of sockets whose handlers were called plus number of posted procedures run plus number of expired timers.
+	 */
+	unsigned run_once(uint32_t timeout_ms);
+
+	/**
+	 * @brief Post procedure to the reactor.
+	 * The procedure is run from within run_once() by the thread which runs the reactor loop,
+	 * waking it up if it is waiting for readiness. So, it allows other threads to access the sockets
+	 * served by the reactor.
+	 * This method is thread-safe.
+	 * @param proc - procedure to run.
+	 */
+	void post(std::function<void()> proc);
+};
+
+}
@@ -0,0 +1,222 @@
+#include "reactor_pool.hpp"
+
+#include <algorithm>
+#include <future>
+#include <limits>
+#include <thread>
+
+using namespace setka;
+
+namespace{
+// worker run by the current thread
+thread_local const void* current_worker = nullptr;
+}
+
+void reactor_pool::worker::run(){
+	current_worker = this;
+
+	while(!this->quit){
+		// posted procedures wake up the worker, so there is no need for timeout
+		this->r.run_once(std::numeric_limits<uint32_t>::max());
+
+		this->load.store(this->r.size(), std::memory_order_relaxed);
+	}
+
+	current_worker = nullptr;
+}
+
+void reactor_pool::worker::accept_incoming(){
+	{
+		std::lock_guard<decltype(this->incoming_mutex)> lock(this->incoming_mutex);
+		std::swap(this->incoming_connections, this->accepting_connections);
+	}
+
+	for(auto& c : this->accepting_connections){
+		c.handler(std::move(c.s), this->index);
+	}
+	this->accepting_connections.clear();
+}
+
+reactor_pool::reactor_pool(unsigned num_workers, balancing policy, unsigned capacity) :
+		policy(policy)
+{
+	if(num_workers == 0){
+		num_workers = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	for(unsigned i = 0; i != num_workers; ++i){
+		this->workers.push_back(std::make_unique<worker>(i, capacity));
+	}
+
+	for(auto& w : this->workers){
+		w->start();
+	}
+}
+
+reactor_pool::~reactor_pool()noexcept{
+	ASSERT_INFO(this->listeners.empty(), "reactor_pool::~reactor_pool(): some listening sockets are still served")
+
+	for(auto& w : this->workers){
+		auto wp = w.get();
+		try{
+			w->r.post([wp](){
+				wp->quit = true;
+			});
+		}catch(...){
+			ASSERT_INFO(false, "reactor_pool::~reactor_pool(): could not stop worker thread")
+		}
+	}
+
+	for(auto& w : this->workers){
+		w->join();
+	}
+}
+
+void reactor_pool::post(unsigned worker_index, std::function<void()> proc){
+	this->workers.at(worker_index)->r.post(std::move(proc));
+}
+
+void reactor_pool::call(unsigned worker_index, const std::function<void()>& proc){
+	ASSERT(current_worker != this->workers[worker_index].get())
+
+	std::promise<void> done;
+	this->post(worker_index, [&proc, &done](){
+		try{
+			proc();
+			done.set_value();
+		}catch(...){
+			done.set_exception(std::current_exception());
+		}
+	});
+	done.get_future().get();
+}
+
+unsigned reactor_pool::select_worker()noexcept{
+	if(this->policy == balancing::round_robin){
+		return this->next_worker.fetch_add(1, std::memory_order_relaxed) % unsigned(this->workers.size());
+	}
+
+	ASSERT(this->policy == balancing::least_loaded)
+
+	unsigned ret = 0;
+	size_t min_load = std::numeric_limits<size_t>::max();
+	for(auto& w : this->workers){
+		size_t load = w->load.load(std::memory_order_relaxed);
+		if(load < min_load){
+			min_load = load;
+			ret = w->index;
+		}
+	}
+	return ret;
+}
+
+void reactor_pool::hand_over(unsigned worker_index, tcp_socket&& s, connection_handler_type handler){
+	worker& w = *this->workers.at(worker_index);
+
+	// count the connection right away, so that the connections handed over in a row are distributed evenly
+	w.load.fetch_add(1, std::memory_order_relaxed);
+
+	if(current_worker == &w){
+		handler(std::move(s), worker_index);
+		return;
+	}
+
+	bool was_empty;
+	{
+		std::lock_guard<decltype(w.incoming_mutex)> lock(w.incoming_mutex);
+		was_empty = w.incoming_connections.empty();
+		w.incoming_connections.push_back(worker::incoming{std::move(s), std::move(handler)});
+	}
+
+	// the worker is already notified if there were incoming connections
+	if(was_empty){
+		w.r.post([&w](){
+			w.accept_incoming();
+		});
+	}
+}
+
+void reactor_pool::dispatch(tcp_socket&& s, connection_handler_type handler){
+	if(!s.is_open()){
+		throw std::logic_error("reactor_pool::dispatch(): socket is not opened");
+	}
+	this->hand_over(this->select_worker(), std::move(s), std::move(handler));
+}
+
+void reactor_pool::migrate(tcp_socket& s, unsigned from_worker_index, unsigned to_worker_index, connection_handler_type handler){
+	if(!s.is_open()){
+		throw std::logic_error("reactor_pool::migrate(): socket is not opened");
+	}
+
+	worker& from = *this->workers.at(from_worker_index);
+	ASSERT_INFO(current_worker == &from, "reactor_pool::migrate(): called not from the thread of the worker which serves the socket")
+
+	// the reactor puts the known readiness to the socket's readiness flags, and they are moved along with the socket
+	from.r.remove(s);
+
+	this->hand_over(to_worker_index, std::move(s), std::move(handler));
+}
+
+void reactor_pool::serve(tcp_server_socket& s, connection_handler_type handler){
+	if(!s.is_open()){
+		throw std::logic_error("reactor_pool::serve(): socket is not opened");
+	}
+	if(this->listeners.find(&s) != this->listeners.end()){
+		throw std::logic_error("reactor_pool::serve(): socket is already served");
+	}
+
+	unsigned worker_index = this->next_acceptor % unsigned(this->workers.size());
+
+	auto li = this->listeners.emplace(&s, worker_index).first;
+
+	try{
+		this->call(worker_index, [this, &s, &handler, &l = li->second, worker_index](){
+			reactor& r = this->workers[worker_index]->r;
+
+			l.retry_timer.handler = [&r, &s](){
+				r.set_read_interest(s, true);
+			};
+
+			r.add(s, [this, &r, &s, &l, handler](){
+				for(;;){
+					std::error_code ec;
+					tcp_socket c = s.accept(ec);
+					if(ec){
+						// e.g. too many open files, the pending connections are left in the queue,
+						// keep the readiness and retry accepting them after a delay
+						TRACE(<< "reactor_pool: accept() failed: " << ec.message() << std::endl)
+						r.set_read_interest(s, false);
+						r.get_timers().arm(l.retry_timer, accept_retry_delay_ms);
+						return false;
+					}
+					if(!c.is_open()){
+						return true;
+					}
+					this->dispatch(std::move(c), handler);
+				}
+			});
+		});
+	}catch(...){
+		this->listeners.erase(li);
+		throw;
+	}
+
+	++this->next_acceptor;
+}
+
+void reactor_pool::unserve(tcp_server_socket& s){
+	auto i = this->listeners.find(&s);
+	if(i == this->listeners.end()){
+		return;
+	}
+
+	unsigned worker_index = i->second.worker_index;
+
+	this->call(worker_index, [this, &s, &l = i->second, worker_index](){
+		reactor& r = this->workers[worker_index]->r;
+		r.get_timers().disarm(l.retry_timer);
+		r.remove(s);
+	});
+
+	this->listeners.erase(i);
+}
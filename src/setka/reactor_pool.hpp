@@ -0,0 +1,217 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <nitki/thread.hpp>
+
+#include "reactor.hpp"
+#include "tcp_socket.hpp"
+#include "tcp_server_socket.hpp"
+
+namespace setka{
+
+/**
+ * @brief Pool of reactors run by worker threads.
+ * Each worker thread runs its own reactor, usually one worker per CPU core. Connections accepted on the listening sockets
+ * served by the pool are distributed among the workers according to the balancing policy. A connection can also
+ * be migrated from one worker to another, e.g. to group the connections which work on the same data.
+ *
+ * Sockets served by a worker must only be accessed from that worker's thread, i.e. from within the handlers of
+ * the worker's reactor and from the procedures posted to the worker.
+ * The handlers and the posted procedures must not throw exceptions.
+ */
+class reactor_pool{
+public:
+	/**
+	 * @brief Policy of distributing connections among the workers.
+	 */
+	enum class balancing{
+		/**
+		 * @brief Distribute connections to the workers in turn.
+		 */
+		round_robin,
+
+		/**
+		 * @brief Give connection to the worker which serves least number of sockets.
+		 */
+		least_loaded
+	};
+
+	/**
+	 * @brief Handler of connection handed over to a worker.
+	 * Called by the worker thread. The handler takes ownership of the socket and usually adds it to the worker's reactor.
+	 * @param s - the connection.
+	 * @param worker_index - index of the worker the connection is handed over to.
+	 */
+	typedef std::function<void(tcp_socket&& s, unsigned worker_index)> connection_handler_type;
+
+private:
+	class worker : public nitki::thread{
+	public:
+		const unsigned index;
+
+		reactor r;
+
+		// approximate number of sockets served by the worker
+		std::atomic<size_t> load{0};
+
+		bool quit = false;
+
+		struct incoming{
+			tcp_socket s;
+			connection_handler_type handler;
+		};
+
+		// connections handed over to the worker from other threads
+		std::mutex incoming_mutex;
+		std::vector<incoming> incoming_connections;
+		std::vector<incoming> accepting_connections;
+
+		worker(unsigned index, unsigned capacity) :
+				index(index),
+				r(capacity)
+		{}
+
+		void run()override;
+
+		void accept_incoming();
+	};
+
+	std::vector<std::unique_ptr<worker>> workers;
+
+	const balancing policy;
+
+	std::atomic<unsigned> next_worker{0};
+	unsigned next_acceptor = 0;
+
+	// delay before retrying to accept connections after accepting failed, e.g. due to too many open files
+	static constexpr uint32_t accept_retry_delay_ms = 100;
+
+	struct listener{
+		const unsigned worker_index;
+
+		// re-enables accepting connections after the retry delay, only accessed from the worker's thread
+		timer retry_timer;
+
+		listener(unsigned worker_index) :
+				worker_index(worker_index)
+		{}
+	};
+
+	// listening sockets served by the workers
+	std::unordered_map<const tcp_server_socket*, listener> listeners;
+
+	void hand_over(unsigned worker_index, tcp_socket&& s, connection_handler_type handler);
+
+public:
+	/**
+	 * @brief Create reactor pool and start its worker threads.
+	 * @param num_workers - number of worker threads. If 0, then the number of CPU cores is used.
+	 * @param policy - policy of distributing accepted connections among the workers.
+	 * @param capacity - capacity of each worker's reactor, see reactor::reactor().
+	 */
+	reactor_pool(unsigned num_workers = 0, balancing policy = balancing::round_robin, unsigned capacity = 1024);
+
+	reactor_pool(const reactor_pool&) = delete;
+	reactor_pool& operator=(const reactor_pool&) = delete;
+
+	/**
+	 * @brief Stop the worker threads.
+	 * All the sockets must be removed from the workers' reactors before destroying the pool,
+	 * including the listening sockets, see unserve().
+	 */
+	~reactor_pool()noexcept;
+
+	/**
+	 * @brief Get number of workers.
+	 * @return number of workers.
+	 */
+	size_t size()const noexcept{
+		return this->workers.size();
+	}
+
+	/**
+	 * @brief Get reactor of a worker.
+	 * The reactor must only be used from the worker's thread.
+	 * @param worker_index - index of the worker.
+	 * @return reactor of the worker.
+	 */
+	reactor& get_reactor(unsigned worker_index){
+		return this->workers.at(worker_index)->r;
+	}
+
+	/**
+	 * @brief Post procedure to a worker.
+	 * This method is thread-safe.
+	 * @param worker_index - index of the worker which has to run the procedure.
+	 * @param proc - procedure to run.
+	 */
+	void post(unsigned worker_index, std::function<void()> proc);
+
+	/**
+	 * @brief Run procedure by a worker and wait for it to complete.
+	 * Exception thrown by the procedure is rethrown to the caller.
+	 * Must not be called from the worker threads.
+	 * @param worker_index - index of the worker which has to run the procedure.
+	 * @param proc - procedure to run.
+	 */
+	void call(unsigned worker_index, const std::function<void()>& proc);
+
+	/**
+	 * @brief Select worker according to the balancing policy.
+	 * This method is thread-safe.
+	 * @return index of the selected worker.
+	 */
+	unsigned select_worker()noexcept;
+
+	/**
+	 * @brief Hand over connection to one of the workers.
+	 * The worker is selected according to the balancing policy.
+	 * This method is thread-safe.
+	 * @param s - connection to hand over, must not be added to any reactor or wait set.
+	 * @param handler - handler to call by the worker.
+	 */
+	void dispatch(tcp_socket&& s, connection_handler_type handler);
+
+	/**
+	 * @brief Migrate connection to another worker.
+	 * Removes the socket from the reactor of the current worker and hands it over to the destination worker.
+	 * The readiness of the socket is kept, so the data which was already reported as available is not missed.
+	 * Must be called from the thread of the worker which serves the socket.
+	 * @param s - connection to migrate, the socket object becomes closed after the call.
+	 * @param from_worker_index - index of the worker which serves the socket.
+	 * @param to_worker_index - index of the destination worker.
+	 * @param handler - handler to call by the destination worker.
+	 */
+	void migrate(tcp_socket& s, unsigned from_worker_index, unsigned to_worker_index, connection_handler_type handler);
+
+	/**
+	 * @brief Start accepting connections on the listening socket.
+	 * The listening socket is served by one of the workers which accepts the connections
+	 * and hands them over to the workers according to the balancing policy.
+	 * To accept connections on several workers in parallel, serve several listening sockets
+	 * opened with tcp_server_socket::open_sharded(), they are assigned to the workers in turn.
+	 * In case accepting connections fails, e.g. when there are too many open files, the pending connections
+	 * are left in the queue and accepting them is retried after a short delay.
+	 * Blocks until the listening socket is added to the worker's reactor.
+	 * Must not be called from the worker threads.
+	 * @param s - listening socket, it must not be moved or closed until unserved.
+	 * @param handler - handler of the accepted connections.
+	 */
+	void serve(tcp_server_socket& s, connection_handler_type handler);
+
+	/**
+	 * @brief Stop accepting connections on the listening socket.
+	 * Blocks until the listening socket is removed from the worker's reactor.
+	 * Must not be called from the worker threads.
+	 * @param s - listening socket passed to serve().
+	 */
+	void unserve(tcp_server_socket& s);
+};
+
+}
@@ -13,6 +13,16 @@
 
 using namespace setka;
 
+namespace{
+// on some OSes all the options are supported, so the function is not used
+[[noreturn, maybe_unused]] void throw_option_not_supported(const char* option_name){
+	throw std::system_error(
+			std::make_error_code(std::errc::not_supported),
+			std::string("could not set ") + option_name + " socket option, not supported by OS"
+		);
+}
+}
+
 socket::~socket()noexcept{
 	this->close();
 }
@@ -51,7 +61,10 @@ setka::socket& socket::operator=(socket&& s){
 	// if the waitable is added to some waitset
 	this->waitable::operator=(std::move(s));
 
+	// close() clears the readiness flags, keep the ones moved from the other socket
+	auto flags = this->readiness_flags;
 	this->close();
+	this->readiness_flags = flags;
 	this->sock = s.sock;
 
 #if M_OS == M_OS_WINDOWS
@@ -140,6 +153,157 @@ uint16_t socket::get_local_port(){
 	}
 }
 
+void socket::set_option(int level, int name, int value, const char* option_name){
+	if(setsockopt(this->sock, level, name, reinterpret_cast<const char*>(&value), sizeof(value)) == socket_error){
+#if M_OS == M_OS_WINDOWS
+		int errorCode = WSAGetLastError();
+#else
+		int errorCode = errno;
+#endif
+		throw std::system_error(
+				errorCode,
+				std::generic_category(),
+				std::string("could not set ") + option_name + " socket option, setsockopt() failed"
+			);
+	}
+}
+
+void socket::set_options(const socket_options& options, bool ipv4){
+	if(!this->is_open()){
+		throw std::logic_error("socket::set_options(): socket is not valid");
+	}
+
+	if(options.send_buffer_size){
+		this->set_option(SOL_SOCKET, SO_SNDBUF, *options.send_buffer_size, "SO_SNDBUF");
+	}
+
+	if(options.recieve_buffer_size){
+		this->set_option(SOL_SOCKET, SO_RCVBUF, *options.recieve_buffer_size, "SO_RCVBUF");
+	}
+
+	if(options.recieve_low_watermark){
+		this->set_option(SOL_SOCKET, SO_RCVLOWAT, *options.recieve_low_watermark, "SO_RCVLOWAT");
+	}
+
+	if(options.busy_poll_us){
+#if M_OS == M_OS_LINUX && defined(SO_BUSY_POLL)
+		this->set_option(SOL_SOCKET, SO_BUSY_POLL, *options.busy_poll_us, "SO_BUSY_POLL");
+#else
+		throw_option_not_supported("SO_BUSY_POLL");
+#endif
+	}
+
+	if(options.priority){
+#if M_OS == M_OS_LINUX
+		this->set_option(SOL_SOCKET, SO_PRIORITY, *options.priority, "SO_PRIORITY");
+#else
+		throw_option_not_supported("SO_PRIORITY");
+#endif
+	}
+
+	if(options.type_of_service){
+		if(ipv4){
+			this->set_option(IPPROTO_IP, IP_TOS, *options.type_of_service, "IP_TOS");
+		}else{
+#if defined(IPV6_TCLASS)
+			this->set_option(IPPROTO_IPV6, IPV6_TCLASS, *options.type_of_service, "IPV6_TCLASS");
+#else
+			throw_option_not_supported("IPV6_TCLASS");
+#endif
+#if M_OS == M_OS_LINUX
+			// dual-stack socket, the IPv4 traffic uses the IPv4 type of service
+			this->set_option(IPPROTO_IP, IP_TOS, *options.type_of_service, "IP_TOS");
+#endif
+		}
+	}
+
+	if(options.not_sent_low_watermark){
+#if defined(TCP_NOTSENT_LOWAT)
+		this->set_option(IPPROTO_TCP, TCP_NOTSENT_LOWAT, *options.not_sent_low_watermark, "TCP_NOTSENT_LOWAT");
+#else
+		throw_option_not_supported("TCP_NOTSENT_LOWAT");
+#endif
+	}
+
+	if(options.quick_ack){
+#if M_OS == M_OS_LINUX
+		this->set_option(IPPROTO_TCP, TCP_QUICKACK, *options.quick_ack ? 1 : 0, "TCP_QUICKACK");
+#else
+		throw_option_not_supported("TCP_QUICKACK");
+#endif
+	}
+
+	if(options.keepalive){
+		this->set_option(SOL_SOCKET, SO_KEEPALIVE, *options.keepalive ? 1 : 0, "SO_KEEPALIVE");
+	}
+
+	if(options.keepalive_idle_s){
+#if defined(TCP_KEEPIDLE)
+		this->set_option(IPPROTO_TCP, TCP_KEEPIDLE, *options.keepalive_idle_s, "TCP_KEEPIDLE");
+#elif defined(TCP_KEEPALIVE)
+		// on macOS the keepalive idle time option is named TCP_KEEPALIVE
+		this->set_option(IPPROTO_TCP, TCP_KEEPALIVE, *options.keepalive_idle_s, "TCP_KEEPALIVE");
+#else
+		throw_option_not_supported("TCP_KEEPIDLE");
+#endif
+	}
+
+	if(options.keepalive_interval_s){
+#if defined(TCP_KEEPINTVL)
+		this->set_option(IPPROTO_TCP, TCP_KEEPINTVL, *options.keepalive_interval_s, "TCP_KEEPINTVL");
+#else
+		throw_option_not_supported("TCP_KEEPINTVL");
+#endif
+	}
+
+	if(options.keepalive_count){
+#if defined(TCP_KEEPCNT)
+		this->set_option(IPPROTO_TCP, TCP_KEEPCNT, *options.keepalive_count, "TCP_KEEPCNT");
+#else
+		throw_option_not_supported("TCP_KEEPCNT");
+#endif
+	}
+
+	if(options.user_timeout_ms){
+#if M_OS == M_OS_LINUX && defined(TCP_USER_TIMEOUT)
+		this->set_option(IPPROTO_TCP, TCP_USER_TIMEOUT, int(*options.user_timeout_ms), "TCP_USER_TIMEOUT");
+#else
+		throw_option_not_supported("TCP_USER_TIMEOUT");
+#endif
+	}
+}
+
+void socket::set_options(const socket_options& options){
+	if(!this->is_open()){
+		throw std::logic_error("socket::set_options(): socket is not valid");
+	}
+
+	// find out the address family of the socket
+#if M_OS == M_OS_WINDOWS
+	WSAPROTOCOL_INFOW info;
+	int len = sizeof(info);
+
+	if(getsockopt(this->sock, SOL_SOCKET, SO_PROTOCOL_INFOW, reinterpret_cast<char*>(&info), &len) == socket_error){
+		throw std::system_error(WSAGetLastError(), std::generic_category(), "could not get socket address family, getsockopt() failed");
+	}
+
+	bool ipv4 = info.iAddressFamily == AF_INET;
+#elif M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX || M_OS == M_OS_UNIX
+	sockaddr_storage addr;
+	socklen_t len = sizeof(addr);
+
+	if(getsockname(this->sock, reinterpret_cast<sockaddr*>(&addr), &len) < 0){
+		throw std::system_error(errno, std::generic_category(), "could not get socket address family, getsockname() failed");
+	}
+
+	bool ipv4 = addr.ss_family == AF_INET;
+#else
+#	error "Unsupported OS"
+#endif
+
+	this->set_options(options, ipv4);
+}
+
 #if M_OS == M_OS_WINDOWS
 HANDLE socket::get_handle(){
 	return this->event_for_waitable;
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <sstream>
+#include <optional>
 
 #include <utki/config.hpp>
 #include <utki/debug.hpp>
@@ -27,11 +28,105 @@
 
 namespace setka{
 
+/**
+ * @brief Socket options.
+ * Only the options which have a value are set, the rest are left with the OS defaults.
+ * Setting an option which is not supported by the OS results in std::system_error with
+ * std::errc::not_supported error code.
+ */
+struct socket_options{
+	/**
+	 * @brief Size of the socket send buffer in bytes (SO_SNDBUF).
+	 */
+	std::optional<int> send_buffer_size;
+
+	/**
+	 * @brief Size of the socket receive buffer in bytes (SO_RCVBUF).
+	 * For TCP sockets it has to be set before the connection is established to have effect on the TCP window scaling,
+	 * i.e. at the socket opening.
+	 */
+	std::optional<int> recieve_buffer_size;
+
+	/**
+	 * @brief Minimum number of bytes in the receive buffer for the socket to become ready for reading (SO_RCVLOWAT).
+	 */
+	std::optional<int> recieve_low_watermark;
+
+	/**
+	 * @brief Busy polling time in microseconds when receiving with no data available (SO_BUSY_POLL).
+	 * Supported on Linux only.
+	 */
+	std::optional<int> busy_poll_us;
+
+	/**
+	 * @brief Priority of the packets sent by the socket, used for selecting the queue of the network device (SO_PRIORITY).
+	 * Supported on Linux only.
+	 */
+	std::optional<int> priority;
+
+	/**
+	 * @brief Type of service field of the IP packets sent by the socket (IP_TOS, IPV6_TCLASS).
+	 */
+	std::optional<int> type_of_service;
+
+	/**
+	 * @brief Limit of not yet sent data in the socket send buffer in bytes (TCP_NOTSENT_LOWAT).
+	 * The socket does not become ready for writing while the amount of not yet sent data is above the limit.
+	 * TCP only. Supported on Linux and macOS.
+	 */
+	std::optional<int> not_sent_low_watermark;
+
+	/**
+	 * @brief Send acknowledgements right away instead of delaying them (TCP_QUICKACK).
+	 * Note, that the OS may reset the mode during the connection life time.
+	 * TCP only. Supported on Linux only.
+	 */
+	std::optional<bool> quick_ack;
+
+	/**
+	 * @brief Enable sending of keepalive probes (SO_KEEPALIVE).
+	 * TCP only.
+	 */
+	std::optional<bool> keepalive;
+
+	/**
+	 * @brief Idle time of the connection in seconds before sending keepalive probes (TCP_KEEPIDLE).
+	 * TCP only.
+	 */
+	std::optional<int> keepalive_idle_s;
+
+	/**
+	 * @brief Interval between keepalive probes in seconds (TCP_KEEPINTVL).
+	 * TCP only.
+	 */
+	std::optional<int> keepalive_interval_s;
+
+	/**
+	 * @brief Number of unanswered keepalive probes before the connection is dropped (TCP_KEEPCNT).
+	 * TCP only.
+	 */
+	std::optional<int> keepalive_count;
+
+	/**
+	 * @brief Maximum time in milliseconds the sent data may remain unacknowledged before the connection is dropped (TCP_USER_TIMEOUT).
+	 * TCP only. Supported on Linux only.
+	 */
+	std::optional<unsigned> user_timeout_ms;
+};
+
+class reactor;
+class io_ring;
+class event_loop;
+
 /**
  * @brief Basic socket class.
  * This is a base class for all socket types such as TCP sockets or UDP sockets.
  */
 class socket : public opros::waitable{
+	friend class setka::reactor;
+	friend class setka::io_ring;
+	friend class setka::event_loop;
+
 protected:
 #if M_OS == M_OS_WINDOWS
 	typedef SOCKET socket_type;
@@ -76,6 +171,11 @@ protected:
 
 	void set_nonblocking_mode();
 
+	void set_options(const socket_options& options, bool ipv4);
+
+private:
+	void set_option(int level, int name, int value, const char* option_name);
+
 public:
 	socket(socket&& s) :
 			// NOTE: operator=() will call close(), so the socket should be in invalid state!!!
@@ -108,6 +208,15 @@ public:
 	 */
 	uint16_t get_local_port();
 
+	/**
+	 * @brief Set socket options.
+	 * Sets the options which have a value, see socket_options.
+	 * The options can also be set right at the socket opening, which is needed for some of the options to have effect.
+	 * @param options - options to set.
+	 * @throw std::system_error - if setting some of the options has failed.
+	 */
+	void set_options(const socket_options& options);
+
 #if M_OS == M_OS_WINDOWS
 private:
 	HANDLE get_handle()override;
@@ -0,0 +1,259 @@
+#include "tcp_connector.hpp"
+
+#include <limits>
+
+#include <utki/time.hpp>
+
+using namespace setka;
+
+namespace{
+const uint32_t no_timeout = std::numeric_limits<uint32_t>::max();
+}
+
+void tcp_connector::resolver::on_completed(dns_result r, address::ip ip)noexcept{
+	// called from DNS lookup thread, pass the result to the thread which calls update()
+	tcp_connector& c = this->owner;
+	bool v6 = this->v6;
+	c.queue.push_back([&c, v6, r, ip](){
+		c.on_resolved(v6, r, ip);
+	});
+}
+
+tcp_connector::tcp_connector(opros::wait_set& wait_set, uint32_t attempt_delay_ms) :
+		wait_set(wait_set),
+		attempt_delay_ms(attempt_delay_ms),
+		resolver_v6(*this, true),
+		resolver_v4(*this, false)
+{}
+
+tcp_connector::~tcp_connector()noexcept{
+	this->cancel_resolving();
+	this->cancel_attempts();
+}
+
+void tcp_connector::cancel_attempts()noexcept{
+	for(auto& s : this->attempts){
+		this->wait_set.remove(s);
+	}
+	this->attempts.clear();
+	this->candidates_v6.clear();
+	this->candidates_v4.clear();
+}
+
+void tcp_connector::cancel_resolving()noexcept{
+	if(this->resolver_v6.in_progress || this->resolver_v4.in_progress){
+		this->resolver_v6.cancel();
+		this->resolver_v4.cancel();
+		this->resolver_v6.in_progress = false;
+		this->resolver_v4.in_progress = false;
+		this->wait_set.remove(this->queue);
+
+		// drop results which could have been reported before canceling
+		while(this->queue.pop_front()){}
+	}
+	this->waiting_for_v6 = false;
+}
+
+void tcp_connector::add_candidate(const address& a){
+	if(a.host.is_v4()){
+		this->candidates_v4.push_back(a);
+	}else{
+		this->candidates_v6.push_back(a);
+	}
+}
+
+void tcp_connector::connect(utki::span<const address> candidates, bool disable_naggle){
+	if(this->cur_state == state::in_progress){
+		throw std::logic_error("tcp_connector::connect(): connecting is already in progress");
+	}
+
+	this->connected_socket.close();
+	this->error.clear();
+	this->disable_naggle = disable_naggle;
+	this->next_v6 = true;
+
+	for(auto& a : candidates){
+		this->add_candidate(a);
+	}
+
+	this->cur_state = state::in_progress;
+	this->next_attempt_time = utki::get_ticks_ms();
+}
+
+void tcp_connector::connect(const std::string& host_name, uint16_t port, uint32_t dns_timeout_ms, bool disable_naggle){
+	this->connect(utki::span<const address>(), disable_naggle);
+
+	this->port = port;
+
+	this->wait_set.add(this->queue, utki::make_flags({opros::ready::read}));
+
+	try{
+		this->resolver_v6.resolve(host_name, dns_timeout_ms, address(address::ip(0), 0), ip_version::v6);
+		this->resolver_v6.in_progress = true;
+		this->resolver_v4.resolve(host_name, dns_timeout_ms, address(address::ip(0), 0), ip_version::v4);
+		this->resolver_v4.in_progress = true;
+	}catch(...){
+		if(this->resolver_v6.in_progress){
+			this->cancel_resolving();
+		}else{
+			this->wait_set.remove(this->queue);
+		}
+		this->cur_state = state::idle;
+		throw;
+	}
+}
+
+void tcp_connector::on_resolved(bool v6, dns_result r, address::ip ip){
+	resolver& res = v6 ? this->resolver_v6 : this->resolver_v4;
+	if(!res.in_progress){
+		return;
+	}
+	res.in_progress = false;
+
+	if(r == dns_result::ok){
+		this->add_candidate(address(ip, this->port));
+	}else if(!this->error){
+		switch(r){
+			case dns_result::timeout:
+				this->error = std::make_error_code(std::errc::timed_out);
+				break;
+			case dns_result::not_found:
+				this->error = std::make_error_code(std::errc::host_unreachable);
+				break;
+			default:
+				this->error = std::make_error_code(std::errc::io_error);
+				break;
+		}
+	}
+
+	if(v6){
+		this->waiting_for_v6 = false;
+	}else if(this->resolver_v6.in_progress && r == dns_result::ok){
+		// give IPv6 lookup a little time to complete, to prefer IPv6
+		this->waiting_for_v6 = true;
+		this->resolution_deadline = utki::get_ticks_ms() + resolution_delay_ms;
+	}
+
+	if(!this->resolver_v6.in_progress && !this->resolver_v4.in_progress){
+		this->wait_set.remove(this->queue);
+	}
+}
+
+bool tcp_connector::start_attempt(){
+	// alternate IP versions, starting with IPv6
+	bool v6 = this->candidates_v4.empty() || (this->next_v6 && !this->candidates_v6.empty());
+	auto& candidates = v6 ? this->candidates_v6 : this->candidates_v4;
+
+	ASSERT(!candidates.empty())
+
+	address a = candidates.front();
+	candidates.pop_front();
+
+	this->next_v6 = !v6;
+
+	tcp_socket s;
+	try{
+		s.open(a, this->disable_naggle);
+	}catch(std::system_error& e){
+		// for example, there is no route to the host over this IP version
+		this->error = e.code();
+		return false;
+	}
+
+	this->attempts.push_back(std::move(s));
+	try{
+		this->wait_set.add(this->attempts.back(), utki::make_flags({opros::ready::write}));
+	}catch(...){
+		this->attempts.pop_back();
+		throw;
+	}
+	return true;
+}
+
+uint32_t tcp_connector::update(){
+	if(this->cur_state != state::in_progress){
+		return no_timeout;
+	}
+
+	// handle DNS lookup results
+	while(auto m = this->queue.pop_front()){
+		m();
+	}
+
+	uint32_t now = utki::get_ticks_ms();
+
+	for(auto i = this->attempts.begin(); i != this->attempts.end();){
+		switch(i->get_connection_state()){
+			case tcp_socket::connection_state::connected:
+				this->wait_set.remove(*i);
+				this->connected_socket = std::move(*i);
+				this->attempts.erase(i);
+				this->cancel_attempts();
+				this->cancel_resolving();
+				this->error.clear();
+				this->cur_state = state::connected;
+				return no_timeout;
+			case tcp_socket::connection_state::failed:
+				this->error = i->get_connection_error();
+				this->wait_set.remove(*i);
+				i = this->attempts.erase(i);
+
+				// do not wait for the attempt delay to expire when an attempt fails
+				this->next_attempt_time = now;
+				break;
+			default:
+				++i;
+				break;
+		}
+	}
+
+	if(this->waiting_for_v6 && int32_t(now - this->resolution_deadline) >= 0){
+		this->waiting_for_v6 = false;
+	}
+
+	if(!this->waiting_for_v6){
+		while(
+				(!this->candidates_v6.empty() || !this->candidates_v4.empty()) &&
+				(this->attempts.empty() || int32_t(now - this->next_attempt_time) >= 0)
+			)
+		{
+			if(this->start_attempt()){
+				this->next_attempt_time = now + this->attempt_delay_ms;
+				break;
+			}
+		}
+	}
+
+	if(this->attempts.empty() && this->candidates_v6.empty() && this->candidates_v4.empty()){
+		if(!this->resolver_v6.in_progress && !this->resolver_v4.in_progress){
+			if(!this->error){
+				this->error = std::make_error_code(std::errc::host_unreachable);
+			}
+			this->cur_state = state::failed;
+			return no_timeout;
+		}
+
+		// waiting for DNS lookup results
+		return no_timeout;
+	}
+
+	if(this->waiting_for_v6){
+		return this->resolution_deadline - now;
+	}
+
+	if(this->candidates_v6.empty() && this->candidates_v4.empty()){
+		// waiting for the connection attempts to complete
+		return no_timeout;
+	}
+
+	ASSERT(!this->attempts.empty())
+	return int32_t(this->next_attempt_time - now) > 0 ? this->next_attempt_time - now : 0;
+}
+
+tcp_socket tcp_connector::get_socket(){
+	if(this->cur_state != state::connected){
+		throw std::logic_error("tcp_connector::get_socket(): connector is not in connected state");
+	}
+	this->cur_state = state::idle;
+	return std::move(this->connected_socket);
+}
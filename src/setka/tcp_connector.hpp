@@ -0,0 +1,192 @@
+#pragma once
+
+#include <list>
+#include <deque>
+#include <string>
+#include <system_error>
+
+#include <utki/config.hpp>
+#include <utki/span.hpp>
+
+#include <opros/wait_set.hpp>
+
+#include <nitki/queue.hpp>
+
+#include "tcp_socket.hpp"
+#include "dns_resolver.hpp"
+
+namespace setka{
+
+/**
+ * @brief Dual-stack TCP connector.
+ * Establishes TCP connection to a host which has several IP addresses, e.g. both IPv6 and IPv4 ones,
+ * following the Happy Eyeballs algorithm (RFC 8305). The connection attempts to the candidate addresses are
+ * started one after another with a delay, alternating IPv6 and IPv4 addresses, without waiting for the previous
+ * attempts to fail. The first attempt which succeeds wins and the rest of the attempts are canceled.
+ * So, if one of the IP versions is broken on the way to the host, the connection is established over the other
+ * IP version without waiting for the OS connection timeout.
+ *
+ * The connector does not block. It adds its sockets to the given wait set, so the user has to call update()
+ * after each wait on that wait set, waiting not longer than the time returned by update().
+ */
+class tcp_connector{
+public:
+	/**
+	 * @brief State of the connector.
+	 */
+	enum class state{
+		/**
+		 * @brief Connecting is not started.
+		 */
+		idle,
+
+		/**
+		 * @brief Connecting is in progress.
+		 */
+		in_progress,
+
+		/**
+		 * @brief Connection is established.
+		 */
+		connected,
+
+		/**
+		 * @brief All connection attempts have failed.
+		 */
+		failed
+	};
+
+private:
+	opros::wait_set& wait_set;
+
+	uint32_t attempt_delay_ms;
+
+	state cur_state = state::idle;
+
+	std::error_code error;
+
+	bool disable_naggle = false;
+
+	// candidate addresses which are not tried yet
+	std::deque<address> candidates_v6;
+	std::deque<address> candidates_v4;
+	bool next_v6 = true;
+
+	std::list<tcp_socket> attempts;
+
+	tcp_socket connected_socket;
+
+	uint32_t next_attempt_time; // in milliseconds, as returned by utki::get_ticks_ms()
+
+	// DNS lookup
+	class resolver : public dns_resolver{
+	public:
+		tcp_connector& owner;
+		bool in_progress = false;
+		bool v6;
+
+		resolver(tcp_connector& owner, bool v6) :
+				owner(owner),
+				v6(v6)
+		{}
+
+		void on_completed(dns_result r, address::ip ip)noexcept override;
+	};
+
+	// DNS lookup results are reported from another thread via this queue
+	nitki::queue queue;
+
+	resolver resolver_v6;
+	resolver resolver_v4;
+
+	uint16_t port;
+
+	bool waiting_for_v6 = false; // waiting for IPv6 DNS lookup to complete, after IPv4 lookup has completed
+	uint32_t resolution_deadline; // in milliseconds, as returned by utki::get_ticks_ms()
+
+	void on_resolved(bool v6, dns_result r, address::ip ip);
+
+	void add_candidate(const address& a);
+
+	bool start_attempt();
+
+	void cancel_attempts()noexcept;
+
+	void cancel_resolving()noexcept;
+
+public:
+	/**
+	 * @brief Default delay between starting connection attempts, in milliseconds.
+	 */
+	static constexpr uint32_t default_attempt_delay_ms = 250;
+
+	/**
+	 * @brief Time to wait for IPv6 DNS lookup to complete after IPv4 lookup has completed, in milliseconds.
+	 */
+	static constexpr uint32_t resolution_delay_ms = 50;
+
+	/**
+	 * @brief Create connector.
+	 * @param wait_set - wait set to which the connector adds its sockets.
+	 * @param attempt_delay_ms - delay between starting connection attempts, in milliseconds.
+	 */
+	tcp_connector(opros::wait_set& wait_set, uint32_t attempt_delay_ms = default_attempt_delay_ms);
+
+	tcp_connector(const tcp_connector&) = delete;
+	tcp_connector& operator=(const tcp_connector&) = delete;
+
+	~tcp_connector()noexcept;
+
+	/**
+	 * @brief Start connecting to one of the given addresses.
+	 * @param candidates - candidate addresses of the host to connect to.
+	 * @param disable_naggle - enable/disable Naggle algorithm for the connection.
+	 */
+	void connect(utki::span<const address> candidates, bool disable_naggle = false);
+
+	/**
+	 * @brief Start connecting to the host.
+	 * Looks up both IPv6 and IPv4 addresses of the host and connects to one of them.
+	 * The library must be initialized, see init_guard.
+	 * @param host_name - domain name of the host to connect to.
+	 * @param port - IP port number to connect to.
+	 * @param dns_timeout_ms - timeout for DNS lookup in milliseconds.
+	 * @param disable_naggle - enable/disable Naggle algorithm for the connection.
+	 */
+	void connect(const std::string& host_name, uint16_t port, uint32_t dns_timeout_ms = 20000, bool disable_naggle = false);
+
+	/**
+	 * @brief Advance connecting.
+	 * Checks the results of the DNS lookups and connection attempts, and starts new connection attempts if needed.
+	 * Has to be called after each wait on the wait set.
+	 * @return maximum time in milliseconds to wait on the wait set before calling this function again,
+	 *         maximum value of uint32_t if there is no need to call it until some of the connector's waitables become ready.
+	 */
+	uint32_t update();
+
+	/**
+	 * @brief Get state of the connector.
+	 * @return state of the connector.
+	 */
+	state get_state()const noexcept{
+		return this->cur_state;
+	}
+
+	/**
+	 * @brief Get error.
+	 * @return error of the last failed connection attempt or DNS lookup, if the connector has failed.
+	 */
+	const std::error_code& get_error()const noexcept{
+		return this->error;
+	}
+
+	/**
+	 * @brief Get connected socket.
+	 * Moves the connected socket out of the connector, after that the connector becomes idle.
+	 * @return connected socket.
+	 * @throw std::logic_error - if the connector is not in connected state.
+	 */
+	tcp_socket get_socket();
+};
+
+}
@@ -0,0 +1,253 @@
+#include "tcp_relay.hpp"
+
+#include <cstring>
+
+#if M_OS == M_OS_LINUX
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
+using namespace setka;
+
+namespace{
+#if M_OS != M_OS_LINUX
+const size_t buffer_size = 0x10000;
+#endif
+}
+
+tcp_relay::direction::direction(tcp_socket& src, tcp_socket& dst) :
+		src(src),
+		dst(dst)
+{
+#if M_OS == M_OS_LINUX
+	if(pipe2(this->pipe_fds, O_NONBLOCK | O_CLOEXEC) != 0){
+		throw std::system_error(errno, std::generic_category(), "could not create relay pipe, pipe2() failed");
+	}
+
+	int capacity = fcntl(this->pipe_fds[0], F_GETPIPE_SZ);
+	if(capacity < 0){
+		int errorCode = errno;
+		close(this->pipe_fds[0]);
+		close(this->pipe_fds[1]);
+		throw std::system_error(errorCode, std::generic_category(), "could not get relay pipe size, fcntl(F_GETPIPE_SZ) failed");
+	}
+	this->capacity = size_t(capacity);
+#else
+	this->buffer.resize(buffer_size);
+#endif
+}
+
+tcp_relay::direction::~direction()noexcept{
+#if M_OS == M_OS_LINUX
+	close(this->pipe_fds[0]);
+	close(this->pipe_fds[1]);
+#endif
+}
+
+tcp_relay::tcp_relay(tcp_socket& a, tcp_socket& b) :
+		a_to_b(a, b),
+		b_to_a(b, a)
+{
+	if(!a.is_open() || !b.is_open()){
+		throw std::logic_error("tcp_relay::tcp_relay(): socket is not opened");
+	}
+}
+
+void tcp_relay::fill(direction& d){
+	if(d.eof || d.full){
+		return;
+	}
+
+	// read only if the source socket has indicated activity
+	if(!d.src.flags().get(opros::ready::read) && !d.src.flags().get(opros::ready::error)){
+		return;
+	}
+
+#if M_OS == M_OS_LINUX
+	d.src.readiness_flags.clear(opros::ready::read);
+
+	while(d.num_buffered != d.capacity){
+		ssize_t len = splice(
+				d.src.sock,
+				nullptr,
+				d.pipe_fds[1],
+				nullptr,
+				d.capacity - d.num_buffered,
+				SPLICE_F_MOVE | SPLICE_F_NONBLOCK
+			);
+		if(len < 0){
+			int errorCode = errno;
+			if(errorCode == EINTR){
+				continue;
+			}else if(errorCode == EAGAIN){
+				// Either no data available on the socket or the pipe is full, the pipe can be full before reaching
+				// its capacity in bytes because pipe slots are used per network packet.
+				// Assume the pipe is full if it has some data, reading will be resumed after some data is sent.
+				if(d.num_buffered != 0){
+					d.full = true;
+				}
+				return;
+			}else{
+				throw std::system_error(errorCode, std::generic_category(), "could not relay data, splice() from socket failed");
+			}
+		}
+
+		if(len == 0){
+			d.eof = true;
+			return;
+		}
+
+		d.num_buffered += size_t(len);
+	}
+
+	d.full = true;
+#else
+	if(d.begin != 0 && d.begin + d.num_buffered == d.buffer.size()){
+		memmove(d.buffer.data(), d.buffer.data() + d.begin, d.num_buffered);
+		d.begin = 0;
+	}
+
+	size_t end = d.begin + d.num_buffered;
+
+	// tcp_socket::recieve() reports both "no data available" and "connection closed" as 0 bytes received,
+	// and the readiness can be indicated without data available, e.g. on error, so call recv() directly
+	d.src.readiness_flags.clear(opros::ready::read);
+
+#if M_OS == M_OS_WINDOWS
+	int len;
+#else
+	ssize_t len;
+#endif
+
+	while(true){
+		len = ::recv(
+				d.src.sock,
+				reinterpret_cast<char*>(d.buffer.data() + end),
+				int(d.buffer.size() - end),
+				0
+			);
+		if(len == tcp_socket::socket_error){
+#if M_OS == M_OS_WINDOWS
+			int errorCode = WSAGetLastError();
+#else
+			int errorCode = errno;
+#endif
+			if(errorCode == tcp_socket::error_interrupted){
+				continue;
+			}else if(errorCode == tcp_socket::error_again){
+				return; // no data available
+			}else{
+				throw std::system_error(errorCode, std::generic_category(), "could not relay data, recv() failed");
+			}
+		}
+		break;
+	}
+
+	if(len == 0){
+		d.eof = true;
+		return;
+	}
+
+	d.num_buffered += size_t(len);
+
+	if(d.num_buffered == d.buffer.size()){
+		d.full = true;
+	}
+#endif
+}
+
+void tcp_relay::drain(direction& d){
+	if(d.num_buffered == 0){
+		return;
+	}
+
+#if M_OS == M_OS_LINUX
+	d.dst.readiness_flags.clear(opros::ready::write);
+
+	while(d.num_buffered != 0){
+		ssize_t len = splice(
+				d.pipe_fds[0],
+				nullptr,
+				d.dst.sock,
+				nullptr,
+				d.num_buffered,
+				SPLICE_F_MOVE | SPLICE_F_NONBLOCK
+			);
+		if(len < 0){
+			int errorCode = errno;
+			if(errorCode == EINTR){
+				continue;
+			}else if(errorCode == EAGAIN){
+				return; // socket send buffer is full
+			}else{
+				throw std::system_error(errorCode, std::generic_category(), "could not relay data, splice() to socket failed");
+			}
+		}
+
+		ASSERT(size_t(len) <= d.num_buffered)
+		d.num_buffered -= size_t(len);
+		d.full = false;
+	}
+#else
+	size_t len = d.dst.send(utki::span<uint8_t>(d.buffer.data() + d.begin, d.num_buffered));
+	if(len == 0){
+		return;
+	}
+
+	ASSERT(len <= d.num_buffered)
+	d.num_buffered -= len;
+	if(d.num_buffered == 0){
+		d.begin = 0;
+	}else{
+		d.begin += len;
+	}
+	d.full = false;
+#endif
+}
+
+void tcp_relay::update(direction& d){
+	if(d.shut_down){
+		return;
+	}
+
+	fill(d);
+	drain(d);
+
+	if(d.eof && d.num_buffered == 0){
+		// all data is delivered, propagate the half-close to the destination
+#if M_OS == M_OS_WINDOWS
+		if(shutdown(d.dst.sock, SD_SEND) == tcp_socket::socket_error){
+			int errorCode = WSAGetLastError();
+#else
+		if(shutdown(d.dst.sock, SHUT_WR) == tcp_socket::socket_error){
+			int errorCode = errno;
+#endif
+			throw std::system_error(errorCode, std::generic_category(), "could not relay connection close, shutdown() failed");
+		}
+		d.shut_down = true;
+	}
+}
+
+void tcp_relay::update(){
+	update(this->a_to_b);
+	update(this->b_to_a);
+}
+
+utki::flags<opros::ready> tcp_relay::get_waiting_flags(const tcp_socket& s)const noexcept{
+	ASSERT(&s == &this->a_to_b.src || &s == &this->b_to_a.src)
+
+	const direction& out = &s == &this->a_to_b.src ? this->a_to_b : this->b_to_a;
+	const direction& in = &s == &this->a_to_b.src ? this->b_to_a : this->a_to_b;
+
+	utki::flags<opros::ready> ret;
+
+	if(!out.eof && !out.full){
+		ret.set(opros::ready::read);
+	}
+
+	if(in.num_buffered != 0){
+		ret.set(opros::ready::write);
+	}
+
+	return ret;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <utki/config.hpp>
+#include <utki/flags.hpp>
+
+#include <opros/waitable.hpp>
+
+#include "tcp_socket.hpp"
+
+#if M_OS != M_OS_LINUX
+#	include <vector>
+#endif
+
+namespace setka{
+
+/**
+ * @brief Relay of data between two TCP sockets.
+ * Moves data received on each of the two sockets to the other socket, in both directions.
+ * On Linux the data is moved through a kernel pipe with splice() and never gets copied to user space,
+ * on other OSes the data is moved through a user space buffer.
+ *
+ * The relay is driven by readiness of the sockets: add both sockets to the wait set,
+ * waiting for the flags returned by get_waiting_flags(), and after each wait call update().
+ * When the waiting flags change the sockets have to be updated in the wait set.
+ * When one of the peers closes its sending side of the connection, the sending side of the other
+ * connection is shut down after all the remaining data is delivered (half-close).
+ * If the buffered data cannot be delivered to the destination socket, the relay stops reading
+ * from the source socket until there is free space in the buffer (backpressure).
+ *
+ * The relay does not own the sockets, they must remain valid for the whole life time of the relay object.
+ */
+class tcp_relay{
+	struct direction{
+		tcp_socket& src;
+		tcp_socket& dst;
+
+#if M_OS == M_OS_LINUX
+		int pipe_fds[2];
+		size_t capacity;
+#else
+		std::vector<uint8_t> buffer;
+		size_t begin = 0;
+#endif
+		size_t num_buffered = 0;
+
+		bool full = false; // no more data can be buffered until some is sent to the destination
+		bool eof = false; // source has closed its sending side of the connection
+		bool shut_down = false; // sending side of the destination connection was shut down
+
+		direction(tcp_socket& src, tcp_socket& dst);
+
+		direction(const direction&) = delete;
+		direction& operator=(const direction&) = delete;
+
+		~direction()noexcept;
+
+		bool is_done()const noexcept{
+			return this->shut_down;
+		}
+	};
+
+	direction a_to_b;
+	direction b_to_a;
+
+	static void fill(direction& d);
+	static void drain(direction& d);
+	static void update(direction& d);
+public:
+	/**
+	 * @brief Create relay between two connected TCP sockets.
+	 * @param a - first socket.
+	 * @param b - second socket.
+	 */
+	tcp_relay(tcp_socket& a, tcp_socket& b);
+
+	tcp_relay(const tcp_relay&) = delete;
+	tcp_relay& operator=(const tcp_relay&) = delete;
+
+	/**
+	 * @brief Move data between the sockets.
+	 * Moves as much data as possible at the moment in both directions according to the readiness flags of the sockets.
+	 * This function does not block.
+	 */
+	void update();
+
+	/**
+	 * @brief Get flags to wait for on a socket.
+	 * @param s - one of the two sockets of the relay.
+	 * @return readiness flags which should be waited for on the given socket.
+	 */
+	utki::flags<opros::ready> get_waiting_flags(const tcp_socket& s)const noexcept;
+
+	/**
+	 * @brief Check if relaying is finished.
+	 * @return true if both peers have closed their sending sides and all the data is delivered.
+	 * @return false otherwise.
+	 */
+	bool is_done()const noexcept{
+		return this->a_to_b.is_done() && this->b_to_a.is_done();
+	}
+};
+
+}
@@ -1,27 +1,67 @@
 #include "tcp_server_socket.hpp"
 
 #include <cstring>
+#include <array>
 
 #if M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX || M_OS == M_OS_UNIX
 #	include <netinet/in.h>
 #endif
 
+#if M_OS == M_OS_LINUX
+#	include <linux/filter.h>
+#	include <netinet/tcp.h>
+#endif
+
 using namespace setka;
 
-void tcp_server_socket::open(uint16_t port, bool disable_naggle, uint16_t queueLength){
+void tcp_server_socket::open(uint16_t port, bool disable_naggle, uint16_t queueLength, bool reuse_port, const socket_options& options){
+	this->open_local(address(address::ip(0, 0, 0, 0), port), true, disable_naggle, queueLength, reuse_port, options);
+}
+
+void tcp_server_socket::open(const address& local_address, bool disable_naggle, uint16_t queueLength, bool reuse_port, const socket_options& options){
+	this->open_local(local_address, false, disable_naggle, queueLength, reuse_port, options);
+}
+
+void tcp_server_socket::open_local(
+		const address& local_address,
+		bool dual_stack,
+		bool disable_naggle,
+		uint16_t queueLength,
+		bool reuse_port,
+		const socket_options& options
+	)
+{
 	if(this->is_open()){
 		throw std::logic_error("socket already opened");
 	}
 
+#ifndef SO_REUSEPORT
+	if(reuse_port){
+		throw std::system_error(int(std::errc::not_supported), std::generic_category(), "could not open TCP server socket, SO_REUSEPORT is not supported by OS");
+	}
+#endif
+
 	this->disable_naggle = disable_naggle;
 
 #if M_OS == M_OS_WINDOWS
 	this->create_event_for_waitable();
 #endif
 
-	bool ipv4 = false;
+	// in dual stack mode listen on any local address, both IPv4 and IPv6,
+	// otherwise the socket is of the local address family
+	bool ipv4 = !dual_stack && local_address.host.is_v4();
 	
-	this->sock = ::socket(PF_INET6, SOCK_STREAM, 0);
+	this->sock = ::socket(ipv4 ? PF_INET : PF_INET6, SOCK_STREAM, 0);
+
+	if(this->sock == invalid_socket && !dual_stack){
+#if M_OS == M_OS_WINDOWS
+		int errorCode = WSAGetLastError();
+		this->close_event_for_waitable();
+#else
+		int errorCode = errno;
+#endif
+		throw std::system_error(errorCode, std::generic_category(), "couldn't create TCP server socket, socket() failed");
+	}
 	
 	if(this->sock == invalid_socket){
 		// maybe IPv6 is not supported by OS, try creating IPv4 socket
@@ -39,7 +79,7 @@ void tcp_server_socket::open(uint16_t port, bool disable_naggle, uint16_t queueL
 	}
 	
 	// turn off IPv6 only mode to allow also accepting IPv4 connections
-	if(!ipv4){
+	if(dual_stack && !ipv4){
 #if M_OS == M_OS_WINDOWS
 		char no = 0;
 		const char* noPtr = &no;
@@ -71,36 +111,72 @@ void tcp_server_socket::open(uint16_t port, bool disable_naggle, uint16_t queueL
 		}
 	}
 	
+	// listen only on the IPv6 address given, even if it is any address
+	if(!dual_stack && !ipv4){
+#if M_OS == M_OS_WINDOWS
+		char yes = 1;
+		const char* yesPtr = &yes;
+#else
+		int yes = 1;
+		void* yesPtr = &yes;
+#endif
+		if(setsockopt(this->sock, IPPROTO_IPV6, IPV6_V6ONLY, yesPtr, sizeof(yes)) != 0){
+#if M_OS == M_OS_WINDOWS
+			int errorCode = WSAGetLastError();
+#else
+			int errorCode = errno;
+#endif
+			this->close();
+			throw std::system_error(errorCode, std::generic_category(), "could not set IPv6 only mode, setsockopt(IPV6_V6ONLY) failed");
+		}
+	}
+
 	// allow local address reuse
 	{
 		int yes = 1;
 		setsockopt(this->sock, SOL_SOCKET, SO_REUSEADDR, (char*)&yes, sizeof(yes));
 	}
 
-	sockaddr_storage sockAddr;
-	socklen_t sockAddrLen;
-	
-	if(ipv4){
-		sockaddr_in& sa = reinterpret_cast<sockaddr_in&>(sockAddr);
-		memset(&sa, 0, sizeof(sa));
-		sa.sin_family = AF_INET;
-		sa.sin_addr.s_addr = INADDR_ANY;
-		sa.sin_port = htons(port);
-		sockAddrLen = sizeof(sa);
-	}else{
-		sockaddr_in6& sa = reinterpret_cast<sockaddr_in6&>(sockAddr);
-		memset(&sa, 0, sizeof(sa));
-		sa.sin6_family = AF_INET6;
-		sa.sin6_addr = in6addr_any; // 'in6addr_any' allows accepting both IPv4 and IPv6 connections!!!
-		sa.sin6_port = htons(port);
-		sockAddrLen = sizeof(sa);
+#ifdef SO_REUSEPORT
+	// allow several sockets to listen on the same port
+	if(reuse_port){
+		int yes = 1;
+		if(setsockopt(this->sock, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) != 0){
+			int errorCode = errno;
+			this->close();
+			throw std::system_error(errorCode, std::generic_category(), "could not set reuse port mode, setsockopt(SO_REUSEPORT) failed");
+		}
+	}
+#endif
+
+#if M_OS == M_OS_LINUX
+	// on Linux the accepted sockets inherit TCP_NODELAY option from the listening socket,
+	// so set it once here instead of setting it on every accepted socket
+	if(this->disable_naggle){
+		this->socket::disable_naggle();
+	}
+#endif
+
+	// set options before listening, so that the accepted sockets inherit them where OS supports it
+	try{
+		this->set_options(options, ipv4);
+	}catch(...){
+		this->close();
+		throw;
 	}
 
+	// 'in6addr_any' allows accepting both IPv4 and IPv6 connections!!!
+	native_address sockAddr(
+			dual_stack ?
+					(ipv4 ? address(uint32_t(INADDR_ANY), local_address.port) : address(address::ip(0, 0, 0, 0), local_address.port)) :
+					local_address
+		);
+
 	// Bind the socket for listening
 	if(bind(
 			this->sock,
-			reinterpret_cast<sockaddr*>(&sockAddr),
-			sockAddrLen
+			sockAddr.get_sockaddr(),
+			sockAddr.get_size()
 		) == socket_error)
 	{
 #if M_OS == M_OS_WINDOWS
@@ -133,12 +209,8 @@ void tcp_server_socket::open(uint16_t port, bool disable_naggle, uint16_t queueL
 	this->set_nonblocking_mode();
 }
 
-tcp_socket tcp_server_socket::accept(){
-	if(!this->is_open()){
-		throw std::logic_error("tcp_server_socket::accept(): the socket is not opened");
-	}
-
-	this->readiness_flags.clear(opros::ready::read);
+bool tcp_server_socket::accept_connection(tcp_socket& s, std::error_code& ec){
+	ASSERT(!s.is_open())
 
 	sockaddr_storage sockAddr;
 
@@ -150,16 +222,37 @@ tcp_socket tcp_server_socket::accept(){
 #	error "Unsupported OS"
 #endif
 
-	tcp_socket s;
-
-	s.sock = ::accept(
-			this->sock,
-			reinterpret_cast<sockaddr*>(&sockAddr),
-			&sock_alen
-		);
-
-	if(s.sock == invalid_socket){
-		return s; // no connections to be accepted, return invalid socket
+	while(true){
+#if M_OS == M_OS_LINUX
+		// accept4() sets non-blocking mode right away, saving the fcntl() calls
+		s.sock = ::accept4(
+				this->sock,
+				reinterpret_cast<sockaddr*>(&sockAddr),
+				&sock_alen,
+				SOCK_NONBLOCK | SOCK_CLOEXEC
+			);
+#else
+		s.sock = ::accept(
+				this->sock,
+				reinterpret_cast<sockaddr*>(&sockAddr),
+				&sock_alen
+			);
+#endif
+		if(s.sock == invalid_socket){
+#if M_OS == M_OS_WINDOWS
+			int errorCode = WSAGetLastError();
+#else
+			int errorCode = errno;
+#endif
+			if(errorCode == error_interrupted){
+				continue;
+			}else if(errorCode != error_again){
+				// e.g. too many open files, the pending connections are left in the queue
+				ec.assign(errorCode, std::generic_category());
+			}
+			return false; // no connections to be accepted
+		}
+		break;
 	}
 
 #if M_OS == M_OS_WINDOWS
@@ -170,13 +263,198 @@ tcp_socket tcp_server_socket::accept(){
 	s.set_waiting_flags(utki::make_flags<opros::ready>({}));
 #endif
 
+#if M_OS != M_OS_LINUX
 	s.set_nonblocking_mode();
 
 	if(this->disable_naggle){
 		s.disable_naggle();
 	}
+#endif
+
+	return true;
+}
+
+std::vector<tcp_server_socket> tcp_server_socket::open_sharded(
+		size_t num_listeners,
+		uint16_t port,
+		bool disable_naggle,
+		uint16_t queue_size,
+		const socket_options& options
+	)
+{
+	return open_sharded_local(num_listeners, address(address::ip(0, 0, 0, 0), port), true, disable_naggle, queue_size, options);
+}
+
+std::vector<tcp_server_socket> tcp_server_socket::open_sharded(
+		size_t num_listeners,
+		const address& local_address,
+		bool disable_naggle,
+		uint16_t queue_size,
+		const socket_options& options
+	)
+{
+	return open_sharded_local(num_listeners, local_address, false, disable_naggle, queue_size, options);
+}
+
+std::vector<tcp_server_socket> tcp_server_socket::open_sharded_local(
+		size_t num_listeners,
+		const address& local_address,
+		bool dual_stack,
+		bool disable_naggle,
+		uint16_t queue_size,
+		const socket_options& options
+	)
+{
+	std::vector<tcp_server_socket> ret;
+	ret.reserve(num_listeners);
+
+	address addr = local_address;
+
+	for(size_t i = 0; i != num_listeners; ++i){
+		ret.emplace_back();
+		ret.back().open_local(addr, dual_stack, disable_naggle, queue_size, true, options);
+
+		// in case system assigned port was requested, the rest of the listeners should use the same port
+		addr.port = ret.back().get_local_port();
+	}
+
+	return ret;
+}
+
+bool tcp_server_socket::attach_cpu_steering(size_t num_listeners){
+	if(!this->is_open()){
+		throw std::logic_error("tcp_server_socket::attach_cpu_steering(): the socket is not opened");
+	}
+
+	if(num_listeners == 0){
+		throw std::logic_error("tcp_server_socket::attach_cpu_steering(): zero number of listeners");
+	}
+
+#if M_OS == M_OS_LINUX && defined(SO_ATTACH_REUSEPORT_CBPF)
+	// the program returns index of the listener in the reuse port group, the index is the current CPU number
+	// modulo the number of listeners
+	std::array<sock_filter, 3> code = {{
+		{BPF_LD | BPF_W | BPF_ABS, 0, 0, uint32_t(SKF_AD_OFF + SKF_AD_CPU)},
+		{BPF_ALU | BPF_MOD | BPF_K, 0, 0, uint32_t(num_listeners)},
+		{BPF_RET | BPF_A, 0, 0, 0}
+	}};
+
+	sock_fprog prog;
+	prog.len = (unsigned short)(code.size());
+	prog.filter = code.data();
+
+	return setsockopt(this->sock, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == 0;
+#else
+	return false;
+#endif
+}
+
+bool tcp_server_socket::enable_defer_accept(unsigned timeout_seconds){
+	if(!this->is_open()){
+		throw std::logic_error("tcp_server_socket::enable_defer_accept(): the socket is not opened");
+	}
+
+#if M_OS == M_OS_LINUX && defined(TCP_DEFER_ACCEPT)
+	int timeout = int(timeout_seconds);
+	return setsockopt(this->sock, IPPROTO_TCP, TCP_DEFER_ACCEPT, &timeout, sizeof(timeout)) == 0;
+#else
+	return false;
+#endif
+}
+
+bool tcp_server_socket::enable_fast_open(unsigned queue_size){
+	if(!this->is_open()){
+		throw std::logic_error("tcp_server_socket::enable_fast_open(): the socket is not opened");
+	}
+
+#if M_OS == M_OS_LINUX && defined(TCP_FASTOPEN)
+	int qlen = int(queue_size);
+	return setsockopt(this->sock, IPPROTO_TCP, TCP_FASTOPEN, &qlen, sizeof(qlen)) == 0;
+#else
+	return false;
+#endif
+}
+
+tcp_socket tcp_server_socket::accept(){
+	if(!this->is_open()){
+		throw std::logic_error("tcp_server_socket::accept(): the socket is not opened");
+	}
+
+	this->readiness_flags.clear(opros::ready::read);
+
+	tcp_socket s;
+
+	std::error_code ec;
+	this->accept_connection(s, ec);
+
+	return s; // return a newly created socket or invalid socket if there were no connections pending
+}
+
+tcp_socket tcp_server_socket::accept(std::error_code& ec)noexcept{
+	tcp_socket s;
+
+	if(!this->is_open()){
+		ec = std::make_error_code(std::errc::bad_file_descriptor);
+		return s;
+	}
+
+	ec.clear();
+
+	this->readiness_flags.clear(opros::ready::read);
+
+	try{
+		this->accept_connection(s, ec);
+	}catch(std::system_error& e){
+		// could not set up the accepted socket
+		s.close();
+		ec = e.code();
+	}
+
+	return s;
+}
+
+tcp_socket tcp_server_socket::accept(utki::span<uint8_t> first_data_buf, size_t& out_first_data_size){
+	tcp_socket s = this->accept();
+
+	if(s.is_open()){
+		out_first_data_size = s.recieve(first_data_buf);
+	}else{
+		out_first_data_size = 0;
+	}
+
+	return s;
+}
+
+size_t tcp_server_socket::accept(utki::span<tcp_socket> out_sockets){
+	if(!this->is_open()){
+		throw std::logic_error("tcp_server_socket::accept(): the socket is not opened");
+	}
+
+	// check all the output sockets before accepting anything, so that the accepted connections are not lost
+	for(auto& s : out_sockets){
+		if(s.is_open()){
+			throw std::logic_error("tcp_server_socket::accept(): output socket is already opened");
+		}
+	}
+
+	this->readiness_flags.clear(opros::ready::read);
+
+	size_t num_accepted = 0;
+
+	std::error_code ec;
+	for(auto& s : out_sockets){
+		if(!this->accept_connection(s, ec)){
+			break;
+		}
+		++num_accepted;
+	}
+
+	// in case some connections were accepted, the error is reported by the next call
+	if(num_accepted == 0 && ec){
+		throw std::system_error(ec, "could not accept connection, accept() failed");
+	}
 
-	return s; // return a newly created socket
+	return num_accepted;
 }
 
 #if M_OS == M_OS_WINDOWS
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <utki/config.hpp>
+#include <utki/span.hpp>
+
+#include <vector>
 
 #include "socket.hpp"
 #include "tcp_socket.hpp"
@@ -44,8 +47,113 @@ public:
 	 * @param port - IP port number to listen on.
 	 * @param disable_naggle - enable/disable Naggle algorithm for all accepted connections.
 	 * @param queue_size - the maximum number of pending connections.
+	 * @param reuse_port - allow several sockets to listen on the same port (SO_REUSEPORT). On Linux the incoming
+	 *                     connections are distributed among such sockets by the OS. Not supported on Windows.
+	 * @param options - socket options to set on the listening socket. Accepted sockets inherit most of the options on Linux.
+	 */
+	void open(
+			uint16_t port,
+			bool disable_naggle = false,
+			uint16_t queue_size = 50,
+			bool reuse_port = false,
+			const socket_options& options = socket_options()
+		);
+
+	/**
+	 * @brief Start listening on a local address.
+	 * Same as open(uint16_t, bool, uint16_t, bool, const socket_options&), but listens only on the given local IP address,
+	 * e.g. to accept connections coming through a specific network interface only.
+	 * The socket listens only for connections of the local address family, i.e. IPv4 local address, including 0.0.0.0,
+	 * gives IPv4 only socket, and IPv6 local address, including ::, gives IPv6 only socket. To listen on any local address
+	 * for both IPv4 and IPv6 connections use open(uint16_t, bool, uint16_t, bool, const socket_options&).
+	 * @param local_address - local IP address and port to listen on. If port is 0, then the port is assigned by the system.
+	 * @param disable_naggle - enable/disable Naggle algorithm for all accepted connections.
+	 * @param queue_size - the maximum number of pending connections.
+	 * @param reuse_port - allow several sockets to listen on the same address (SO_REUSEPORT).
+	 * @param options - socket options to set on the listening socket. Accepted sockets inherit most of the options on Linux.
+	 */
+	void open(
+			const address& local_address,
+			bool disable_naggle = false,
+			uint16_t queue_size = 50,
+			bool reuse_port = false,
+			const socket_options& options = socket_options()
+		);
+
+	/**
+	 * @brief Open several listening sockets on the same port.
+	 * Opens the requested number of listening sockets in reuse port mode, all listening on the same port.
+	 * On Linux the OS distributes incoming connections among these sockets, so each socket can be
+	 * served by its own thread to accept connections on several CPU cores in parallel.
+	 * @param num_listeners - number of listening sockets to open.
+	 * @param port - IP port number to listen on. If 0, then the port is assigned by the system.
+	 * @param disable_naggle - enable/disable Naggle algorithm for all accepted connections.
+	 * @param queue_size - the maximum number of pending connections for each socket.
+	 * @param options - socket options to set on the listening sockets.
+	 * @return opened listening sockets.
 	 */
-	void open(uint16_t port, bool disable_naggle = false, uint16_t queue_size = 50);
+	static std::vector<tcp_server_socket> open_sharded(
+			size_t num_listeners,
+			uint16_t port,
+			bool disable_naggle = false,
+			uint16_t queue_size = 50,
+			const socket_options& options = socket_options()
+		);
+
+	/**
+	 * @brief Open several listening sockets on the same local address.
+	 * Same as open_sharded() with port, but the sockets listen only on the given local IP address,
+	 * and only for connections of the local address family, see open(const address&, bool, uint16_t, bool, const socket_options&).
+	 * @param num_listeners - number of listening sockets to open.
+	 * @param local_address - local IP address and port to listen on. If port is 0, then the port is assigned by the system.
+	 * @param disable_naggle - enable/disable Naggle algorithm for all accepted connections.
+	 * @param queue_size - the maximum number of pending connections for each socket.
+	 * @param options - socket options to set on the listening sockets.
+	 * @return opened listening sockets.
+	 */
+	static std::vector<tcp_server_socket> open_sharded(
+			size_t num_listeners,
+			const address& local_address,
+			bool disable_naggle = false,
+			uint16_t queue_size = 50,
+			const socket_options& options = socket_options()
+		);
+
+	/**
+	 * @brief Steer connections to the listener of the receiving CPU.
+	 * Attaches a classic BPF program to the group of sockets listening on the same port in reuse port mode,
+	 * the program steers each incoming connection to the listening socket with index equal to the number
+	 * of the CPU which has received the connection, modulo the number of listeners. The index of the listening socket
+	 * is the order in which the sockets were opened, e.g. the index in the vector returned by open_sharded().
+	 * To get the benefit, the thread serving each listener should be bound to the corresponding CPU.
+	 * It is enough to call this function on one socket of the group.
+	 * Only supported on Linux.
+	 * @param num_listeners - number of sockets in the group.
+	 * @return true if the program was attached.
+	 * @return false if it is not supported by the OS.
+	 */
+	bool attach_cpu_steering(size_t num_listeners);
+
+	/**
+	 * @brief Enable deferred accept mode.
+	 * In deferred accept mode the connection is not reported as pending until some data arrives on it
+	 * or the timeout expires. This saves a wakeup per connection for protocols where the client
+	 * sends data first. Only supported on Linux.
+	 * @param timeout_seconds - number of seconds to wait for data to arrive on the connection.
+	 * @return true if deferred accept mode was enabled.
+	 * @return false if deferred accept mode is not supported by the OS.
+	 */
+	bool enable_defer_accept(unsigned timeout_seconds);
+
+	/**
+	 * @brief Enable TCP Fast Open.
+	 * Allows clients to send data along with the connection request, see tcp_socket::open(const address&, const utki::span<uint8_t>, bool, const socket_options&).
+	 * Only supported on Linux.
+	 * @param queue_size - maximum number of pending Fast Open connection requests which have not completed the handshake yet.
+	 * @return true if TCP Fast Open was enabled.
+	 * @return false if TCP Fast Open is not supported by the OS.
+	 */
+	bool enable_fast_open(unsigned queue_size);
 	
 	/**
 	 * @brief Accepts one of the pending connections, non-blocking.
@@ -60,8 +168,65 @@ public:
 	 */
 	tcp_socket accept();
 
-#if M_OS == M_OS_WINDOWS
+	/**
+	 * @brief Accept one of the pending connections without throwing exceptions.
+	 * Same as accept(), but reports errors via error code instead of throwing.
+	 * Unlike accept(), it also reports the errors of accepting the pending connections, e.g. when there are
+	 * too many open files. In this case the pending connections are left in the queue and can be accepted later.
+	 * @param ec - receives the error code, cleared on success or if there were no connections pending.
+	 *             Closed socket is reported as std::errc::bad_file_descriptor.
+	 * @return tcp_socket object, invalid socket object if there were no connections pending or in case of error.
+	 */
+	tcp_socket accept(std::error_code& ec)noexcept;
+
+	/**
+	 * @brief Accepts one of the pending connections together with the data already received on it, non-blocking.
+	 * Same as accept(), but also receives the data which has already arrived on the accepted connection,
+	 * saving a wait for readiness and a call to tcp_socket::recieve() for the typical case when the client
+	 * sends a request right after connecting. Goes well together with enable_defer_accept().
+	 * @param first_data_buf - buffer where to put the data received on the accepted connection.
+	 * @param out_first_data_size - returns number of bytes written to the buffer.
+	 * @return tcp_socket object, see accept().
+	 * @throw std::system_error - in case receiving on the accepted connection fails, the connection is closed in this case.
+	 */
+	tcp_socket accept(utki::span<uint8_t> first_data_buf, size_t& out_first_data_size);
+
+	/**
+	 * @brief Accepts pending connections, non-blocking.
+	 * Accepts as many pending connections as there are at the moment, but not more than the size of the output buffer.
+	 * This is more efficient than calling accept() for each connection.
+	 * This function does not block if there is no any pending connections, it just returns 0 in this case.
+	 * @param out_sockets - buffer of unopened socket objects where to put accepted connections,
+	 *                      the accepted sockets are put to the beginning of the buffer.
+	 * @return number of accepted connections.
+	 * @throw std::logic_error - if any of the output sockets is opened, nothing is accepted in this case.
+	 * @throw std::system_error - if accepting failed before any connection was accepted, e.g. when there are too many open files.
+	 *                            The pending connections are left in the queue and can be accepted later.
+	 */
+	size_t accept(utki::span<tcp_socket> out_sockets);
+
 private:
+	void open_local(
+			const address& local_address,
+			bool dual_stack,
+			bool disable_naggle,
+			uint16_t queue_size,
+			bool reuse_port,
+			const socket_options& options
+		);
+
+	static std::vector<tcp_server_socket> open_sharded_local(
+			size_t num_listeners,
+			const address& local_address,
+			bool dual_stack,
+			bool disable_naggle,
+			uint16_t queue_size,
+			const socket_options& options
+		);
+
+	bool accept_connection(tcp_socket& s, std::error_code& ec);
+
+#if M_OS == M_OS_WINDOWS
 	void set_waiting_flags(utki::flags<opros::ready> waiting_flags)override;
 #endif
 };
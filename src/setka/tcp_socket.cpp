@@ -1,14 +1,95 @@
 #include "tcp_socket.hpp"
 
 #include <cstring>
+#include <array>
+#include <algorithm>
+#include <limits>
+
+#include <utki/time.hpp>
 
 #if M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX || M_OS == M_OS_UNIX
 #	include <netinet/in.h>
+#	include <sys/uio.h>
+#endif
+
+#if M_OS == M_OS_LINUX
+#	include <linux/errqueue.h>
+#	include <linux/tcp.h> // for struct tcp_info with all the fields, netinet/tcp.h has a truncated one
+#	include <sys/sendfile.h>
+#elif M_OS == M_OS_MACOSX
+#	include <sys/types.h>
+#	include <sys/uio.h>
+#	include <netinet/tcp.h>
+#elif M_OS == M_OS_WINDOWS
+#	include <mstcpip.h>
+#endif
+
+#if M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX || M_OS == M_OS_UNIX
+#	include <unistd.h>
 #endif
 
 using namespace setka;
 
-void tcp_socket::open(const address& ip, bool disableNaggle){
+void tcp_socket::open(const address& ip, bool disableNaggle, const socket_options& options){
+	this->open(native_address(ip), disableNaggle, options);
+}
+
+void tcp_socket::open(const native_address& ip, bool disableNaggle, const socket_options& options){
+	this->create(ip, disableNaggle, options);
+	this->connect(ip);
+}
+
+size_t tcp_socket::open(const address& ip, const utki::span<uint8_t> data, bool disableNaggle, const socket_options& options){
+	return this->open(native_address(ip), data, disableNaggle, options);
+}
+
+size_t tcp_socket::open(const native_address& ip, const utki::span<uint8_t> data, bool disableNaggle, const socket_options& options){
+	this->create(ip, disableNaggle, options);
+
+#if M_OS == M_OS_LINUX && defined(MSG_FASTOPEN)
+	// send the data along with the connection request using TCP Fast Open,
+	// if there is no Fast Open cookie for the remote host yet, then the usual connection is initiated
+	// along with the cookie request and no data is sent
+	ssize_t len;
+
+	while(true){
+		len = sendto(
+				this->sock,
+				data.data(),
+				data.size(),
+				MSG_FASTOPEN,
+				ip.get_sockaddr(),
+				ip.get_size()
+			);
+		if(len == socket_error){
+			int errorCode = errno;
+			if(errorCode == error_interrupted){
+				continue;
+			}else if(errorCode == error_in_progress){
+				// connection is initiated, but no data sent
+				len = 0;
+			}else if(errorCode == EOPNOTSUPP){
+				// TCP Fast Open is disabled, connect in usual way
+				this->connect(ip);
+				len = 0;
+			}else{
+				this->close();
+				throw std::system_error(errorCode, std::generic_category(), "could not connect to remote host, sendto(MSG_FASTOPEN) failed");
+			}
+		}
+		break;
+	}
+
+	ASSERT(len >= 0)
+	return size_t(len);
+#else
+	// TCP Fast Open is not supported, connect in usual way
+	this->connect(ip);
+	return 0;
+#endif
+}
+
+void tcp_socket::create(const native_address& ip, bool disableNaggle, const socket_options& options){
 	if(this->is_open()){
 		throw std::logic_error("tcp_socket::open(): socket is already opened");
 	}
@@ -18,7 +99,7 @@ void tcp_socket::open(const address& ip, bool disableNaggle){
 #endif
 
 	this->sock = ::socket(
-			ip.host.is_v4() ? PF_INET : PF_INET6,
+			ip.is_v4() ? PF_INET : PF_INET6,
 			SOCK_STREAM,
 			0
 		);
@@ -37,55 +118,32 @@ void tcp_socket::open(const address& ip, bool disableNaggle){
 		this->disable_naggle();
 	}
 
+	// options are set before connecting, because some of them, e.g. receive buffer size, affect the connection setup
+	try{
+		this->set_options(options, ip.is_v4());
+	}catch(...){
+		this->close();
+		throw;
+	}
+
 	this->set_nonblocking_mode();
 
-	this->readiness_flags.clear();
+	this->zerocopy = false;
+	this->zerocopy_next_id = 0;
 
-	// connecting to remote host
-	sockaddr_storage sockAddr;
-	
-	if(ip.host.is_v4()){
-		sockaddr_in &sa = reinterpret_cast<sockaddr_in&>(sockAddr);
-		memset(&sa, 0, sizeof(sa));
-		sa.sin_family = AF_INET;
-		sa.sin_addr.s_addr = htonl(ip.host.get_v4());
-		sa.sin_port = htons(ip.port);
-	}else{
-		sockaddr_in6 &sa = reinterpret_cast<sockaddr_in6&>(sockAddr);
-		memset(&sa, 0, sizeof(sa));
-		sa.sin6_family = AF_INET6;
-#if M_OS == M_OS_MACOSX || M_OS == M_OS_WINDOWS || (M_OS == M_OS_LINUX && M_OS_NAME == M_OS_NAME_ANDROID)
-		sa.sin6_addr.s6_addr[0] = ip.host.quad[0] >> 24;
-		sa.sin6_addr.s6_addr[1] = (ip.host.quad[0] >> 16) & 0xff;
-		sa.sin6_addr.s6_addr[2] = (ip.host.quad[0] >> 8) & 0xff;
-		sa.sin6_addr.s6_addr[3] = ip.host.quad[0] & 0xff;
-		sa.sin6_addr.s6_addr[4] = ip.host.quad[1] >> 24;
-		sa.sin6_addr.s6_addr[5] = (ip.host.quad[1] >> 16) & 0xff;
-		sa.sin6_addr.s6_addr[6] = (ip.host.quad[1] >> 8) & 0xff;
-		sa.sin6_addr.s6_addr[7] = ip.host.quad[1] & 0xff;
-		sa.sin6_addr.s6_addr[8] = ip.host.quad[2] >> 24;
-		sa.sin6_addr.s6_addr[9] = (ip.host.quad[2] >> 16) & 0xff;
-		sa.sin6_addr.s6_addr[10] = (ip.host.quad[2] >> 8) & 0xff;
-		sa.sin6_addr.s6_addr[11] = ip.host.quad[2] & 0xff;
-		sa.sin6_addr.s6_addr[12] = ip.host.quad[3] >> 24;
-		sa.sin6_addr.s6_addr[13] = (ip.host.quad[3] >> 16) & 0xff;
-		sa.sin6_addr.s6_addr[14] = (ip.host.quad[3] >> 8) & 0xff;
-		sa.sin6_addr.s6_addr[15] = ip.host.quad[3] & 0xff;
+	this->state = connection_state::pending;
+	this->connection_error.clear();
+	this->has_connect_deadline = false;
 
-#else
-		sa.sin6_addr.__in6_u.__u6_addr32[0] = htonl(ip.host.quad[0]);
-		sa.sin6_addr.__in6_u.__u6_addr32[1] = htonl(ip.host.quad[1]);
-		sa.sin6_addr.__in6_u.__u6_addr32[2] = htonl(ip.host.quad[2]);
-		sa.sin6_addr.__in6_u.__u6_addr32[3] = htonl(ip.host.quad[3]);
-#endif
-		sa.sin6_port = htons(ip.port);
-	}
+	this->readiness_flags.clear();
+}
 
+void tcp_socket::connect(const native_address& ip){
 	// connect to the remote host
-	if(connect(
+	if(::connect(
 			this->sock,
-			reinterpret_cast<sockaddr *>(&sockAddr),
-			ip.host.is_v4() ? sizeof(sockaddr_in) : sizeof(sockaddr_in6) // NOTE: on Mac OS for some reason the size should be exactly according to AF_INET/AF_INET6
+			ip.get_sockaddr(),
+			ip.get_size() // NOTE: on Mac OS for some reason the size should be exactly according to AF_INET/AF_INET6
 		) == socket_error)
 	{
 #if M_OS == M_OS_WINDOWS
@@ -107,11 +165,106 @@ void tcp_socket::open(const address& ip, bool disableNaggle){
 	}
 }
 
+void tcp_socket::set_connect_timeout(uint32_t timeout_ms){
+	if(!this->is_open()){
+		throw std::logic_error("tcp_socket::set_connect_timeout(): socket is not opened");
+	}
+
+	this->connect_deadline = utki::get_ticks_ms() + timeout_ms;
+	this->has_connect_deadline = true;
+}
+
+tcp_socket::connection_state tcp_socket::get_connection_state(){
+	if(!this->is_open()){
+		throw std::logic_error("tcp_socket::get_connection_state(): socket is not opened");
+	}
+
+	if(this->state != connection_state::pending){
+		return this->state;
+	}
+
+	if(this->readiness_flags.get(opros::ready::write) || this->readiness_flags.get(opros::ready::error)){
+		// connection request has completed, check the result
+		int errorCode;
+
+#if M_OS == M_OS_WINDOWS
+		int len = sizeof(errorCode);
+#else
+		socklen_t len = sizeof(errorCode);
+#endif
+
+		if(getsockopt(this->sock, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&errorCode), &len) == socket_error){
+#if M_OS == M_OS_WINDOWS
+			errorCode = WSAGetLastError();
+#else
+			errorCode = errno;
+#endif
+			throw std::system_error(errorCode, std::generic_category(), "could not get connection status, getsockopt(SO_ERROR) failed");
+		}
+
+		if(errorCode == 0){
+			this->state = connection_state::connected;
+		}else{
+			this->state = connection_state::failed;
+			this->connection_error = std::error_code(errorCode, std::generic_category());
+		}
+	}else if(this->has_connect_deadline && int32_t(utki::get_ticks_ms() - this->connect_deadline) >= 0){
+		this->state = connection_state::failed;
+		this->connection_error = std::make_error_code(std::errc::timed_out);
+
+		// abort the connection request, otherwise the OS keeps on connecting and the connection
+		// may get established later while the socket is reported as failed
+#if M_OS == M_OS_WINDOWS
+		shutdown(this->sock, SD_BOTH);
+#elif M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX || M_OS == M_OS_UNIX
+		// connecting to unspecified address dissolves the association of the socket with the remote address
+		sockaddr unspec;
+		memset(&unspec, 0, sizeof(unspec));
+		unspec.sa_family = AF_UNSPEC;
+		if(::connect(this->sock, &unspec, sizeof(unspec)) != 0){
+			shutdown(this->sock, SHUT_RDWR);
+		}
+#else
+#	error "Unsupported OS"
+#endif
+	}
+
+	return this->state;
+}
+
+uint32_t tcp_socket::get_time_to_connect_deadline()const noexcept{
+	if(this->state != connection_state::pending || !this->has_connect_deadline){
+		return std::numeric_limits<uint32_t>::max();
+	}
+
+	int32_t left = int32_t(this->connect_deadline - utki::get_ticks_ms());
+	if(left <= 0){
+		return 0;
+	}
+	return uint32_t(left);
+}
+
 size_t tcp_socket::send(const utki::span<uint8_t> buf){
 	if(!this->is_open()){
 		throw std::logic_error("tcp_socket::Send(): socket is not opened");
 	}
 
+	std::error_code ec;
+	size_t ret = this->send(buf, ec);
+	if(ec){
+		throw std::system_error(ec, "could not send data over network, send() failed");
+	}
+	return ret;
+}
+
+size_t tcp_socket::send(const utki::span<uint8_t> buf, std::error_code& ec)noexcept{
+	if(!this->is_open()){
+		ec = std::make_error_code(std::errc::bad_file_descriptor);
+		return 0;
+	}
+
+	ec.clear();
+
 	this->readiness_flags.clear(opros::ready::write);
 
 #if M_OS == M_OS_WINDOWS
@@ -138,6 +291,253 @@ size_t tcp_socket::send(const utki::span<uint8_t> buf){
 			}else if(errorCode == error_again){
 				// can't send more bytes, return 0 bytes sent
 				len = 0;
+			}else{
+				ec.assign(errorCode, std::generic_category());
+				return 0;
+			}
+		}
+		break;
+	}
+
+	ASSERT(len >= 0)
+	return size_t(len);
+}
+
+size_t tcp_socket::send(utki::span<const utki::span<uint8_t>> bufs){
+	if(!this->is_open()){
+		throw std::logic_error("tcp_socket::send(): socket is not opened");
+	}
+
+	this->readiness_flags.clear(opros::ready::write);
+
+	size_t num_bufs = std::min(bufs.size(), max_num_buffers);
+
+#if M_OS == M_OS_WINDOWS
+	std::array<WSABUF, max_num_buffers> wsabufs;
+	for(size_t i = 0; i != num_bufs; ++i){
+		wsabufs[i].buf = reinterpret_cast<char*>(bufs[i].data());
+		wsabufs[i].len = ULONG(bufs[i].size());
+	}
+
+	DWORD len;
+
+	while(true){
+		if(WSASend(this->sock, wsabufs.data(), DWORD(num_bufs), &len, 0, nullptr, nullptr) == socket_error){
+			int errorCode = WSAGetLastError();
+			if(errorCode == error_interrupted){
+				continue;
+			}else if(errorCode == error_again){
+				// can't send more bytes, return 0 bytes sent
+				len = 0;
+			}else{
+				throw std::system_error(errorCode, std::generic_category(), "could not send data over network, WSASend() failed");
+			}
+		}
+		break;
+	}
+
+	return size_t(len);
+#elif M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX || M_OS == M_OS_UNIX
+	std::array<iovec, max_num_buffers> iovecs;
+	for(size_t i = 0; i != num_bufs; ++i){
+		iovecs[i].iov_base = bufs[i].data();
+		iovecs[i].iov_len = bufs[i].size();
+	}
+
+	msghdr h;
+	memset(&h, 0, sizeof(h));
+	h.msg_iov = iovecs.data();
+	h.msg_iovlen = num_bufs;
+
+	ssize_t len;
+
+	while(true){
+		len = sendmsg(this->sock, &h, 0);
+		if(len == socket_error){
+			int errorCode = errno;
+			if(errorCode == error_interrupted){
+				continue;
+			}else if(errorCode == error_again){
+				// can't send more bytes, return 0 bytes sent
+				len = 0;
+			}else{
+				throw std::system_error(errorCode, std::generic_category(), "could not send data over network, sendmsg() failed");
+			}
+		}
+		break;
+	}
+
+	ASSERT(len >= 0)
+	return size_t(len);
+#else
+#	error "Unsupported OS"
+#endif
+}
+
+size_t tcp_socket::send_file(file_handle_type file, uint64_t& offset, size_t count){
+	if(!this->is_open()){
+		throw std::logic_error("tcp_socket::send_file(): socket is not opened");
+	}
+
+	this->readiness_flags.clear(opros::ready::write);
+
+#if M_OS == M_OS_LINUX
+	off_t off = off_t(offset);
+
+	ssize_t len;
+
+	while(true){
+		len = sendfile(this->sock, file, &off, count);
+		if(len == socket_error){
+			int errorCode = errno;
+			if(errorCode == error_interrupted){
+				continue;
+			}else if(errorCode == error_again){
+				// can't send more bytes, return 0 bytes sent
+				len = 0;
+			}else{
+				throw std::system_error(errorCode, std::generic_category(), "could not send file over network, sendfile() failed");
+			}
+		}
+		break;
+	}
+
+	ASSERT(len >= 0)
+	ASSERT(uint64_t(off) == offset + uint64_t(len))
+	offset += uint64_t(len);
+	return size_t(len);
+#elif M_OS == M_OS_MACOSX
+	off_t len;
+
+	while(true){
+		len = off_t(count);
+		if(sendfile(file, this->sock, off_t(offset), &len, nullptr, 0) == socket_error){
+			int errorCode = errno;
+			// on EINTR and EAGAIN the number of bytes sent before interruption is reported in 'len'
+			if(errorCode == error_interrupted){
+				if(len == 0){
+					continue;
+				}
+			}else if(errorCode == error_again){
+				// can't send more bytes, return number of bytes sent so far
+			}else{
+				throw std::system_error(errorCode, std::generic_category(), "could not send file over network, sendfile() failed");
+			}
+		}
+		break;
+	}
+
+	ASSERT(len >= 0)
+	offset += uint64_t(len);
+	return size_t(len);
+#elif M_OS == M_OS_WINDOWS || M_OS == M_OS_UNIX
+	// no suitable system call, read the file data in chunks and send it
+
+	std::array<uint8_t, 0x4000> buf;
+
+	size_t num_sent = 0;
+
+	while(num_sent != count){
+		size_t chunk_size = std::min(count - num_sent, buf.size());
+
+#	if M_OS == M_OS_WINDOWS
+		OVERLAPPED ov;
+		memset(&ov, 0, sizeof(ov));
+		ov.Offset = DWORD(offset);
+		ov.OffsetHigh = DWORD(offset >> 32);
+
+		DWORD num_read;
+		if(!ReadFile(file, buf.data(), DWORD(chunk_size), &num_read, &ov)){
+			DWORD errorCode = GetLastError();
+			if(errorCode == ERROR_HANDLE_EOF){
+				num_read = 0;
+			}else{
+				throw std::system_error(int(errorCode), std::system_category(), "could not send file over network, ReadFile() failed");
+			}
+		}
+#	else
+		ssize_t num_read;
+		while(true){
+			num_read = pread(file, buf.data(), chunk_size, off_t(offset));
+			if(num_read < 0){
+				if(errno == EINTR){
+					continue;
+				}
+				throw std::system_error(errno, std::generic_category(), "could not send file over network, pread() failed");
+			}
+			break;
+		}
+#	endif
+		if(num_read == 0){
+			// end of file reached
+			break;
+		}
+
+		size_t len = this->send(utki::span<uint8_t>(buf.data(), size_t(num_read)));
+		num_sent += len;
+		offset += uint64_t(len);
+
+		if(len != size_t(num_read)){
+			// can't send more bytes
+			break;
+		}
+	}
+
+	return num_sent;
+#else
+#	error "Unsupported OS"
+#endif
+}
+
+bool tcp_socket::enable_zerocopy(){
+	if(!this->is_open()){
+		throw std::logic_error("tcp_socket::enable_zerocopy(): socket is not opened");
+	}
+
+#if M_OS == M_OS_LINUX && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+	int yes = 1;
+	if(setsockopt(this->sock, SOL_SOCKET, SO_ZEROCOPY, &yes, sizeof(yes)) != 0){
+		return false;
+	}
+	this->zerocopy = true;
+	return true;
+#else
+	return false;
+#endif
+}
+
+size_t tcp_socket::send_zerocopy(const utki::span<uint8_t> buf, uint32_t& out_id){
+	if(!this->is_open()){
+		throw std::logic_error("tcp_socket::send_zerocopy(): socket is not opened");
+	}
+
+	if(!this->zerocopy){
+		throw std::logic_error("tcp_socket::send_zerocopy(): zero-copy mode is not enabled");
+	}
+
+#if M_OS == M_OS_LINUX && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+	this->readiness_flags.clear(opros::ready::write);
+
+	ssize_t len;
+
+	while(true){
+		len = ::send(
+				this->sock,
+				buf.data(),
+				buf.size(),
+				MSG_ZEROCOPY
+			);
+		if(len == socket_error){
+			int errorCode = errno;
+			if(errorCode == error_interrupted){
+				continue;
+			}else if(errorCode == error_again){
+				// can't send more bytes, return 0 bytes sent
+				len = 0;
+			}else if(errorCode == ENOBUFS){
+				// too many zero-copy sends are pending completion, return 0 bytes sent,
+				// the user has to recieve completion notifications before sending more
+				len = 0;
 			}else{
 				throw std::system_error(errorCode, std::generic_category(), "could not send data over network, send() failed");
 			}
@@ -146,19 +546,113 @@ size_t tcp_socket::send(const utki::span<uint8_t> buf){
 	}
 
 	ASSERT(len >= 0)
+
+	// the OS assigns ids only to send operations which have actually sent some data
+	if(len != 0){
+		out_id = this->zerocopy_next_id;
+		++this->zerocopy_next_id;
+	}
+
 	return size_t(len);
+#else
+	ASSERT(false)
+	return 0;
+#endif
+}
+
+size_t tcp_socket::recieve_zerocopy_completions(utki::span<zerocopy_completion> out_completions){
+	// completions are reported via error queue, clear the error readiness flag at the beginning
+	this->readiness_flags.clear(opros::ready::error);
+
+	if(!this->is_open()){
+		throw std::logic_error("tcp_socket::recieve_zerocopy_completions(): socket is not opened");
+	}
+
+#if M_OS == M_OS_LINUX && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+	size_t num_received = 0;
+
+	while(num_received != out_completions.size()){
+		union{
+			char buf[CMSG_SPACE(sizeof(sock_extended_err))];
+			cmsghdr align;
+		} control;
+
+		msghdr h;
+		memset(&h, 0, sizeof(h));
+		h.msg_control = control.buf;
+		h.msg_controllen = sizeof(control.buf);
+
+		if(recvmsg(this->sock, &h, MSG_ERRQUEUE) == socket_error){
+			int errorCode = errno;
+			if(errorCode == error_interrupted){
+				continue;
+			}else if(errorCode == error_again){
+				break; // no more notifications in the error queue
+			}else{
+				throw std::system_error(errorCode, std::generic_category(), "could not receive zero-copy completions, recvmsg() failed");
+			}
+		}
+
+		for(cmsghdr* cm = CMSG_FIRSTHDR(&h); cm; cm = CMSG_NXTHDR(&h, cm)){
+			if(cm->cmsg_len < CMSG_LEN(sizeof(sock_extended_err))){
+				continue;
+			}
+			if(!(
+					(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+					(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)
+				))
+			{
+				continue;
+			}
+
+			sock_extended_err err;
+			memcpy(&err, CMSG_DATA(cm), sizeof(err));
+
+			if(err.ee_origin != SO_EE_ORIGIN_ZEROCOPY || err.ee_errno != 0){
+				continue;
+			}
+
+			auto& c = out_completions[num_received];
+			c.first_id = err.ee_info;
+			c.last_id = err.ee_data;
+			c.copied = (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+			++num_received;
+			break;
+		}
+	}
+
+	return num_received;
+#else
+	return 0;
+#endif
 }
 
 size_t tcp_socket::recieve(utki::span<uint8_t> buf){
+	if(!this->is_open()){
+		throw std::logic_error("tcp_socket::recieve(): socket is not opened");
+	}
+
+	std::error_code ec;
+	size_t ret = this->recieve(buf, ec);
+	if(ec){
+		throw std::system_error(ec, "could not receive data form network, recv() failed");
+	}
+	return ret;
+}
+
+size_t tcp_socket::recieve(utki::span<uint8_t> buf, std::error_code& ec)noexcept{
 	// the 'ready to read' flag shall be cleared even if this function fails to avoid subsequent
 	// calls to recv() because it indicates that there's activity.
 	// So, do it at the beginning of the function.
 	this->readiness_flags.clear(opros::ready::read);
 
 	if(!this->is_open()){
-		throw std::logic_error("tcp_socket::recieve(): socket is not opened");
+		ec = std::make_error_code(std::errc::bad_file_descriptor);
+		return 0;
 	}
 
+	ec.clear();
+
 #if M_OS == M_OS_WINDOWS
 	int len;
 #else
@@ -185,7 +679,8 @@ size_t tcp_socket::recieve(utki::span<uint8_t> buf){
 				// no data available, return 0 bytes received
 				len = 0;
 			}else{
-				throw std::system_error(errorCode, std::generic_category(), "could not receive data form network, recv() failed");
+				ec.assign(errorCode, std::generic_category());
+				return 0;
 			}
 		}
 		break;
@@ -195,37 +690,77 @@ size_t tcp_socket::recieve(utki::span<uint8_t> buf){
 	return size_t(len);
 }
 
-namespace{
-address make_ip_address(const sockaddr_storage& addr){
-	if(addr.ss_family == AF_INET){
-		const sockaddr_in &a = reinterpret_cast<const sockaddr_in&>(addr);
-		return address(
-			uint32_t(ntohl(a.sin_addr.s_addr)),
-			uint16_t(ntohs(a.sin_port))
-		);
-	}else{
-		ASSERT(addr.ss_family == AF_INET6)
-		
-		const sockaddr_in6 &a = reinterpret_cast<const sockaddr_in6&>(addr);
-		
-		return address(
-				address::ip(
-#if M_OS == M_OS_MACOSX || M_OS == M_OS_WINDOWS || (M_OS == M_OS_LINUX && M_OS_NAME == M_OS_NAME_ANDROID)
-						(uint32_t(a.sin6_addr.s6_addr[0]) << 24) | (uint32_t(a.sin6_addr.s6_addr[1]) << 16) | (uint32_t(a.sin6_addr.s6_addr[2]) << 8) | uint32_t(a.sin6_addr.s6_addr[3]),
-						(uint32_t(a.sin6_addr.s6_addr[4]) << 24) | (uint32_t(a.sin6_addr.s6_addr[5]) << 16) | (uint32_t(a.sin6_addr.s6_addr[6]) << 8) | uint32_t(a.sin6_addr.s6_addr[7]),
-						(uint32_t(a.sin6_addr.s6_addr[8]) << 24) | (uint32_t(a.sin6_addr.s6_addr[9]) << 16) | (uint32_t(a.sin6_addr.s6_addr[10]) << 8) | uint32_t(a.sin6_addr.s6_addr[11]),
-						(uint32_t(a.sin6_addr.s6_addr[12]) << 24) | (uint32_t(a.sin6_addr.s6_addr[13]) << 16) | (uint32_t(a.sin6_addr.s6_addr[14]) << 8) | uint32_t(a.sin6_addr.s6_addr[15])
+size_t tcp_socket::recieve(utki::span<const utki::span<uint8_t>> bufs){
+	// same as for single buffer receiving, clear the "can read" flag at the beginning
+	this->readiness_flags.clear(opros::ready::read);
+
+	if(!this->is_open()){
+		throw std::logic_error("tcp_socket::recieve(): socket is not opened");
+	}
+
+	size_t num_bufs = std::min(bufs.size(), max_num_buffers);
+
+#if M_OS == M_OS_WINDOWS
+	std::array<WSABUF, max_num_buffers> wsabufs;
+	for(size_t i = 0; i != num_bufs; ++i){
+		wsabufs[i].buf = reinterpret_cast<char*>(bufs[i].data());
+		wsabufs[i].len = ULONG(bufs[i].size());
+	}
+
+	DWORD len;
+
+	while(true){
+		DWORD flags = 0;
+		if(WSARecv(this->sock, wsabufs.data(), DWORD(num_bufs), &len, &flags, nullptr, nullptr) == socket_error){
+			int errorCode = WSAGetLastError();
+			if(errorCode == error_interrupted){
+				continue;
+			}else if(errorCode == error_again){
+				// no data available, return 0 bytes received
+				len = 0;
+			}else{
+				throw std::system_error(errorCode, std::generic_category(), "could not receive data form network, WSARecv() failed");
+			}
+		}
+		break;
+	}
+
+	return size_t(len);
+#elif M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX || M_OS == M_OS_UNIX
+	std::array<iovec, max_num_buffers> iovecs;
+	for(size_t i = 0; i != num_bufs; ++i){
+		iovecs[i].iov_base = bufs[i].data();
+		iovecs[i].iov_len = bufs[i].size();
+	}
+
+	msghdr h;
+	memset(&h, 0, sizeof(h));
+	h.msg_iov = iovecs.data();
+	h.msg_iovlen = num_bufs;
+
+	ssize_t len;
+
+	while(true){
+		len = recvmsg(this->sock, &h, 0);
+		if(len == socket_error){
+			int errorCode = errno;
+			if(errorCode == error_interrupted){
+				continue;
+			}else if(errorCode == error_again){
+				// no data available, return 0 bytes received
+				len = 0;
+			}else{
+				throw std::system_error(errorCode, std::generic_category(), "could not receive data form network, recvmsg() failed");
+			}
+		}
+		break;
+	}
+
+	ASSERT(len >= 0)
+	return size_t(len);
 #else
-						uint32_t(ntohl(a.sin6_addr.__in6_u.__u6_addr32[0])),
-						uint32_t(ntohl(a.sin6_addr.__in6_u.__u6_addr32[1])),
-						uint32_t(ntohl(a.sin6_addr.__in6_u.__u6_addr32[2])),
-						uint32_t(ntohl(a.sin6_addr.__in6_u.__u6_addr32[3]))
+#	error "Unsupported OS"
 #endif
-					),
-				uint16_t(ntohs(a.sin6_port))
-			);
-	}
-}
 }
 
 address tcp_socket::get_local_address(){
@@ -233,15 +768,15 @@ address tcp_socket::get_local_address(){
 		throw std::logic_error("Socket::get_local_address(): socket is not valid");
 	}
 
-	sockaddr_storage addr;
+	native_address addr;
 
 #if M_OS == M_OS_WINDOWS
-	int len = sizeof(addr);
+	int len = sizeof(addr.storage);
 #else
-	socklen_t len = sizeof(addr);
+	socklen_t len = sizeof(addr.storage);
 #endif
 
-	if(getsockname(this->sock, reinterpret_cast<sockaddr*>(&addr), &len) == socket_error){
+	if(getsockname(this->sock, reinterpret_cast<sockaddr*>(&addr.storage), &len) == socket_error){
 #if M_OS == M_OS_WINDOWS
 		int error_code = WSAGetLastError();
 #else
@@ -250,7 +785,9 @@ address tcp_socket::get_local_address(){
 		throw std::system_error(error_code, std::generic_category(), "could not get local address, getsockname() failed");
 	}	
 
-	return make_ip_address(addr);
+	addr.length = len;
+
+	return addr.to_address();
 }
 
 address tcp_socket::get_remote_address(){
@@ -258,15 +795,15 @@ address tcp_socket::get_remote_address(){
 		throw std::logic_error("tcp_socket::get_remote_address(): socket is not valid");
 	}
 
-	sockaddr_storage addr;
+	native_address addr;
 
 #if M_OS == M_OS_WINDOWS
-	int len = sizeof(addr);
+	int len = sizeof(addr.storage);
 #else
-	socklen_t len = sizeof(addr);
+	socklen_t len = sizeof(addr.storage);
 #endif
 
-	if(getpeername(this->sock, reinterpret_cast<sockaddr*>(&addr), &len) == socket_error){
+	if(getpeername(this->sock, reinterpret_cast<sockaddr*>(&addr.storage), &len) == socket_error){
 #if M_OS == M_WINDOWS
 		int error_code = WSAGetLastError();
 #else
@@ -275,7 +812,9 @@ address tcp_socket::get_remote_address(){
 		throw std::system_error(error_code, std::generic_category(), "could not get remote address, getpeername() failed");
 	}
 
-	return make_ip_address(addr);
+	addr.length = len;
+
+	return addr.to_address();
 }
 
 #if M_OS == M_OS_WINDOWS
@@ -291,3 +830,96 @@ void tcp_socket::set_waiting_flags(utki::flags<opros::ready> waiting_flags){
 	this->set_waiting_events_for_windows(flags);
 }
 #endif
+
+void tcp_socket::get_stats(stats& out_stats, std::error_code& ec)const noexcept{
+	out_stats = stats();
+
+	if(!this->is_open()){
+		ec = std::make_error_code(std::errc::bad_file_descriptor);
+		return;
+	}
+
+	ec.clear();
+
+#if M_OS == M_OS_LINUX
+	// older kernels fill only part of the structure, so the missing fields will remain zero
+	tcp_info info;
+	memset(&info, 0, sizeof(info));
+	socklen_t len = sizeof(info);
+
+	if(getsockopt(this->sock, IPPROTO_TCP, TCP_INFO, &info, &len) != 0){
+		ec.assign(errno, std::generic_category());
+		return;
+	}
+
+	out_stats.rtt_us = info.tcpi_rtt;
+	out_stats.rtt_variance_us = info.tcpi_rttvar;
+	out_stats.num_retransmits = info.tcpi_total_retrans;
+	out_stats.mss = info.tcpi_snd_mss;
+	out_stats.congestion_window = uint64_t(info.tcpi_snd_cwnd) * info.tcpi_snd_mss;
+	out_stats.unacked_bytes = uint64_t(info.tcpi_unacked) * info.tcpi_snd_mss;
+	out_stats.pacing_rate = info.tcpi_pacing_rate;
+#elif M_OS == M_OS_MACOSX && defined(TCP_CONNECTION_INFO)
+	tcp_connection_info info;
+	memset(&info, 0, sizeof(info));
+	socklen_t len = sizeof(info);
+
+	if(getsockopt(this->sock, IPPROTO_TCP, TCP_CONNECTION_INFO, &info, &len) != 0){
+		ec.assign(errno, std::generic_category());
+		return;
+	}
+
+	// round trip times are reported in milliseconds
+	out_stats.rtt_us = info.tcpi_srtt * 1000;
+	out_stats.rtt_variance_us = info.tcpi_rttvar * 1000;
+	out_stats.num_retransmits = uint32_t(info.tcpi_txretransmitpackets);
+	out_stats.mss = info.tcpi_maxseg;
+	out_stats.congestion_window = info.tcpi_snd_cwnd;
+#elif M_OS == M_OS_WINDOWS && defined(SIO_TCP_INFO)
+	DWORD version = 0;
+	TCP_INFO_v0 info;
+	DWORD len;
+
+	if(WSAIoctl(this->sock, SIO_TCP_INFO, &version, sizeof(version), &info, sizeof(info), &len, nullptr, nullptr) != 0){
+		ec.assign(WSAGetLastError(), std::generic_category());
+		return;
+	}
+
+	out_stats.rtt_us = info.RttUs;
+	out_stats.mss = info.Mss;
+	out_stats.num_retransmits = info.Mss == 0 ? 0 : uint32_t(info.BytesRetrans / info.Mss);
+	out_stats.congestion_window = info.Cwnd;
+	out_stats.unacked_bytes = info.BytesInFlight;
+#else
+	ec = std::make_error_code(std::errc::not_supported);
+#endif
+}
+
+tcp_socket::stats tcp_socket::get_stats()const{
+	stats ret;
+	std::error_code ec;
+	this->get_stats(ret, ec);
+	if(ec){
+		throw std::system_error(ec, "could not get TCP connection statistics");
+	}
+	return ret;
+}
+
+size_t tcp_socket::get_stats(utki::span<const tcp_socket* const> sockets, utki::span<stats> out_stats)noexcept{
+	size_t num_obtained = 0;
+	std::error_code ec;
+
+	size_t num_sockets = std::min(sockets.size(), out_stats.size());
+	for(size_t i = 0; i != num_sockets; ++i){
+		if(!sockets[i]){
+			out_stats[i] = stats();
+			continue;
+		}
+		sockets[i]->get_stats(out_stats[i], ec);
+		if(!ec){
+			++num_obtained;
+		}
+	}
+
+	return num_obtained;
+}
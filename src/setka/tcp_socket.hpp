@@ -1,21 +1,65 @@
 #pragma once
 
+#include <system_error>
+
 #include <utki/config.hpp>
 #include <utki/span.hpp>
 
 #include "socket.hpp"
 #include "address.hpp"
+#include "native_address.hpp"
 
 namespace setka{
 
 class tcp_server_socket;
+class tcp_relay;
+class io_ring;
 
 /**
  * @brief a class which represents a TCP socket.
  */
 class tcp_socket : public socket{
 	friend class setka::tcp_server_socket;
+	friend class setka::tcp_relay;
+	friend class setka::io_ring;
+
+	bool zerocopy = false; // whether zero-copy sending mode is enabled
+	uint32_t zerocopy_next_id = 0; // id to be assigned to the next zero-copy send
+
+public:
+	/**
+	 * @brief State of the connection.
+	 */
+	enum class connection_state{
+		/**
+		 * @brief Connection request is in progress.
+		 */
+		pending,
+
+		/**
+		 * @brief Connection is established.
+		 */
+		connected,
+
+		/**
+		 * @brief Connection request has failed.
+		 */
+		failed
+	};
+
+private:
+	connection_state state = connection_state::connected; // accepted sockets are connected from the beginning
+	std::error_code connection_error;
+
+	bool has_connect_deadline = false;
+	uint32_t connect_deadline; // in milliseconds, as returned by utki::get_ticks_ms()
+
 public:
+	/**
+	 * @brief Maximum number of buffers handled by one vectored send or receive call.
+	 */
+	static constexpr size_t max_num_buffers = 64;
+
 	
 	/**
 	 * @brief Constructs an invalid TCP socket object.
@@ -28,11 +72,23 @@ public:
 	tcp_socket& operator=(const tcp_socket&) = delete;
 	
 	tcp_socket(tcp_socket&& s) :
-			socket(std::move(s))
+			socket(std::move(s)),
+			zerocopy(s.zerocopy),
+			zerocopy_next_id(s.zerocopy_next_id),
+			state(s.state),
+			connection_error(s.connection_error),
+			has_connect_deadline(s.has_connect_deadline),
+			connect_deadline(s.connect_deadline)
 	{}
 
 	tcp_socket& operator=(tcp_socket&& s){
 		this->socket::operator=(std::move(s));
+		this->zerocopy = s.zerocopy;
+		this->zerocopy_next_id = s.zerocopy_next_id;
+		this->state = s.state;
+		this->connection_error = s.connection_error;
+		this->has_connect_deadline = s.has_connect_deadline;
+		this->connect_deadline = s.connect_deadline;
 		return *this;
 	}
 	
@@ -41,8 +97,85 @@ public:
 	 * This method connects the socket to remote TCP server socket.
 	 * @param address - IP address.
 	 * @param disable_naggle - enable/disable Naggle algorithm.
+	 * @param options - socket options to set before connecting.
+	 */
+	void open(const address& address, bool disable_naggle = false, const socket_options& options = socket_options());
+
+	/**
+	 * @brief Connects the socket.
+	 * Same as open(const address&, bool, const socket_options&), but takes the remote address in OS native format.
+	 * @param address - IP address in OS native format.
+	 * @param disable_naggle - enable/disable Naggle algorithm.
+	 * @param options - socket options to set before connecting.
+	 */
+	void open(const native_address& address, bool disable_naggle = false, const socket_options& options = socket_options());
+
+	/**
+	 * @brief Connects the socket sending the data along with the connection request.
+	 * Uses TCP Fast Open, if supported by the OS and the remote host, to send the initial portion of data
+	 * along with the connection request, saving a round trip.
+	 * If TCP Fast Open cannot be used, e.g. there is no Fast Open cookie for the remote host yet or TCP Fast Open
+	 * is not supported by the OS, then the connection is initiated in the usual way and no data is sent,
+	 * in this case the data should be sent with send() once the socket becomes ready for writing.
+	 * TCP Fast Open is only supported on Linux.
+	 * @param address - IP address of the remote host.
+	 * @param data - data to send along with the connection request.
+	 * @param disable_naggle - enable/disable Naggle algorithm.
+	 * @param options - socket options to set before connecting.
+	 * @return number of bytes sent along with the connection request.
 	 */
-	void open(const address& address, bool disable_naggle = false);
+	size_t open(const address& address, const utki::span<uint8_t> data, bool disable_naggle = false, const socket_options& options = socket_options());
+
+	/**
+	 * @brief Connects the socket sending the data along with the connection request.
+	 * Same as open(const address&, const utki::span<uint8_t>, bool, const socket_options&), but takes the remote address in OS native format.
+	 * @param address - IP address of the remote host in OS native format.
+	 * @param data - data to send along with the connection request.
+	 * @param disable_naggle - enable/disable Naggle algorithm.
+	 * @param options - socket options to set before connecting.
+	 * @return number of bytes sent along with the connection request.
+	 */
+	size_t open(const native_address& address, const utki::span<uint8_t> data, bool disable_naggle = false, const socket_options& options = socket_options());
+
+	/**
+	 * @brief Set connection timeout.
+	 * If the connection initiated by open() is not established within the given time, then
+	 * get_connection_state() will report the connection as failed with std::errc::timed_out error
+	 * and the connection request is aborted.
+	 * The deadline is only checked by get_connection_state(), so the waiting for the socket to become
+	 * ready for writing should not last longer than get_time_to_connect_deadline().
+	 * @param timeout_ms - timeout in milliseconds, counting from the moment of this call.
+	 */
+	void set_connect_timeout(uint32_t timeout_ms);
+
+	/**
+	 * @brief Get time left until the connection timeout expires.
+	 * @return time in milliseconds until the connection timeout set by set_connect_timeout() expires,
+	 *         0 if it has already expired.
+	 * @return maximum value of uint32_t if there is no connection timeout or the connection is not pending.
+	 */
+	uint32_t get_time_to_connect_deadline()const noexcept;
+
+	/**
+	 * @brief Get state of the connection.
+	 * Connection initiated by open() completes asynchronously, the completion is indicated by the socket
+	 * becoming ready for writing (or error). Once the completion is indicated, this function checks the result
+	 * of the connection request, only once, and caches it.
+	 * So, it is intended to be called after waiting for the socket to become ready for writing, and before
+	 * calling send(), which clears the readiness flag.
+	 * Accepted sockets are always reported as connected.
+	 * @return state of the connection.
+	 */
+	connection_state get_connection_state();
+
+	/**
+	 * @brief Get connection error.
+	 * @return the reason of the connection failure if get_connection_state() has reported connection_state::failed.
+	 * @return empty error code otherwise.
+	 */
+	const std::error_code& get_connection_error()const noexcept{
+		return this->connection_error;
+	}
 
 	/**
 	 * @brief Send data to connected socket.
@@ -53,6 +186,101 @@ public:
 	 */
 	size_t send(const utki::span<uint8_t> buf);
 
+	/**
+	 * @brief Send data to connected socket without throwing exceptions.
+	 * Same as send(), but reports errors via error code instead of throwing,
+	 * which is cheaper when errors are frequent, e.g. when many peers disconnect.
+	 * @param buf - pointer to the buffer with data to send.
+	 * @param ec - receives the error code, cleared on success. Closed socket is reported as std::errc::bad_file_descriptor.
+	 * @return the number of bytes actually sent, 0 in case of error.
+	 */
+	size_t send(const utki::span<uint8_t> buf, std::error_code& ec)noexcept;
+
+	/**
+	 * @brief Send data from several buffers to connected socket.
+	 * Sends data from the given buffers, one after another, using single system call (gather write).
+	 * This method does not guarantee that all the data will be sent completely,
+	 * it will return the number of bytes actually sent.
+	 * At most max_num_buffers buffers are handled by one call, the rest are ignored.
+	 * @param bufs - buffers with data to send.
+	 * @return the total number of bytes actually sent.
+	 */
+	size_t send(utki::span<const utki::span<uint8_t>> bufs);
+
+#if M_OS == M_OS_WINDOWS
+	typedef HANDLE file_handle_type;
+#elif M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX || M_OS == M_OS_UNIX
+	typedef int file_handle_type;
+#else
+#	error "Unsupported OS"
+#endif
+
+	/**
+	 * @brief Send contents of a file to connected socket.
+	 * Sends a range of bytes of the file directly to the socket, without reading it into user memory
+	 * (uses sendfile() on Linux and Mac OS, on other OSes the file data is read and sent in chunks).
+	 * This method does not guarantee that the whole range will be sent, it will return the number
+	 * of bytes actually sent and advance the offset accordingly, so that the transfer can be resumed
+	 * by calling this method again with the same offset variable when the socket becomes ready for writing.
+	 * @param file - OS file handle (file descriptor) of the file to send data from.
+	 * @param offset - offset in the file to start sending from, advanced by the number of bytes sent.
+	 * @param count - number of bytes to send.
+	 * @return the number of bytes actually sent. Returns 0 if the socket cannot accept more data
+	 *         at the moment or if the end of file is reached.
+	 */
+	size_t send_file(file_handle_type file, uint64_t& offset, size_t count);
+
+	/**
+	 * @brief Enable zero-copy sending mode.
+	 * In zero-copy mode the send_zerocopy() function can be used to send data without copying it
+	 * to the socket send buffer, the OS will read the data directly from the user's buffer instead.
+	 * Zero-copy sending is only supported on Linux.
+	 * @return true if zero-copy sending mode was enabled.
+	 * @return false if zero-copy sending is not supported by the OS.
+	 */
+	bool enable_zerocopy();
+
+	/**
+	 * @brief Send data to connected socket without copying.
+	 * Same as send(), but the data is not copied to the socket send buffer.
+	 * The buffer must remain valid and unchanged until the OS reports that it is done with it,
+	 * see recieve_zerocopy_completions().
+	 * Each call to this function which sends non-zero number of bytes is assigned an id, the ids
+	 * are assigned sequentially starting from 0.
+	 * Zero-copy sending mode must be enabled with enable_zerocopy() before calling this function.
+	 * @param buf - buffer with data to send.
+	 * @param out_id - returns the id assigned to this send operation, only valid if non-zero number of bytes was sent.
+	 * @return the number of bytes actually sent.
+	 */
+	size_t send_zerocopy(const utki::span<uint8_t> buf, uint32_t& out_id);
+
+	/**
+	 * @brief Zero-copy send completion notification.
+	 * Notifies that the buffers of zero-copy send operations with ids in range [first_id, last_id]
+	 * are not used by the OS anymore and can be reused.
+	 * Note, that the ids may wrap around.
+	 */
+	struct zerocopy_completion{
+		uint32_t first_id;
+		uint32_t last_id;
+
+		/**
+		 * @brief Indicates that the OS has copied the data instead of sending it directly from the buffer.
+		 * In this case using zero-copy mode for this connection only adds overhead.
+		 */
+		bool copied;
+	};
+
+	/**
+	 * @brief Receive zero-copy send completion notifications.
+	 * The notifications are queued on the socket's error queue, so availability of notifications
+	 * is indicated by the socket becoming ready with opros::ready::error flag.
+	 * If there are no notifications available this function does not block, instead it returns 0.
+	 * @param out_completions - buffer where to put the received notifications.
+	 * @return number of notifications written to the buffer.
+	 */
+	size_t recieve_zerocopy_completions(utki::span<zerocopy_completion> out_completions);
+
 	/**
 	 * @brief Receive data from connected socket.
 	 * Receives data available on the socket.
@@ -65,6 +293,26 @@ public:
 	 */
 	size_t recieve(utki::span<uint8_t> buf);
 
+	/**
+	 * @brief Receive data from connected socket without throwing exceptions.
+	 * Same as recieve(), but reports errors via error code instead of throwing.
+	 * @param buf - pointer to the buffer where to put received data.
+	 * @param ec - receives the error code, cleared on success. Closed socket is reported as std::errc::bad_file_descriptor.
+	 * @return the number of bytes written to the buffer, 0 in case of error.
+	 */
+	size_t recieve(utki::span<uint8_t> buf, std::error_code& ec)noexcept;
+
+	/**
+	 * @brief Receive data from connected socket into several buffers.
+	 * Receives data available on the socket, filling the given buffers one after another,
+	 * using single system call (scatter read).
+	 * Same as recieve() with single buffer, returns 0 if there is no data available.
+	 * At most max_num_buffers buffers are handled by one call, the rest are ignored.
+	 * @param bufs - buffers where to put received data.
+	 * @return the total number of bytes written to the buffers.
+	 */
+	size_t recieve(utki::span<const utki::span<uint8_t>> bufs);
+
 	/**
 	 * @brief Get local IP address and port.
 	 * @return IP address and port of the local socket.
@@ -77,8 +325,78 @@ public:
 	 */
 	address get_remote_address();
 
-#if M_OS == M_OS_WINDOWS
+	/**
+	 * @brief Statistics of TCP connection.
+	 * Snapshot of the connection state maintained by the OS TCP stack.
+	 * The values which are not provided by the OS are 0.
+	 */
+	struct stats{
+		/**
+		 * @brief Smoothed round trip time in microseconds.
+		 */
+		uint32_t rtt_us = 0;
+
+		/**
+		 * @brief Round trip time variance in microseconds.
+		 */
+		uint32_t rtt_variance_us = 0;
+
+		/**
+		 * @brief Total number of retransmitted segments.
+		 */
+		uint32_t num_retransmits = 0;
+
+		/**
+		 * @brief Maximum segment size in bytes.
+		 */
+		uint32_t mss = 0;
+
+		/**
+		 * @brief Congestion window in bytes.
+		 */
+		uint64_t congestion_window = 0;
+
+		/**
+		 * @brief Amount of sent, but not yet acknowledged data in bytes.
+		 * On some OSes it is estimated from the number of unacknowledged segments.
+		 */
+		uint64_t unacked_bytes = 0;
+
+		/**
+		 * @brief Pacing rate in bytes per second.
+		 * Maximum value of uint64_t means that pacing is not limited.
+		 */
+		uint64_t pacing_rate = 0;
+	};
+
+	/**
+	 * @brief Get statistics of the connection.
+	 * @return statistics of the connection.
+	 * @throw std::system_error - in case the statistics could not be obtained,
+	 *                            with std::errc::not_supported error if it is not supported by the OS.
+	 */
+	stats get_stats()const;
+
+	/**
+	 * @brief Get statistics of several connections.
+	 * Intended for sampling statistics of many connections periodically: does not allocate memory and
+	 * does not throw, statistics of the closed sockets, or sockets for which the statistics could not be obtained,
+	 * are reset to zero values.
+	 * @param sockets - pointers to the sockets to get statistics for, so that the sockets can be stored in any container.
+	 *                  Statistics of null pointers are reset to zero values.
+	 * @param out_stats - array where to put statistics, one entry per socket. If it is shorter than the sockets array,
+	 *                    then only the statistics of the first sockets which fit into it are obtained.
+	 * @return number of sockets for which the statistics were obtained.
+	 */
+	static size_t get_stats(utki::span<const tcp_socket* const> sockets, utki::span<stats> out_stats)noexcept;
+
 private:
+	void get_stats(stats& out_stats, std::error_code& ec)const noexcept;
+
+	void create(const native_address& address, bool disable_naggle, const socket_options& options);
+	void connect(const native_address& address);
+
+#if M_OS == M_OS_WINDOWS
 	void set_waiting_flags(utki::flags<opros::ready> waiting_flags)override;
 #endif
 };
@@ -0,0 +1,218 @@
+#include "timer_wheel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+using namespace setka;
+
+uint64_t timer_wheel::get_ticks_ms()noexcept{
+	return uint64_t(
+			std::chrono::duration_cast<std::chrono::milliseconds>(
+					std::chrono::steady_clock::now().time_since_epoch()
+				).count()
+		);
+}
+
+void timer_wheel::init_list(link& head)noexcept{
+	head.prev = &head;
+	head.next = &head;
+}
+
+void timer_wheel::unlink(link& l)noexcept{
+	l.prev->next = l.next;
+	l.next->prev = l.prev;
+	l.prev = nullptr;
+	l.next = nullptr;
+}
+
+void timer_wheel::push_back(link& head, link& l)noexcept{
+	l.prev = head.prev;
+	l.next = &head;
+	head.prev->next = &l;
+	head.prev = &l;
+}
+
+timer_wheel::timer_wheel(uint64_t now_ms)noexcept :
+		current_ms(now_ms)
+{
+	for(auto& w : this->wheels){
+		for(auto& head : w){
+			init_list(head);
+		}
+	}
+	init_list(this->overflow);
+	init_list(this->expiring);
+}
+
+timer_wheel::~timer_wheel()noexcept{
+	auto disarm_all = [](link& head){
+		while(head.next != &head){
+			auto& t = static_cast<timer&>(*head.next);
+			unlink(t);
+			t.wheel = nullptr;
+		}
+	};
+
+	for(auto& w : this->wheels){
+		for(auto& head : w){
+			disarm_all(head);
+		}
+	}
+	disarm_all(this->overflow);
+	disarm_all(this->expiring);
+}
+
+void timer_wheel::insert(timer& t)noexcept{
+	// the timers which should have already expired expire on the next millisecond
+	uint64_t expiry = std::max(t.expiry_ms, this->current_ms);
+	uint64_t delta = expiry - this->current_ms;
+
+	for(unsigned i = 0; i != num_wheels; ++i){
+		if(delta < (uint64_t(1) << (wheel_bits * (i + 1)))){
+			push_back(this->wheels[i][(expiry >> (wheel_bits * i)) & wheel_mask], t);
+			return;
+		}
+	}
+
+	push_back(this->overflow, t);
+}
+
+void timer_wheel::cascade(link& head)noexcept{
+	if(head.next == &head){
+		return;
+	}
+
+	// move the timers to a temporary list, because they can be inserted back to the same list
+	link list;
+	list.next = head.next;
+	list.prev = head.prev;
+	list.next->prev = &list;
+	list.prev->next = &list;
+	init_list(head);
+
+	while(list.next != &list){
+		auto& t = static_cast<timer&>(*list.next);
+		unlink(t);
+		this->insert(t);
+	}
+}
+
+void timer_wheel::arm_at(timer& t, uint64_t expiry_ms)noexcept{
+	if(t.wheel){
+		t.wheel->disarm(t);
+	}
+
+	t.expiry_ms = expiry_ms;
+	t.wheel = this;
+	this->insert(t);
+	++this->num_armed;
+}
+
+void timer_wheel::disarm(timer& t)noexcept{
+	if(!t.wheel){
+		return;
+	}
+	ASSERT_INFO(t.wheel == this, "timer_wheel::disarm(): the timer is armed on another timer wheel")
+
+	unlink(t);
+	t.wheel = nullptr;
+	--this->num_armed;
+}
+
+uint32_t timer_wheel::get_time_to_next_expiry(uint64_t now_ms)const noexcept{
+	if(this->num_armed == 0){
+		return std::numeric_limits<uint32_t>::max();
+	}
+
+	// find the earliest timer in the first wheel up to the next cascading
+	uint64_t t = this->current_ms;
+	uint64_t end = (this->current_ms | wheel_mask) + 1;
+	for(; t != end; ++t){
+		auto& head = this->wheels[0][t & wheel_mask];
+		if(head.next != &head){
+			break;
+		}
+	}
+
+	// t is either the expiry time of the earliest timer or the time of the next cascading
+	if(t <= now_ms){
+		return 0;
+	}
+	return uint32_t(std::min(t - now_ms, uint64_t(std::numeric_limits<uint32_t>::max())));
+}
+
+size_t timer_wheel::advance(uint64_t now_ms){
+	size_t num_expired = 0;
+
+	while(this->current_ms <= now_ms){
+		if(this->num_armed == 0){
+			this->current_ms = now_ms + 1;
+			break;
+		}
+
+		uint64_t t = this->current_ms;
+
+		if((t & wheel_mask) == 0){
+			// some of the coarser wheels have turned, move their timers to the finer wheels,
+			// starting from the coarsest one
+			unsigned level = 1;
+			while(level != num_wheels && (t & ((uint64_t(1) << (wheel_bits * (level + 1))) - 1)) == 0){
+				++level;
+			}
+
+			if(level == num_wheels){
+				this->cascade(this->overflow);
+				--level;
+			}
+
+			for(; level != 0; --level){
+				this->cascade(this->wheels[level][(t >> (wheel_bits * level)) & wheel_mask]);
+			}
+		}
+
+		auto& slot = this->wheels[0][t & wheel_mask];
+		if(slot.next == &slot){
+			// skip the empty slots up to the next cascading
+			uint64_t end = std::min((t | wheel_mask) + 1, now_ms + 1);
+			for(++t; t != end; ++t){
+				auto& head = this->wheels[0][t & wheel_mask];
+				if(head.next != &head){
+					break;
+				}
+			}
+			this->current_ms = t;
+			continue;
+		}
+
+		// move the expiring timers to a separate list, so that the handlers can arm and disarm timers
+		ASSERT(this->expiring.next == &this->expiring)
+		this->expiring.next = slot.next;
+		this->expiring.prev = slot.prev;
+		this->expiring.next->prev = &this->expiring;
+		this->expiring.prev->next = &this->expiring;
+		init_list(slot);
+
+		++this->current_ms;
+
+		while(this->expiring.next != &this->expiring){
+			auto& tm = static_cast<timer&>(*this->expiring.next);
+			unlink(tm);
+			tm.wheel = nullptr;
+			--this->num_armed;
+			++num_expired;
+
+			if(tm.handler){
+				try{
+					tm.handler();
+				}catch(...){
+					// the rest of the expiring timers expire on next call
+					this->cascade(this->expiring);
+					throw;
+				}
+			}
+		}
+	}
+
+	return num_expired;
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+
+#include <utki/debug.hpp>
+
+namespace setka{
+
+class timer;
+
+/**
+ * @brief Hierarchical timer wheel.
+ * Keeps the armed timers in slots of 4 wheels, each wheel has 256 slots. The first wheel has a slot per millisecond,
+ * the slots of the second wheel span 256 milliseconds, and so on. So, arming and disarming a timer is O(1),
+ * and as the time goes the timers are moved from the coarser wheels to the finer ones until they expire.
+ * The timers which expire later than 2^32 milliseconds from now are kept in a separate list.
+ *
+ * The time is measured by a 64-bit monotonic millisecond clock, so it never wraps around.
+ * The timer wheel is not thread-safe.
+ */
+class timer_wheel{
+	friend class timer;
+
+	// link of intrusive list of timers
+	struct link{
+		link* prev = nullptr;
+		link* next = nullptr;
+	};
+
+	static constexpr unsigned num_wheels = 4;
+	static constexpr unsigned wheel_bits = 8;
+	static constexpr unsigned wheel_size = 1 << wheel_bits;
+	static constexpr uint64_t wheel_mask = wheel_size - 1;
+
+	std::array<std::array<link, wheel_size>, num_wheels> wheels;
+	link overflow; // timers which expire later than all the wheels span
+	link expiring; // timers being expired by advance()
+
+	// time of the next millisecond to process, all timers which expire before it have expired
+	uint64_t current_ms;
+
+	size_t num_armed = 0;
+
+	static void init_list(link& head)noexcept;
+	static void unlink(link& l)noexcept;
+	static void push_back(link& head, link& l)noexcept;
+
+	void insert(timer& t)noexcept;
+
+	void cascade(link& head)noexcept;
+
+public:
+	/**
+	 * @brief Get monotonic time.
+	 * @return monotonic time in milliseconds.
+	 */
+	static uint64_t get_ticks_ms()noexcept;
+
+	/**
+	 * @brief Create timer wheel.
+	 * @param now_ms - current time in milliseconds of get_ticks_ms() clock.
+	 */
+	timer_wheel(uint64_t now_ms = get_ticks_ms())noexcept;
+
+	timer_wheel(const timer_wheel&) = delete;
+	timer_wheel& operator=(const timer_wheel&) = delete;
+
+	/**
+	 * @brief Destroy timer wheel.
+	 * Disarms all the timers.
+	 */
+	~timer_wheel()noexcept;
+
+	/**
+	 * @brief Arm timer.
+	 * If the timer is already armed, then it is re-armed.
+	 * @param t - timer to arm.
+	 * @param timeout_ms - time in milliseconds from now after which the timer expires.
+	 */
+	void arm(timer& t, uint32_t timeout_ms)noexcept{
+		this->arm_at(t, get_ticks_ms() + timeout_ms);
+	}
+
+	/**
+	 * @brief Arm timer to expire at given time.
+	 * If the timer is already armed, then it is re-armed.
+	 * @param t - timer to arm.
+	 * @param expiry_ms - time in milliseconds of get_ticks_ms() clock when the timer expires.
+	 */
+	void arm_at(timer& t, uint64_t expiry_ms)noexcept;
+
+	/**
+	 * @brief Disarm timer.
+	 * Does nothing if the timer is not armed.
+	 * @param t - timer to disarm.
+	 */
+	void disarm(timer& t)noexcept;
+
+	/**
+	 * @brief Get number of armed timers.
+	 * @return number of armed timers.
+	 */
+	size_t size()const noexcept{
+		return this->num_armed;
+	}
+
+	/**
+	 * @brief Get time until the next call to advance() is needed.
+	 * @param now_ms - current time in milliseconds of get_ticks_ms() clock.
+	 * @return time in milliseconds until the earliest timer expires, or less.
+	 *         Maximum value of uint32_t if there are no armed timers.
+	 */
+	uint32_t get_time_to_next_expiry(uint64_t now_ms = get_ticks_ms())const noexcept;
+
+	/**
+	 * @brief Expire timers.
+	 * Calls handlers of all the timers which expire not later than the given time.
+	 * @param now_ms - current time in milliseconds of get_ticks_ms() clock.
+	 * @return number of expired timers.
+	 */
+	size_t advance(uint64_t now_ms = get_ticks_ms());
+};
+
+/**
+ * @brief Timer.
+ * The timer is armed on a timer_wheel and its handler is called once the timer expires.
+ * Timer does not allocate any memory when armed, all the bookkeeping is stored in the timer object itself,
+ * so the timer must not be moved while armed. Destroying an armed timer disarms it.
+ */
+class timer : private timer_wheel::link{
+	friend class timer_wheel;
+
+	timer_wheel* wheel = nullptr;
+
+	uint64_t expiry_ms = 0;
+
+public:
+	/**
+	 * @brief Expiry handler.
+	 * The timer can be re-armed or disarmed from within the handler, but it must not be destroyed.
+	 */
+	std::function<void()> handler;
+
+	timer(std::function<void()> handler = nullptr) :
+			handler(std::move(handler))
+	{}
+
+	timer(const timer&) = delete;
+	timer& operator=(const timer&) = delete;
+
+	~timer()noexcept{
+		if(this->wheel){
+			this->wheel->disarm(*this);
+		}
+	}
+
+	/**
+	 * @brief Check if the timer is armed.
+	 * @return true if the timer is armed and has not expired yet.
+	 * @return false otherwise.
+	 */
+	bool is_armed()const noexcept{
+		return this->wheel != nullptr;
+	}
+
+	/**
+	 * @brief Get expiry time.
+	 * @return expiry time of the armed timer, in milliseconds of the timer_wheel::get_ticks_ms() clock.
+	 */
+	uint64_t get_expiry_ms()const noexcept{
+		return this->expiry_ms;
+	}
+};
+
+}
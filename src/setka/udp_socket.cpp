@@ -2,14 +2,42 @@
 
 #include <limits>
 #include <cstring>
+#include <array>
+#include <algorithm>
 
 #if M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX || M_OS == M_OS_UNIX
 #	include <netinet/in.h>
 #endif
 
+#if M_OS == M_OS_LINUX
+#	include <netinet/udp.h>
+#endif
+
 using namespace setka;
 
-void udp_socket::open(uint16_t port){
+namespace{
+// On some OSes IPv4 addresses should be given as IPv4 mapped to IPv6 addresses when sending over IPv6 socket.
+// The 'mapped' is used to hold the mapped address if needed.
+const native_address& adapt_address(const native_address& a, bool ipv4, native_address& mapped){
+#if M_OS == M_OS_MACOSX || M_OS == M_OS_WINDOWS
+	if(!ipv4 && a.is_v4()){
+		mapped = a.to_v6();
+		return mapped;
+	}
+#endif
+	return a;
+}
+}
+
+void udp_socket::open(uint16_t port, const socket_options& options){
+	this->open_local(address(address::ip(0, 0, 0, 0), port), true, options);
+}
+
+void udp_socket::open(const address& local_address, const socket_options& options){
+	this->open_local(local_address, false, options);
+}
+
+void udp_socket::open_local(const address& local_address, bool dual_stack, const socket_options& options){
 	if(this->is_open()){
 		throw std::logic_error("udp_socket::Open(): the socket is already opened");
 	}
@@ -18,10 +46,22 @@ void udp_socket::open(uint16_t port){
 	this->create_event_for_waitable();
 #endif
 
-	this->ipv4 = false;
+	// in dual stack mode bind to any local address, both IPv4 and IPv6,
+	// otherwise the socket is of the local address family
+	this->ipv4 = !dual_stack && local_address.host.is_v4();
 	
-	this->sock = ::socket(PF_INET6, SOCK_DGRAM, 0);
+	this->sock = ::socket(this->ipv4 ? PF_INET : PF_INET6, SOCK_DGRAM, 0);
 	
+	if(this->sock == invalid_socket && !dual_stack){
+#if M_OS == M_OS_WINDOWS
+		int error_code = WSAGetLastError();
+		this->close_event_for_waitable();
+#else
+		int error_code = errno;
+#endif
+		throw std::system_error(error_code, std::generic_category(), "couldn't create socket, socket() failed");
+	}
+
 	if(this->sock == invalid_socket){
 		// maybe IPv6 is not supported by OS, try to proceed with IPv4 socket then
 		this->sock = ::socket(PF_INET, SOCK_DGRAM, 0);
@@ -40,7 +80,7 @@ void udp_socket::open(uint16_t port){
 	}
 	
 	// turn off IPv6 only mode to allow also accepting IPv4 connections
-	if(!this->ipv4){
+	if(dual_stack && !this->ipv4){
 #if M_OS == M_OS_WINDOWS
 		char no = 0;
 		const char* noPtr = &no;
@@ -75,32 +115,47 @@ void udp_socket::open(uint16_t port){
 		}
 	}
 	
-	// bind locally, if appropriate
-	if(port != 0){
-		sockaddr_storage sockAddr;
-		socklen_t sockAddrLen;
-
-		if(this->ipv4){
-			sockaddr_in& sa = reinterpret_cast<sockaddr_in&>(sockAddr);
-			memset(&sa, 0, sizeof(sa));
-			sa.sin_family = AF_INET;
-			sa.sin_addr.s_addr = INADDR_ANY;
-			sa.sin_port = htons(port);
-			sockAddrLen = sizeof(sa);
-		}else{
-			sockaddr_in6& sa = reinterpret_cast<sockaddr_in6&>(sockAddr);
-			memset(&sa, 0, sizeof(sa));
-			sa.sin6_family = AF_INET6;
-			sa.sin6_addr = in6addr_any; // 'in6addr_any' allows accepting both IPv4 and IPv6 connections
-			sa.sin6_port = htons(port);
-			sockAddrLen = sizeof(sa);
+	// receive and send only IPv6 datagrams, even if bound to any address
+	if(!dual_stack && !this->ipv4){
+#if M_OS == M_OS_WINDOWS
+		char yes = 1;
+		const char* yesPtr = &yes;
+#else
+		int yes = 1;
+		void* yesPtr = &yes;
+#endif
+		if(setsockopt(this->sock, IPPROTO_IPV6, IPV6_V6ONLY, yesPtr, sizeof(yes)) != 0){
+#if M_OS == M_OS_WINDOWS
+			int errorCode = WSAGetLastError();
+#else
+			int errorCode = errno;
+#endif
+			this->close();
+			throw std::system_error(errorCode, std::generic_category(), "could not set IPv6 only mode, setsockopt(IPV6_V6ONLY) failed");
 		}
+	}
+
+	try{
+		this->set_options(options, this->ipv4);
+	}catch(...){
+		this->close();
+		throw;
+	}
+
+	// bind locally, if appropriate
+	if(local_address.port != 0 || local_address.host.is_valid()){
+		// 'in6addr_any' allows accepting both IPv4 and IPv6 connections
+		native_address a(
+				dual_stack ?
+						(this->ipv4 ? address(uint32_t(INADDR_ANY), local_address.port) : address(address::ip(0, 0, 0, 0), local_address.port)) :
+						local_address
+			);
 
 		// bind the socket for listening
 		if(::bind(
 				this->sock,
-				reinterpret_cast<struct sockaddr*>(&sockAddr),
-				sockAddrLen
+				a.get_sockaddr(),
+				a.get_size()
 			) == socket_error)
 		{
 			this->close();
@@ -146,60 +201,133 @@ void udp_socket::open(uint16_t port){
 	this->readiness_flags.clear();
 }
 
-size_t udp_socket::send(const utki::span<uint8_t> buf, const address& destination_address){
+void udp_socket::connect(const address& destination_address){
+	this->connect(native_address(destination_address));
+}
+
+void udp_socket::connect(const native_address& destination_address){
+	if(!this->is_open()){
+		throw std::logic_error("udp_socket::connect(): socket is not opened");
+	}
+
+	native_address mapped;
+	const native_address& dst = adapt_address(destination_address, this->ipv4, mapped);
+
+	while(::connect(
+			this->sock,
+			dst.get_sockaddr(),
+			dst.get_size()
+		) == socket_error)
+	{
+#if M_OS == M_OS_WINDOWS
+		int errorCode = WSAGetLastError();
+#else
+		int errorCode = errno;
+#endif
+		if(errorCode == error_interrupted){
+			continue;
+		}
+		throw std::system_error(errorCode, std::generic_category(), "could not connect UDP socket, connect() failed");
+	}
+}
+
+size_t udp_socket::send(const utki::span<uint8_t> buf){
 	if(!this->is_open()){
 		throw std::logic_error("udp_socket::send(): socket is not opened");
 	}
 
+	std::error_code ec;
+	size_t ret = this->send(buf, ec);
+	if(ec){
+		throw std::system_error(ec, "could not send data over UDP, send() failed");
+	}
+	return ret;
+}
+
+size_t udp_socket::send(const utki::span<uint8_t> buf, std::error_code& ec)noexcept{
+	if(!this->is_open()){
+		ec = std::make_error_code(std::errc::bad_file_descriptor);
+		return 0;
+	}
+
+	ec.clear();
+
 	this->readiness_flags.clear(opros::ready::write);
 
-	sockaddr_storage sockAddr;
-	socklen_t sockAddrLen;
-	
-	if(
-#if M_OS == M_OS_MACOSX || M_OS == M_OS_WINDOWS
-			this->ipv4 &&
+#if M_OS == M_OS_WINDOWS
+	int len;
+#else
+	ssize_t len;
 #endif
-			destination_address.host.is_v4()
-		)
-	{
-		sockaddr_in& a = reinterpret_cast<sockaddr_in&>(sockAddr);
-		memset(&a, 0, sizeof(a));
-		a.sin_family = AF_INET;
-		a.sin_addr.s_addr = htonl(destination_address.host.get_v4());
-		a.sin_port = htons(destination_address.port);
-		sockAddrLen = sizeof(a);
-	}else{
-		sockaddr_in6& a = reinterpret_cast<sockaddr_in6&>(sockAddr);
-		memset(&a, 0, sizeof(a));
-		a.sin6_family = AF_INET6;
-#if M_OS == M_OS_MACOSX || M_OS == M_OS_WINDOWS || (M_OS == M_OS_LINUX && M_OS_NAME == M_OS_NAME_ANDROID)
-		a.sin6_addr.s6_addr[0] = destination_address.host.quad[0] >> 24;
-		a.sin6_addr.s6_addr[1] = (destination_address.host.quad[0] >> 16) & 0xff;
-		a.sin6_addr.s6_addr[2] = (destination_address.host.quad[0] >> 8) & 0xff;
-		a.sin6_addr.s6_addr[3] = destination_address.host.quad[0] & 0xff;
-		a.sin6_addr.s6_addr[4] = destination_address.host.quad[1] >> 24;
-		a.sin6_addr.s6_addr[5] = (destination_address.host.quad[1] >> 16) & 0xff;
-		a.sin6_addr.s6_addr[6] = (destination_address.host.quad[1] >> 8) & 0xff;
-		a.sin6_addr.s6_addr[7] = destination_address.host.quad[1] & 0xff;
-		a.sin6_addr.s6_addr[8] = destination_address.host.quad[2] >> 24;
-		a.sin6_addr.s6_addr[9] = (destination_address.host.quad[2] >> 16) & 0xff;
-		a.sin6_addr.s6_addr[10] = (destination_address.host.quad[2] >> 8) & 0xff;
-		a.sin6_addr.s6_addr[11] = destination_address.host.quad[2] & 0xff;
-		a.sin6_addr.s6_addr[12] = destination_address.host.quad[3] >> 24;
-		a.sin6_addr.s6_addr[13] = (destination_address.host.quad[3] >> 16) & 0xff;
-		a.sin6_addr.s6_addr[14] = (destination_address.host.quad[3] >> 8) & 0xff;
-		a.sin6_addr.s6_addr[15] = destination_address.host.quad[3] & 0xff;
+
+	while(true){
+		len = ::send(
+				this->sock,
+				reinterpret_cast<const char*>(buf.begin()),
+				int(buf.size()),
+				0
+			);
+
+		if(len == socket_error){
+#if M_OS == M_OS_WINDOWS
+			int errorCode = WSAGetLastError();
 #else
-		a.sin6_addr.__in6_u.__u6_addr32[0] = htonl(destination_address.host.quad[0]);
-		a.sin6_addr.__in6_u.__u6_addr32[1] = htonl(destination_address.host.quad[1]);
-		a.sin6_addr.__in6_u.__u6_addr32[2] = htonl(destination_address.host.quad[2]);
-		a.sin6_addr.__in6_u.__u6_addr32[3] = htonl(destination_address.host.quad[3]);
+			int errorCode = errno;
 #endif
-		a.sin6_port = htons(destination_address.port);
-		sockAddrLen = sizeof(a);
+			if(errorCode == error_interrupted){
+				continue;
+			}else if(errorCode == error_again){
+				// can't send more bytes, return 0 bytes sent
+				len = 0;
+			}else{
+				ec.assign(errorCode, std::generic_category());
+				return 0;
+			}
+		}
+		break;
 	}
 
+	ASSERT(buf.size() <= size_t(std::numeric_limits<int>::max()))
+	ASSERT_INFO((len == int(buf.size())) || (len == 0), "res = " << len)
+
+	ASSERT(len >= 0)
+	return size_t(len);
+}
+
+size_t udp_socket::send(const utki::span<uint8_t> buf, const address& destination_address){
+	return this->send(buf, native_address(destination_address));
+}
+
+size_t udp_socket::send(const utki::span<uint8_t> buf, const address& destination_address, std::error_code& ec)noexcept{
+	return this->send(buf, native_address(destination_address), ec);
+}
+
+size_t udp_socket::send(const utki::span<uint8_t> buf, const native_address& destination_address){
+	if(!this->is_open()){
+		throw std::logic_error("udp_socket::send(): socket is not opened");
+	}
+
+	std::error_code ec;
+	size_t ret = this->send(buf, destination_address, ec);
+	if(ec){
+		throw std::system_error(ec, "could not send data over UDP, sendto() failed");
+	}
+	return ret;
+}
+
+size_t udp_socket::send(const utki::span<uint8_t> buf, const native_address& destination_address, std::error_code& ec)noexcept{
+	if(!this->is_open()){
+		ec = std::make_error_code(std::errc::bad_file_descriptor);
+		return 0;
+	}
+
+	ec.clear();
+
+	this->readiness_flags.clear(opros::ready::write);
+
+	native_address mapped;
+	const native_address& dst = adapt_address(destination_address, this->ipv4, mapped);
+
 #if M_OS == M_OS_WINDOWS
 	int len;
 #else
@@ -212,8 +340,8 @@ size_t udp_socket::send(const utki::span<uint8_t> buf, const address& destinatio
 				reinterpret_cast<const char*>(buf.begin()),
 				int(buf.size()),
 				0,
-				reinterpret_cast<struct sockaddr*>(&sockAddr),
-				sockAddrLen
+				dst.get_sockaddr(),
+				dst.get_size()
 			);
 
 		if(len == socket_error){
@@ -228,7 +356,8 @@ size_t udp_socket::send(const utki::span<uint8_t> buf, const address& destinatio
 				// can't send more bytes, return 0 bytes sent
 				len = 0;
 			}else{
-				throw std::system_error(errorCode, std::generic_category(), "could not send data over UDP, sendto() failed");
+				ec.assign(errorCode, std::generic_category());
+				return 0;
 			}
 		}
 		break;
@@ -242,23 +371,303 @@ size_t udp_socket::send(const utki::span<uint8_t> buf, const address& destinatio
 	return size_t(len);
 }
 
+size_t udp_socket::send(utki::span<const std::pair<utki::span<uint8_t>, address>> datagrams){
+	size_t num_datagrams = std::min(datagrams.size(), max_batch_size);
+
+	std::array<std::pair<utki::span<uint8_t>, native_address>, max_batch_size> native_datagrams;
+
+	for(size_t i = 0; i != num_datagrams; ++i){
+		native_datagrams[i].first = datagrams[i].first;
+		native_datagrams[i].second = native_address(datagrams[i].second);
+	}
+
+	return this->send(utki::span<const decltype(native_datagrams)::value_type>(native_datagrams.data(), num_datagrams));
+}
+
+size_t udp_socket::send(utki::span<const std::pair<utki::span<uint8_t>, native_address>> datagrams){
+	if(!this->is_open()){
+		throw std::logic_error("udp_socket::send(): socket is not opened");
+	}
+
+	this->readiness_flags.clear(opros::ready::write);
+
+	size_t num_datagrams = std::min(datagrams.size(), max_batch_size);
+
+	// on some OSes IPv4 destination addresses may need to be mapped to IPv6
+	std::array<native_address, max_batch_size> mapped;
+
+#if M_OS == M_OS_LINUX
+	std::array<iovec, max_batch_size> iovecs;
+	std::array<mmsghdr, max_batch_size> msgs;
+
+	for(size_t i = 0; i != num_datagrams; ++i){
+		const auto& d = datagrams[i];
+
+		iovecs[i].iov_base = d.first.data();
+		iovecs[i].iov_len = d.first.size();
+
+		const native_address& dst = adapt_address(d.second, this->ipv4, mapped[i]);
+
+		msghdr& h = msgs[i].msg_hdr;
+		memset(&h, 0, sizeof(h));
+		h.msg_name = const_cast<sockaddr*>(dst.get_sockaddr());
+		h.msg_namelen = dst.get_size();
+		h.msg_iov = &iovecs[i];
+		h.msg_iovlen = 1;
+	}
+
+	int num_sent;
+
+	while(true){
+		num_sent = sendmmsg(this->sock, msgs.data(), unsigned(num_datagrams), 0);
+
+		if(num_sent == socket_error){
+			int errorCode = errno;
+			if(errorCode == error_interrupted){
+				continue;
+			}else if(errorCode == error_again){
+				return 0; // can't send more datagrams, return 0 datagrams sent
+			}else{
+				throw std::system_error(errorCode, std::generic_category(), "could not send data over UDP, sendmmsg() failed");
+			}
+		}
+		break;
+	}
+
+	ASSERT(num_sent >= 0)
+	ASSERT(size_t(num_sent) <= num_datagrams)
+
+	return size_t(num_sent);
+#else
+	// no batch sending system call, send datagrams one by one
+	size_t num_sent = 0;
+
+	for(; num_sent != num_datagrams; ++num_sent){
+		const auto& d = datagrams[num_sent];
+		const native_address& dst = adapt_address(d.second, this->ipv4, mapped[num_sent]);
+
+#	if M_OS == M_OS_WINDOWS
+		int len;
+#	else
+		ssize_t len;
+#	endif
+
+		while(true){
+			len = ::sendto(
+					this->sock,
+					reinterpret_cast<const char*>(d.first.data()),
+					int(d.first.size()),
+					0,
+					dst.get_sockaddr(),
+					dst.get_size()
+				);
+
+			if(len == socket_error){
+#	if M_OS == M_OS_WINDOWS
+				int errorCode = WSAGetLastError();
+#	else
+				int errorCode = errno;
+#	endif
+				if(errorCode == error_interrupted){
+					continue;
+				}else if(errorCode == error_again){
+					break; // can't send more datagrams
+				}else if(num_sent != 0){
+					// report the datagrams sent so far, the error will be reported by subsequent call
+					break;
+				}else{
+					throw std::system_error(errorCode, std::generic_category(), "could not send data over UDP, sendto() failed");
+				}
+			}
+			break;
+		}
+
+		if(len == socket_error){
+			break;
+		}
+
+		ASSERT_INFO(size_t(len) == d.first.size(), "len = " << len)
+	}
+
+	return num_sent;
+#endif
+}
+
+size_t udp_socket::send_segmented(const utki::span<uint8_t> buf, size_t segment_size, const address& destination_address){
+	return this->send_segmented(buf, segment_size, native_address(destination_address));
+}
+
+size_t udp_socket::send_segmented(const utki::span<uint8_t> buf, size_t segment_size, const native_address& destination_address){
+	if(!this->is_open()){
+		throw std::logic_error("udp_socket::send_segmented(): socket is not opened");
+	}
+
+	if(segment_size == 0){
+		throw std::logic_error("udp_socket::send_segmented(): segment_size is 0");
+	}
+
+	if(buf.size() <= segment_size){
+		return this->send(buf, destination_address);
+	}
+
+	size_t num_bytes_sent = 0;
+
+#if M_OS == M_OS_LINUX && defined(UDP_SEGMENT)
+	const size_t max_segments_per_super_packet = 64; // limit imposed by the kernel
+	const size_t max_super_packet_size = 0xffff - 8 - 20; // maximum UDP payload size, minus UDP and IPv4 headers
+
+	size_t segments_per_super_packet = std::min(max_segments_per_super_packet, max_super_packet_size / segment_size);
+
+	if(this->gso == gso_support::unknown){
+		// kernels which do not know UDP_SEGMENT silently ignore the control message, so check for support explicitly
+		int val;
+		socklen_t len = sizeof(val);
+		if(getsockopt(this->sock, SOL_UDP, UDP_SEGMENT, &val, &len) == 0){
+			this->gso = gso_support::supported;
+		}else{
+			this->gso = gso_support::unsupported;
+		}
+	}
+
+	if(this->gso == gso_support::supported && segments_per_super_packet > 1){
+		this->readiness_flags.clear(opros::ready::write);
+
+		union{
+			char buf[CMSG_SPACE(sizeof(uint16_t))];
+			cmsghdr align;
+		} control;
+
+		while(num_bytes_sent != buf.size()){
+			size_t super_packet_size = std::min(buf.size() - num_bytes_sent, segments_per_super_packet * segment_size);
+
+			iovec iov;
+			iov.iov_base = buf.data() + num_bytes_sent;
+			iov.iov_len = super_packet_size;
+
+			msghdr h;
+			memset(&h, 0, sizeof(h));
+			h.msg_name = const_cast<sockaddr*>(destination_address.get_sockaddr());
+			h.msg_namelen = destination_address.get_size();
+			h.msg_iov = &iov;
+			h.msg_iovlen = 1;
+			h.msg_control = control.buf;
+			h.msg_controllen = sizeof(control.buf);
+
+			cmsghdr* cm = CMSG_FIRSTHDR(&h);
+			cm->cmsg_level = SOL_UDP;
+			cm->cmsg_type = UDP_SEGMENT;
+			cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+			uint16_t gso_size = uint16_t(segment_size);
+			memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
+
+			ssize_t len = sendmsg(this->sock, &h, 0);
+
+			if(len == socket_error){
+				int errorCode = errno;
+				if(errorCode == error_interrupted){
+					continue;
+				}else if(errorCode == error_again){
+					// can't send more bytes
+					return num_bytes_sent;
+				}else if(errorCode == EIO){
+					// network device does not support checksum offload needed by GSO, do not try GSO anymore
+					this->gso = gso_support::unsupported;
+					break;
+				}else if(errorCode == EINVAL){
+					// kernel rejected GSO for this buffer, fall back to sending datagrams one by one
+					break;
+				}else{
+					throw std::system_error(errorCode, std::generic_category(), "could not send data over UDP, sendmsg() failed");
+				}
+			}
+
+			ASSERT_INFO(size_t(len) == super_packet_size, "len = " << len)
+
+			num_bytes_sent += super_packet_size;
+		}
+	}
+#endif
+
+	// send rest of the datagrams using batched sending
+	std::array<std::pair<utki::span<uint8_t>, native_address>, max_batch_size> datagrams;
+
+	while(num_bytes_sent != buf.size()){
+		ASSERT(num_bytes_sent % segment_size == 0)
+
+		size_t num_datagrams = 0;
+		for(size_t offset = num_bytes_sent; offset != buf.size() && num_datagrams != datagrams.size(); ++num_datagrams){
+			size_t size = std::min(segment_size, buf.size() - offset);
+			datagrams[num_datagrams] = std::make_pair(
+					utki::span<uint8_t>(buf.data() + offset, size),
+					destination_address
+				);
+			offset += size;
+		}
+
+		size_t num_sent = this->send(utki::span<const decltype(datagrams)::value_type>(datagrams.data(), num_datagrams));
+
+		for(size_t i = 0; i != num_sent; ++i){
+			num_bytes_sent += datagrams[i].first.size();
+		}
+
+		if(num_sent != num_datagrams){
+			break; // can't send more datagrams
+		}
+	}
+
+	return num_bytes_sent;
+}
+
 size_t udp_socket::recieve(utki::span<uint8_t> buf, address &out_sender_address){
+	native_address sender;
+	size_t ret = this->recieve(buf, sender);
+	// zero-length datagrams are valid, so check if a datagram was received by the sender address being filled in
+	if(sender.get_size() != 0){
+		out_sender_address = sender.to_address();
+	}
+	return ret;
+}
+
+size_t udp_socket::recieve(utki::span<uint8_t> buf, address &out_sender_address, std::error_code& ec)noexcept{
+	native_address sender;
+	size_t ret = this->recieve(buf, sender, ec);
+	if(sender.get_size() != 0){
+		out_sender_address = sender.to_address();
+	}
+	return ret;
+}
+
+size_t udp_socket::recieve(utki::span<uint8_t> buf, native_address &out_sender_address){
 	if(!this->is_open()){
 		throw std::logic_error("udp_socket::recieve(): socket is not opened");
 	}
 
+	std::error_code ec;
+	size_t ret = this->recieve(buf, out_sender_address, ec);
+	if(ec){
+		throw std::system_error(ec, "could not receive data over UDP, recvfrom() failed");
+	}
+	return ret;
+}
+
+size_t udp_socket::recieve(utki::span<uint8_t> buf, native_address &out_sender_address, std::error_code& ec)noexcept{
+	if(!this->is_open()){
+		ec = std::make_error_code(std::errc::bad_file_descriptor);
+		return 0;
+	}
+
+	ec.clear();
+
 	// The "can read" flag shall be cleared even if this function fails.
 	// This is to avoid subsequent calls to Recv() because of it indicating
 	// that there's an activity.
 	// So, do it at the beginning of the function.
 	this->readiness_flags.clear(opros::ready::read);
 
-	sockaddr_storage sockAddr;
-
 #if M_OS == M_OS_WINDOWS
-	int sockLen = sizeof(sockAddr);
+	int sockLen = sizeof(out_sender_address.storage);
 #elif M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX || M_OS == M_OS_UNIX
-	socklen_t sockLen = sizeof(sockAddr);
+	socklen_t sockLen = sizeof(out_sender_address.storage);
 #else
 #	error "Unsupported OS"
 #endif
@@ -275,7 +684,7 @@ size_t udp_socket::recieve(utki::span<uint8_t> buf, address &out_sender_address)
 				reinterpret_cast<char*>(buf.data()),
 				int(buf.size()),
 				0,
-				reinterpret_cast<sockaddr*>(&sockAddr),
+				reinterpret_cast<sockaddr*>(&out_sender_address.storage),
 				&sockLen
 			);
 
@@ -290,7 +699,8 @@ size_t udp_socket::recieve(utki::span<uint8_t> buf, address &out_sender_address)
 			}else if(errorCode == error_again){
 				return 0; // no data available, return 0 bytes received
 			}else{
-				throw std::system_error(errorCode, std::generic_category(), "could not receive data over UDP, recvfrom() failed");
+				ec.assign(errorCode, std::generic_category());
+				return 0;
 			}
 		}
 		break;
@@ -299,35 +709,305 @@ size_t udp_socket::recieve(utki::span<uint8_t> buf, address &out_sender_address)
 	ASSERT(buf.size() <= size_t(std::numeric_limits<int>::max()))
 	ASSERT_INFO(len <= int(buf.size()), "len = " << len)
 
-	if(sockAddr.ss_family == AF_INET){
-		sockaddr_in& a = reinterpret_cast<sockaddr_in&>(sockAddr);
-		out_sender_address = address(
-				ntohl(a.sin_addr.s_addr),
-				uint16_t(ntohs(a.sin_port))
-			);
-	}else{
-		ASSERT_INFO(sockAddr.ss_family == AF_INET6, "sockAddr.ss_family = " << unsigned(sockAddr.ss_family) << " AF_INET = " << AF_INET << " AF_INET6 = " << AF_INET6)
-		sockaddr_in6& a = reinterpret_cast<sockaddr_in6&>(sockAddr);
-		out_sender_address = address(
-				address::ip(
-#if M_OS == M_OS_MACOSX || M_OS == M_OS_WINDOWS || (M_OS == M_OS_LINUX && M_OS_NAME == M_OS_NAME_ANDROID)
-						(uint32_t(a.sin6_addr.s6_addr[0]) << 24) | (uint32_t(a.sin6_addr.s6_addr[1]) << 16) | (uint32_t(a.sin6_addr.s6_addr[2]) << 8) | uint32_t(a.sin6_addr.s6_addr[3]),
-						(uint32_t(a.sin6_addr.s6_addr[4]) << 24) | (uint32_t(a.sin6_addr.s6_addr[5]) << 16) | (uint32_t(a.sin6_addr.s6_addr[6]) << 8) | uint32_t(a.sin6_addr.s6_addr[7]),
-						(uint32_t(a.sin6_addr.s6_addr[8]) << 24) | (uint32_t(a.sin6_addr.s6_addr[9]) << 16) | (uint32_t(a.sin6_addr.s6_addr[10]) << 8) | uint32_t(a.sin6_addr.s6_addr[11]),
-						(uint32_t(a.sin6_addr.s6_addr[12]) << 24) | (uint32_t(a.sin6_addr.s6_addr[13]) << 16) | (uint32_t(a.sin6_addr.s6_addr[14]) << 8) | uint32_t(a.sin6_addr.s6_addr[15])
+	out_sender_address.length = sockLen;
+
+	ASSERT(len >= 0)
+	return size_t(len);
+}
+
+size_t udp_socket::recieve(utki::span<uint8_t> buf){
+	if(!this->is_open()){
+		throw std::logic_error("udp_socket::recieve(): socket is not opened");
+	}
+
+	std::error_code ec;
+	size_t ret = this->recieve(buf, ec);
+	if(ec){
+		throw std::system_error(ec, "could not receive data over UDP, recv() failed");
+	}
+	return ret;
+}
+
+size_t udp_socket::recieve(utki::span<uint8_t> buf, std::error_code& ec)noexcept{
+	if(!this->is_open()){
+		ec = std::make_error_code(std::errc::bad_file_descriptor);
+		return 0;
+	}
+
+	ec.clear();
+
+	// same as for receiving with sender address, clear the "can read" flag at the beginning
+	this->readiness_flags.clear(opros::ready::read);
+
+#if M_OS == M_OS_WINDOWS
+	int len;
 #else
-						uint32_t(ntohl(a.sin6_addr.__in6_u.__u6_addr32[0])),
-						uint32_t(ntohl(a.sin6_addr.__in6_u.__u6_addr32[1])),
-						uint32_t(ntohl(a.sin6_addr.__in6_u.__u6_addr32[2])),
-						uint32_t(ntohl(a.sin6_addr.__in6_u.__u6_addr32[3]))
+	ssize_t len;
 #endif
-					),
-				uint16_t(ntohs(a.sin6_port))
+
+	while(true){
+		len = ::recv(
+				this->sock,
+				reinterpret_cast<char*>(buf.data()),
+				int(buf.size()),
+				0
 			);
+
+		if(len == socket_error){
+#if M_OS == M_OS_WINDOWS
+			int errorCode = WSAGetLastError();
+#else
+			int errorCode = errno;
+#endif
+			if(errorCode == error_interrupted){
+				continue;
+			}else if(errorCode == error_again){
+				return 0; // no data available, return 0 bytes received
+			}else{
+				ec.assign(errorCode, std::generic_category());
+				return 0;
+			}
+		}
+		break;
 	}
-	
+
+	ASSERT(buf.size() <= size_t(std::numeric_limits<int>::max()))
+	ASSERT_INFO(len <= int(buf.size()), "len = " << len)
+
+	ASSERT(len >= 0)
+	return size_t(len);
+}
+
+size_t udp_socket::recieve(utki::span<utki::span<uint8_t>> bufs, utki::span<address> out_sender_addresses){
+	if(out_sender_addresses.size() < bufs.size()){
+		throw std::logic_error("udp_socket::recieve(): out_sender_addresses array is smaller than bufs array");
+	}
+
+	std::array<native_address, max_batch_size> senders;
+
+	size_t num_bufs = std::min(bufs.size(), max_batch_size);
+
+	size_t num_received = this->recieve(
+			utki::span<utki::span<uint8_t>>(bufs.data(), num_bufs),
+			utki::span<native_address>(senders.data(), num_bufs)
+		);
+
+	for(size_t i = 0; i != num_received; ++i){
+		out_sender_addresses[i] = senders[i].to_address();
+	}
+
+	return num_received;
+}
+
+size_t udp_socket::recieve(utki::span<utki::span<uint8_t>> bufs, utki::span<native_address> out_sender_addresses){
+	if(!this->is_open()){
+		throw std::logic_error("udp_socket::recieve(): socket is not opened");
+	}
+
+	if(out_sender_addresses.size() < bufs.size()){
+		throw std::logic_error("udp_socket::recieve(): out_sender_addresses array is smaller than bufs array");
+	}
+
+	// same as for single datagram receiving, clear the "can read" flag at the beginning
+	this->readiness_flags.clear(opros::ready::read);
+
+	size_t num_bufs = std::min(bufs.size(), max_batch_size);
+
+#if M_OS == M_OS_LINUX
+	std::array<iovec, max_batch_size> iovecs;
+	std::array<mmsghdr, max_batch_size> msgs;
+
+	for(size_t i = 0; i != num_bufs; ++i){
+		iovecs[i].iov_base = bufs[i].data();
+		iovecs[i].iov_len = bufs[i].size();
+
+		msghdr& h = msgs[i].msg_hdr;
+		memset(&h, 0, sizeof(h));
+		h.msg_name = &out_sender_addresses[i].storage;
+		h.msg_namelen = sizeof(out_sender_addresses[i].storage);
+		h.msg_iov = &iovecs[i];
+		h.msg_iovlen = 1;
+	}
+
+	int num_received;
+
+	while(true){
+		num_received = recvmmsg(this->sock, msgs.data(), unsigned(num_bufs), 0, nullptr);
+
+		if(num_received == socket_error){
+			int errorCode = errno;
+			if(errorCode == error_interrupted){
+				continue;
+			}else if(errorCode == error_again){
+				return 0; // no data available, return 0 datagrams received
+			}else{
+				throw std::system_error(errorCode, std::generic_category(), "could not receive data over UDP, recvmmsg() failed");
+			}
+		}
+		break;
+	}
+
+	ASSERT(num_received >= 0)
+	ASSERT(size_t(num_received) <= num_bufs)
+
+	for(int i = 0; i != num_received; ++i){
+		ASSERT_INFO(msgs[i].msg_len <= bufs[i].size(), "msg_len = " << msgs[i].msg_len)
+		bufs[i] = utki::span<uint8_t>(bufs[i].data(), msgs[i].msg_len);
+		out_sender_addresses[i].length = msgs[i].msg_hdr.msg_namelen;
+	}
+
+	return size_t(num_received);
+#else
+	// no batch receiving system call, receive datagrams one by one
+	size_t num_received = 0;
+
+	for(; num_received != num_bufs; ++num_received){
+		auto& buf = bufs[num_received];
+		native_address& sender = out_sender_addresses[num_received];
+
+#	if M_OS == M_OS_WINDOWS
+		int sockLen = sizeof(sender.storage);
+		int len;
+#	else
+		socklen_t sockLen = sizeof(sender.storage);
+		ssize_t len;
+#	endif
+
+		while(true){
+			len = ::recvfrom(
+					this->sock,
+					reinterpret_cast<char*>(buf.data()),
+					int(buf.size()),
+					0,
+					reinterpret_cast<sockaddr*>(&sender.storage),
+					&sockLen
+				);
+
+			if(len == socket_error){
+#	if M_OS == M_OS_WINDOWS
+				int errorCode = WSAGetLastError();
+#	else
+				int errorCode = errno;
+#	endif
+				if(errorCode == error_interrupted){
+					continue;
+				}else if(errorCode == error_again){
+					break; // no more data available
+				}else if(num_received != 0){
+					// report the datagrams received so far, the error will be reported by subsequent call
+					break;
+				}else{
+					throw std::system_error(errorCode, std::generic_category(), "could not receive data over UDP, recvfrom() failed");
+				}
+			}
+			break;
+		}
+
+		if(len == socket_error){
+			break;
+		}
+
+		ASSERT_INFO(len <= int(buf.size()), "len = " << len)
+		buf = utki::span<uint8_t>(buf.data(), size_t(len));
+		sender.length = sockLen;
+	}
+
+	return num_received;
+#endif
+}
+
+bool udp_socket::enable_gro(){
+	if(!this->is_open()){
+		throw std::logic_error("udp_socket::enable_gro(): socket is not opened");
+	}
+
+#if M_OS == M_OS_LINUX && defined(UDP_GRO)
+	int yes = 1;
+	return setsockopt(this->sock, SOL_UDP, UDP_GRO, &yes, sizeof(yes)) == 0;
+#else
+	return false;
+#endif
+}
+
+size_t udp_socket::recieve(utki::span<uint8_t> buf, address &out_sender_address, size_t& out_segment_size){
+	native_address sender;
+	size_t ret = this->recieve(buf, sender, out_segment_size);
+	if(sender.get_size() != 0){
+		out_sender_address = sender.to_address();
+	}
+	return ret;
+}
+
+size_t udp_socket::recieve(utki::span<uint8_t> buf, native_address &out_sender_address, size_t& out_segment_size){
+#if M_OS == M_OS_LINUX && defined(UDP_GRO)
+	if(!this->is_open()){
+		throw std::logic_error("udp_socket::recieve(): socket is not opened");
+	}
+
+	// same as for single datagram receiving, clear the "can read" flag at the beginning
+	this->readiness_flags.clear(opros::ready::read);
+
+	iovec iov;
+	iov.iov_base = buf.data();
+	iov.iov_len = buf.size();
+
+	union{
+		char buf[CMSG_SPACE(sizeof(int))];
+		cmsghdr align;
+	} control;
+
+	msghdr h;
+	memset(&h, 0, sizeof(h));
+	h.msg_name = &out_sender_address.storage;
+	h.msg_namelen = sizeof(out_sender_address.storage);
+	h.msg_iov = &iov;
+	h.msg_iovlen = 1;
+	h.msg_control = control.buf;
+	h.msg_controllen = sizeof(control.buf);
+
+	ssize_t len;
+
+	while(true){
+		len = recvmsg(this->sock, &h, 0);
+
+		if(len == socket_error){
+			int errorCode = errno;
+			if(errorCode == error_interrupted){
+				continue;
+			}else if(errorCode == error_again){
+				return 0; // no data available, return 0 bytes received
+			}else{
+				throw std::system_error(errorCode, std::generic_category(), "could not receive data over UDP, recvmsg() failed");
+			}
+		}
+		break;
+	}
+
 	ASSERT(len >= 0)
+	ASSERT_INFO(size_t(len) <= buf.size(), "len = " << len)
+
+	out_segment_size = size_t(len);
+
+	for(cmsghdr* cm = CMSG_FIRSTHDR(&h); cm; cm = CMSG_NXTHDR(&h, cm)){
+		if(cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO && cm->cmsg_len >= CMSG_LEN(sizeof(int))){
+			int gso_size;
+			memcpy(&gso_size, CMSG_DATA(cm), sizeof(gso_size));
+			if(gso_size > 0){
+				out_segment_size = size_t(gso_size);
+			}
+			break;
+		}
+	}
+
+	out_sender_address.length = h.msg_namelen;
+
 	return size_t(len);
+#else
+	// no generic receive offload, received data is always a single datagram
+	size_t len = this->recieve(buf, out_sender_address);
+	out_segment_size = len;
+	return len;
+#endif
 }
 
 #if M_OS == M_OS_WINDOWS
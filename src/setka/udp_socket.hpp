@@ -1,12 +1,15 @@
 #pragma once
 
 #include <string>
+#include <utility>
+#include <system_error>
 
 #include <utki/config.hpp>
 #include <utki/span.hpp>
 
 #include "socket.hpp"
 #include "address.hpp"
+#include "native_address.hpp"
 
 namespace setka{
 
@@ -18,18 +21,31 @@ namespace setka{
  */
 class udp_socket : public socket{
 	bool ipv4;
+
+	enum class gso_support{
+		unknown,
+		supported,
+		unsupported
+	};
+
+	gso_support gso = gso_support::unknown; // whether OS supports UDP generic segmentation offload
+
+	void open_local(const address& local_address, bool dual_stack, const socket_options& options);
 public:
 	udp_socket(){}
 
 	udp_socket(const udp_socket&) = delete;
 
 	udp_socket(udp_socket&& s) :
-			socket(std::move(s))
+			socket(std::move(s)),
+			ipv4(s.ipv4),
+			gso(s.gso)
 	{}
 
 	udp_socket& operator=(udp_socket&& s){
 		this->socket::operator=(std::move(s));
 		this->ipv4 = s.ipv4;
+		this->gso = s.gso;
 		return *this;
 	}
 	
@@ -44,8 +60,49 @@ public:
 	 *               If 0 is passed then system will assign some free port if any. If there
 	 *               are no free ports, then it is an error and an exception will be thrown.
 	 *               This is useful for server-side sockets, for client-side sockets use udp_socket::Open().
+	 * @param options - socket options to set.
 	 */
-	void open(uint16_t port = 0);
+	void open(uint16_t port = 0, const socket_options& options = socket_options());
+
+	/**
+	 * @brief Open the socket bound to a local address.
+	 * Same as open(uint16_t, const socket_options&), but binds the socket to the given local IP address,
+	 * e.g. to receive datagrams only on a specific network interface.
+	 * The socket is of the local address family, i.e. IPv4 local address, including 0.0.0.0, gives IPv4 only socket,
+	 * and IPv6 local address, including ::, gives IPv6 only socket, which can only send datagrams to the addresses
+	 * of the same family. To bind to any local address for both IPv4 and IPv6 datagrams use open(uint16_t, const socket_options&).
+	 * @param local_address - local IP address and port to bind the socket to.
+	 *                        If port is 0 then the system will assign some free port.
+	 * @param options - socket options to set.
+	 */
+	void open(const address& local_address, const socket_options& options = socket_options());
+
+	/**
+	 * @brief Connect the socket to the remote peer.
+	 * Sets the default destination address for the datagrams sent by the connected send()
+	 * and limits the received datagrams to the ones coming from that address.
+	 * The address conversion and route lookup is done once by this call, instead of doing it for every datagram sent.
+	 * Note, that errors reported by the peer (e.g. when the peer's port is not open) may cause
+	 * subsequent send() or recieve() calls to throw an exception.
+	 * @param destination_address - IP address of the remote peer.
+	 */
+	void connect(const address& destination_address);
+
+	/**
+	 * @brief Connect the socket to the remote peer.
+	 * Same as connect() with address, but takes the address in native format.
+	 * @param destination_address - IP address of the remote peer.
+	 */
+	void connect(const native_address& destination_address);
+
+	/**
+	 * @brief Send datagram over connected UDP socket.
+	 * Same as send() with destination address, but sends the datagram to the address the socket is connected to.
+	 * @param buf - buffer containing the datagram to send.
+	 * @return number of bytes actually sent. Actually it is either 0 or the size of the
+	 *         datagram passed in as argument.
+	 */
+	size_t send(const utki::span<uint8_t> buf);
 
 	/**
 	 * @brief Send datagram over UDP socket.
@@ -60,6 +117,93 @@ public:
 	 */
 	size_t send(const utki::span<uint8_t> buf, const address& destination_address);
 
+	/**
+	 * @brief Send datagram over UDP socket.
+	 * Same as send() with address, but takes the destination address in native format,
+	 * which saves the address conversion when sending to the same destination repeatedly.
+	 * @param buf - buffer containing the datagram to send.
+	 * @param destination_address - the destination IP address to send the datagram to.
+	 * @return number of bytes actually sent. Actually it is either 0 or the size of the
+	 *         datagram passed in as argument.
+	 */
+	size_t send(const utki::span<uint8_t> buf, const native_address& destination_address);
+
+	/**
+	 * @brief Send datagram without throwing exceptions.
+	 * Same as the corresponding send() without error code argument, but reports errors via error code
+	 * instead of throwing, which is cheaper when errors are frequent.
+	 * @param buf - buffer containing the datagram to send.
+	 * @param ec - receives the error code, cleared on success. Closed socket is reported as std::errc::bad_file_descriptor.
+	 * @return number of bytes actually sent, 0 in case of error.
+	 */
+	size_t send(const utki::span<uint8_t> buf, std::error_code& ec)noexcept;
+
+	/**
+	 * @brief Send datagram without throwing exceptions.
+	 * @param buf - buffer containing the datagram to send.
+	 * @param destination_address - the destination IP address to send the datagram to.
+	 * @param ec - receives the error code, cleared on success.
+	 * @return number of bytes actually sent, 0 in case of error.
+	 */
+	size_t send(const utki::span<uint8_t> buf, const address& destination_address, std::error_code& ec)noexcept;
+
+	/**
+	 * @brief Send datagram without throwing exceptions.
+	 * @param buf - buffer containing the datagram to send.
+	 * @param destination_address - the destination IP address to send the datagram to.
+	 * @param ec - receives the error code, cleared on success.
+	 * @return number of bytes actually sent, 0 in case of error.
+	 */
+	size_t send(const utki::span<uint8_t> buf, const native_address& destination_address, std::error_code& ec)noexcept;
+
+	/**
+	 * @brief Send several datagrams at once.
+	 * Sends the datagrams using a single system call where OS supports it (sendmmsg() on Linux).
+	 * Other OSes send the datagrams one by one.
+	 * Each datagram is sent all at once, same as for the single datagram send().
+	 * Note, that not more than max_batch_size datagrams are sent per call.
+	 * @param datagrams - datagrams to send. Each datagram is a pair of the buffer containing
+	 *                    the datagram data and the destination IP address.
+	 * @return number of datagrams actually sent. If it is less than the number of given datagrams,
+	 *         then the rest of the datagrams cannot be sent at the current moment, the caller
+	 *         can resume sending from the datagram with the returned index.
+	 */
+	size_t send(utki::span<const std::pair<utki::span<uint8_t>, address>> datagrams);
+
+	/**
+	 * @brief Send several datagrams at once.
+	 * Same as batched send() with addresses, but takes the destination addresses in native format.
+	 * @param datagrams - datagrams to send. Each datagram is a pair of the buffer containing
+	 *                    the datagram data and the destination IP address.
+	 * @return number of datagrams actually sent.
+	 */
+	size_t send(utki::span<const std::pair<utki::span<uint8_t>, native_address>> datagrams);
+
+	/**
+	 * @brief Send buffer as a series of equal-sized datagrams.
+	 * The buffer is split into datagrams of segment_size bytes each, the last datagram can be shorter.
+	 * On Linux the buffer is handed to the kernel as a single UDP generic segmentation offload (GSO)
+	 * super-packet which is split into datagrams by the kernel or the network card. Big buffers are handed
+	 * over as several super-packets, because the kernel limits the number of segments in one super-packet.
+	 * If GSO is not supported by the OS or rejected by the kernel, the datagrams are sent using batched sending.
+	 * @param buf - buffer containing the datagrams to send.
+	 * @param segment_size - size of a single datagram.
+	 * @param destination_address - the destination IP address to send the datagrams to.
+	 * @return number of bytes actually sent. It is either the size of the buffer or a multiple of segment_size,
+	 *         i.e. the caller can resume sending from the returned offset when the socket becomes ready for writing.
+	 */
+	size_t send_segmented(const utki::span<uint8_t> buf, size_t segment_size, const address& destination_address);
+
+	/**
+	 * @brief Send buffer as a series of equal-sized datagrams.
+	 * Same as send_segmented() with address, but takes the destination address in native format.
+	 * @param buf - buffer containing the datagrams to send.
+	 * @param segment_size - size of a single datagram.
+	 * @param destination_address - the destination IP address to send the datagrams to.
+	 * @return number of bytes actually sent.
+	 */
+	size_t send_segmented(const utki::span<uint8_t> buf, size_t segment_size, const native_address& destination_address);
+
 	/**
 	 * @brief Receive datagram.
 	 * Writes a datagram to the given buffer at once if it is available.
@@ -67,6 +211,8 @@ public:
 	 * Note, that it will always write out the whole datagram at once. I.e. it is either all or nothing.
 	 * Except for the case when the given buffer is not large enough to store the datagram,
 	 * in which case the datagram is truncated to the size of the buffer and the rest of the data is lost.
+	 * Note, that if generic receive offload is enabled, the received data can contain several coalesced datagrams,
+	 * use the segment size reporting recieve() in that case.
 	 * @param buf - reference to the buffer the received datagram will be stored to. The buffer
 	 *              should be large enough to store the whole datagram. If datagram
 	 *              does not fit the passed buffer, then the datagram tail will be truncated
@@ -77,6 +223,126 @@ public:
 	 */
 	size_t recieve(utki::span<uint8_t> buf, address &out_sender_address);
 
+	/**
+	 * @brief Receive datagram.
+	 * Same as recieve() with address, but reports the sender address in native format.
+	 * Thus, the sender address is not converted unless it is needed, and it can be used to reply to the sender right away.
+	 * @param buf - reference to the buffer the received datagram will be stored to.
+	 * @param out_sender_address - reference to the native address object where the IP-address
+	 *                             of the sender will be stored.
+	 * @return number of bytes stored in the output buffer.
+	 */
+	size_t recieve(utki::span<uint8_t> buf, native_address &out_sender_address);
+
+	/**
+	 * @brief Receive datagram from connected UDP socket.
+	 * Same as recieve() with sender address, but does not report the sender address,
+	 * because for connected socket it is always the address the socket is connected to.
+	 * @param buf - reference to the buffer the received datagram will be stored to.
+	 * @return number of bytes stored in the output buffer.
+	 */
+	size_t recieve(utki::span<uint8_t> buf);
+
+	/**
+	 * @brief Receive datagram without throwing exceptions.
+	 * Same as the corresponding recieve() without error code argument, but reports errors via error code
+	 * instead of throwing, which is cheaper when errors are frequent.
+	 * @param buf - reference to the buffer the received datagram will be stored to.
+	 * @param ec - receives the error code, cleared on success. Closed socket is reported as std::errc::bad_file_descriptor.
+	 * @return number of bytes stored in the output buffer, 0 in case of error.
+	 */
+	size_t recieve(utki::span<uint8_t> buf, std::error_code& ec)noexcept;
+
+	/**
+	 * @brief Receive datagram without throwing exceptions.
+	 * @param buf - reference to the buffer the received datagram will be stored to.
+	 * @param out_sender_address - reference to the IP-address structure where the IP-address
+	 *                             of the sender will be stored.
+	 * @param ec - receives the error code, cleared on success.
+	 * @return number of bytes stored in the output buffer, 0 in case of error.
+	 */
+	size_t recieve(utki::span<uint8_t> buf, address &out_sender_address, std::error_code& ec)noexcept;
+
+	/**
+	 * @brief Receive datagram without throwing exceptions.
+	 * @param buf - reference to the buffer the received datagram will be stored to.
+	 * @param out_sender_address - reference to the native address object where the IP-address
+	 *                             of the sender will be stored.
+	 * @param ec - receives the error code, cleared on success.
+	 * @return number of bytes stored in the output buffer, 0 in case of error.
+	 */
+	size_t recieve(utki::span<uint8_t> buf, native_address &out_sender_address, std::error_code& ec)noexcept;
+
+	/**
+	 * @brief Receive several datagrams at once.
+	 * Receives available datagrams, one datagram per buffer, using a single system call
+	 * where OS supports it (recvmmsg() on Linux). Other OSes receive the datagrams one by one.
+	 * If there are no received datagrams available a 0 will be returned.
+	 * Same as for the single datagram recieve(), datagrams which do not fit into their buffers
+	 * are truncated and the rest of the data is lost.
+	 * Note, that not more than max_batch_size datagrams are received per call.
+	 * @param bufs - buffers to store the received datagrams to. Upon return, the first N spans,
+	 *               where N is the returned value, are shrunk to the sizes of the received datagrams.
+	 * @param out_sender_addresses - array where the IP-addresses of the datagram senders will be stored.
+	 *                               Must not be smaller than bufs.
+	 * @return number of datagrams received.
+	 */
+	size_t recieve(utki::span<utki::span<uint8_t>> bufs, utki::span<address> out_sender_addresses);
+
+	/**
+	 * @brief Receive several datagrams at once.
+	 * Same as batched recieve() with addresses, but reports the sender addresses in native format.
+	 * @param bufs - buffers to store the received datagrams to. Upon return, the first N spans,
+	 *               where N is the returned value, are shrunk to the sizes of the received datagrams.
+	 * @param out_sender_addresses - array where the IP-addresses of the datagram senders will be stored.
+	 *                               Must not be smaller than bufs.
+	 * @return number of datagrams received.
+	 */
+	size_t recieve(utki::span<utki::span<uint8_t>> bufs, utki::span<native_address> out_sender_addresses);
+
+	/**
+	 * @brief Enable UDP generic receive offload.
+	 * With GRO enabled, the OS can coalesce several consecutive datagrams of equal size
+	 * from the same sender into one buffer which is received at once.
+	 * Such coalesced buffers have to be received with the segment size reporting recieve() function,
+	 * so that the individual datagrams can be found in the received data.
+	 * Receiving buffer should be large enough to hold a coalesced buffer, i.e. 64 kilobytes.
+	 * Note, that GRO is supported only on Linux.
+	 * @return true if GRO has been enabled.
+	 * @return false if GRO is not supported by the OS.
+	 */
+	bool enable_gro();
+
+	/**
+	 * @brief Receive datagram or several coalesced datagrams.
+	 * Same as single datagram recieve(), but in case generic receive offload is enabled,
+	 * it can receive several coalesced datagrams at once. All the coalesced datagrams
+	 * are of the same size which is reported via out_segment_size, except the last datagram which can be shorter.
+	 * If received data is a single datagram, then out_segment_size is set to the size of that datagram.
+	 * @param buf - buffer where the received data will be stored to.
+	 * @param out_sender_address - reference to the IP-address structure where the IP-address
+	 *                             of the sender will be stored.
+	 * @param out_segment_size - reference to the variable where the size of a single coalesced datagram will be stored.
+	 * @return number of bytes stored in the output buffer.
+	 */
+	size_t recieve(utki::span<uint8_t> buf, address &out_sender_address, size_t& out_segment_size);
+
+	/**
+	 * @brief Receive datagram or several coalesced datagrams.
+	 * Same as segment size reporting recieve() with address, but reports the sender address in native format.
+	 * @param buf - buffer where the received data will be stored to.
+	 * @param out_sender_address - reference to the native address object where the IP-address
+	 *                             of the sender will be stored.
+	 * @param out_segment_size - reference to the variable where the size of a single coalesced datagram will be stored.
+	 * @return number of bytes stored in the output buffer.
+	 */
+	size_t recieve(utki::span<uint8_t> buf, native_address &out_sender_address, size_t& out_segment_size);
+
+	/**
+	 * @brief Maximum number of datagrams handled by one batch operation call.
+	 */
+	static constexpr size_t max_batch_size = 64;
+
 #if M_OS == M_OS_WINDOWS
 private:
 	void set_waiting_flags(utki::flags<opros::ready> waiting_flags)override;
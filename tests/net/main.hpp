@@ -14,6 +14,31 @@ inline void TestTingSocket(){
 	BasicClientServerTest::Run();
 	BasicUDPSocketsTest::Run();
 	TestUDPSocketWaitForWriting::Run();
+	BatchedUDPRecieveTest::Run();
+	BatchedUDPSendTest::Run();
+	SegmentedUDPSendTest::Run();
+	GROUDPRecieveTest::Run();
+	ConnectedUDPTest::Run();
+	NativeAddressTest::Run();
+	ZeroCopyTCPTest::Run();
+	VectoredTCPTest::Run();
+	SendFileTest::Run();
+	TCPRelayTest::Run();
+	BatchedAcceptTest::Run();
+	ShardedListenersTest::Run();
+	BindToLocalAddressTest::Run();
+	DeferredAcceptTest::Run();
+	FastOpenTest::Run();
+	ConnectionStateTest::Run();
+	ConnectorTest::Run();
+	ErrorCodeTest::Run();
+	TCPStatsTest::Run();
+	SocketOptionsTest::Run();
+	ReactorTest::Run();
+	IoRingTest::Run();
+	EventLoopTest::Run();
+	ReactorPoolTest::Run();
+	TimerWheelTest::Run();
 	SendDataContinuouslyWithWaitSet::Run();
 	SendDataContinuously::Run();
 
@@ -1,6 +1,13 @@
 #include "../../src/setka/tcp_socket.hpp"
 #include "../../src/setka/tcp_server_socket.hpp"
 #include "../../src/setka/udp_socket.hpp"
+#include "../../src/setka/tcp_relay.hpp"
+#include "../../src/setka/tcp_connector.hpp"
+#include "../../src/setka/reactor.hpp"
+#include "../../src/setka/io_ring.hpp"
+#include "../../src/setka/event_loop.hpp"
+#include "../../src/setka/reactor_pool.hpp"
+#include "../../src/setka/timer_wheel.hpp"
 
 #include <opros/wait_set.hpp>
 #include <nitki/thread.hpp>
@@ -10,6 +17,17 @@
 #include <utki/time.hpp>
 #include <utki/debug.hpp>
 
+#include <set>
+#include <list>
+#include <atomic>
+#include <limits>
+
+#if M_OS == M_OS_LINUX
+#	include <sys/resource.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
 #include "socket.hpp"
 
 namespace{
@@ -44,6 +62,41 @@ bool IsIPv6SupportedByOS(){
 	return true;
 #endif
 }
+
+#if M_OS == M_OS_LINUX
+// Opens files until there are no file descriptors left, except the given number of them.
+// The limit of open files is lowered, so that it does not take too long.
+std::vector<int> useUpFileDescriptors(rlimit& outOrigLimit, unsigned numLeft){
+	ASSERT_ALWAYS(getrlimit(RLIMIT_NOFILE, &outOrigLimit) == 0)
+	rlimit limit = outOrigLimit;
+	limit.rlim_cur = std::min(limit.rlim_cur, rlim_t(4096));
+	ASSERT_ALWAYS(setrlimit(RLIMIT_NOFILE, &limit) == 0)
+
+	std::vector<int> fds;
+	for(;;){
+		int fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+		if(fd < 0){
+			ASSERT_ALWAYS(errno == EMFILE)
+			break;
+		}
+		fds.push_back(fd);
+	}
+
+	ASSERT_ALWAYS(fds.size() >= numLeft)
+	for(; numLeft != 0; --numLeft){
+		::close(fds.back());
+		fds.pop_back();
+	}
+	return fds;
+}
+
+void releaseFileDescriptors(const std::vector<int>& fds, const rlimit& origLimit){
+	for(int fd : fds){
+		::close(fd);
+	}
+	ASSERT_ALWAYS(setrlimit(RLIMIT_NOFILE, &origLimit) == 0)
+}
+#endif
 }
 
 namespace BasicClientServerTest{
@@ -745,3 +798,2232 @@ void Run(){
 	}
 }
 }
+
+namespace BatchedUDPRecieveTest{
+void Run(){
+	try{
+		setka::udp_socket recvSock;
+		recvSock.open(13666);
+
+		setka::udp_socket sendSock;
+		sendSock.open();
+
+		setka::address addr("127.0.0.1", 13666);
+
+		const unsigned numDatagrams = 5;
+
+		for(unsigned i = 0; i != numDatagrams; ++i){
+			std::array<uint8_t, 4> data;
+			utki::serialize32le(i, &*data.begin());
+			size_t bytesSent = 0;
+			for(unsigned j = 0; j < 10 && bytesSent == 0; ++j){
+				bytesSent = sendSock.send(utki::make_span(data), addr);
+				if(bytesSent == 0){
+					std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				}
+			}
+			ASSERT_ALWAYS(bytesSent == data.size())
+		}
+
+		std::array<std::array<uint8_t, 1024>, numDatagrams + 2> storage;
+		std::array<utki::span<uint8_t>, numDatagrams + 2> bufs;
+		std::array<setka::address, numDatagrams + 2> senders;
+
+		unsigned numReceived = 0;
+		for(unsigned i = 0; i < 10 && numReceived != numDatagrams; ++i){
+			for(unsigned j = 0; j != bufs.size(); ++j){
+				bufs[j] = utki::make_span(storage[j]);
+			}
+			auto spans = utki::make_span(bufs);
+			size_t res = recvSock.recieve(spans, utki::make_span(senders));
+			ASSERT_ALWAYS(numReceived + res <= numDatagrams)
+			for(unsigned j = 0; j != res; ++j){
+				ASSERT_INFO_ALWAYS(bufs[j].size() == 4, "bufs[j].size() = " << bufs[j].size())
+				ASSERT_ALWAYS(utki::deserialize32le(bufs[j].data()) == numReceived)
+				ASSERT_ALWAYS(senders[j].host.get_v4() == 0x7f000001)
+				ASSERT_ALWAYS(senders[j].port == sendSock.get_local_port())
+				++numReceived;
+			}
+			if(res == 0){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+		ASSERT_ALWAYS(numReceived == numDatagrams)
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
+
+
+namespace BatchedUDPSendTest{
+void Run(){
+	try{
+		setka::udp_socket recvSock;
+		recvSock.open(13666);
+
+		setka::udp_socket sendSock;
+		sendSock.open();
+
+		setka::address addr("127.0.0.1", 13666);
+
+		const unsigned numDatagrams = 5;
+
+		std::array<std::array<uint8_t, 4>, numDatagrams> data;
+		std::array<std::pair<utki::span<uint8_t>, setka::address>, numDatagrams> datagrams;
+		for(unsigned i = 0; i != numDatagrams; ++i){
+			utki::serialize32le(i, &*data[i].begin());
+			datagrams[i] = std::make_pair(utki::make_span(data[i]), addr);
+		}
+
+		size_t numSent = 0;
+		for(unsigned i = 0; i < 10 && numSent != numDatagrams; ++i){
+			numSent += sendSock.send(utki::span<const decltype(datagrams)::value_type>(&datagrams[numSent], datagrams.size() - numSent));
+			if(numSent != numDatagrams){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+		ASSERT_ALWAYS(numSent == numDatagrams)
+
+		unsigned numReceived = 0;
+		for(unsigned i = 0; i < 10 + numDatagrams && numReceived != numDatagrams; ++i){
+			std::array<uint8_t, 1024> buf;
+			setka::address sender;
+			size_t res = recvSock.recieve(utki::make_span(buf), sender);
+			if(res == 0){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				continue;
+			}
+			ASSERT_INFO_ALWAYS(res == 4, "res = " << res)
+			ASSERT_ALWAYS(utki::deserialize32le(buf.data()) == numReceived)
+			ASSERT_ALWAYS(sender.host.get_v4() == 0x7f000001)
+			ASSERT_ALWAYS(sender.port == sendSock.get_local_port())
+			++numReceived;
+		}
+		ASSERT_ALWAYS(numReceived == numDatagrams)
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
+
+namespace SegmentedUDPSendTest{
+void Run(){
+	try{
+		setka::udp_socket recvSock;
+		recvSock.open(13666);
+
+		setka::udp_socket sendSock;
+		sendSock.open();
+
+		setka::address addr("127.0.0.1", 13666);
+
+		const size_t segmentSize = 100;
+		const unsigned numDatagrams = 10;
+
+		std::vector<uint8_t> data(segmentSize * (numDatagrams - 1) + segmentSize / 2); // last datagram is shorter
+		for(size_t i = 0; i != data.size(); ++i){
+			data[i] = uint8_t(i / segmentSize);
+		}
+
+		size_t bytesSent = 0;
+		for(unsigned i = 0; i < 10 && bytesSent != data.size(); ++i){
+			bytesSent += sendSock.send_segmented(utki::span<uint8_t>(data.data() + bytesSent, data.size() - bytesSent), segmentSize, addr);
+			ASSERT_ALWAYS(bytesSent % segmentSize == 0 || bytesSent == data.size())
+			if(bytesSent != data.size()){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+		ASSERT_ALWAYS(bytesSent == data.size())
+
+		unsigned numReceived = 0;
+		for(unsigned i = 0; i < 20 && numReceived != numDatagrams; ++i){
+			std::array<uint8_t, 1024> buf;
+			setka::address sender;
+			size_t res = recvSock.recieve(utki::make_span(buf), sender);
+			if(res == 0){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				continue;
+			}
+			ASSERT_INFO_ALWAYS(res == (numReceived == numDatagrams - 1 ? segmentSize / 2 : segmentSize), "res = " << res)
+			for(size_t j = 0; j != res; ++j){
+				ASSERT_ALWAYS(buf[j] == numReceived)
+			}
+			++numReceived;
+		}
+		ASSERT_ALWAYS(numReceived == numDatagrams)
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
+
+namespace GROUDPRecieveTest{
+void Run(){
+	try{
+		setka::udp_socket recvSock;
+		recvSock.open(13666);
+
+		bool groEnabled = recvSock.enable_gro();
+#if M_OS == M_OS_LINUX
+		if(!groEnabled){
+			utki::log([](auto&o){o << "WARNING: UDP GRO is not supported by the OS" << std::endl;});
+		}
+#else
+		ASSERT_ALWAYS(!groEnabled)
+#endif
+
+		setka::udp_socket sendSock;
+		sendSock.open();
+
+		setka::address addr("127.0.0.1", 13666);
+
+		const size_t segmentSize = 100;
+		const unsigned numDatagrams = 10;
+
+		std::vector<uint8_t> data(segmentSize * numDatagrams);
+		for(size_t i = 0; i != data.size(); ++i){
+			data[i] = uint8_t(i / segmentSize);
+		}
+
+		size_t bytesSent = 0;
+		for(unsigned i = 0; i < 10 && bytesSent != data.size(); ++i){
+			bytesSent += sendSock.send_segmented(utki::span<uint8_t>(data.data() + bytesSent, data.size() - bytesSent), segmentSize, addr);
+			if(bytesSent != data.size()){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+		ASSERT_ALWAYS(bytesSent == data.size())
+
+		unsigned numReceived = 0;
+		for(unsigned i = 0; i < 20 && numReceived != numDatagrams; ++i){
+			std::vector<uint8_t> buf(0x10000);
+			setka::address sender;
+			size_t segSize;
+			size_t res = recvSock.recieve(utki::make_span(buf), sender, segSize);
+			if(res == 0){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				continue;
+			}
+			ASSERT_INFO_ALWAYS(segSize == segmentSize, "segSize = " << segSize)
+			ASSERT_ALWAYS(res % segmentSize == 0)
+			ASSERT_ALWAYS(sender.host.get_v4() == 0x7f000001)
+
+			// walk the coalesced datagrams
+			for(size_t offset = 0; offset != res; offset += segSize){
+				for(size_t j = 0; j != segSize; ++j){
+					ASSERT_ALWAYS(buf[offset + j] == numReceived)
+				}
+				++numReceived;
+			}
+		}
+		ASSERT_ALWAYS(numReceived == numDatagrams)
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
+
+namespace ConnectedUDPTest{
+void Run(){
+	try{
+		setka::udp_socket sockA;
+		sockA.open(13666);
+
+		setka::udp_socket sockB;
+		sockB.open();
+		sockB.connect(setka::address("127.0.0.1", 13666));
+
+		std::array<uint8_t, 4> data = {{'0', '1', '2', '4'}};
+
+		size_t bytesSent = 0;
+		for(unsigned i = 0; i < 10 && bytesSent == 0; ++i){
+			bytesSent = sockB.send(utki::make_span(data));
+			if(bytesSent == 0){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+		ASSERT_ALWAYS(bytesSent == data.size())
+
+		setka::address addrB;
+		std::array<uint8_t, 1024> buf;
+		size_t bytesReceived = 0;
+		for(unsigned i = 0; i < 10 && bytesReceived == 0; ++i){
+			bytesReceived = sockA.recieve(utki::make_span(buf), addrB);
+			if(bytesReceived == 0){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+		ASSERT_ALWAYS(bytesReceived == data.size())
+		ASSERT_ALWAYS(std::equal(data.begin(), data.end(), buf.begin()))
+		ASSERT_ALWAYS(addrB.port == sockB.get_local_port())
+
+		// reply to the connected socket
+		sockA.connect(addrB);
+
+		bytesSent = 0;
+		for(unsigned i = 0; i < 10 && bytesSent == 0; ++i){
+			bytesSent = sockA.send(utki::make_span(data));
+			if(bytesSent == 0){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+		ASSERT_ALWAYS(bytesSent == data.size())
+
+		bytesReceived = 0;
+		for(unsigned i = 0; i < 10 && bytesReceived == 0; ++i){
+			bytesReceived = sockB.recieve(utki::make_span(buf));
+			if(bytesReceived == 0){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+		ASSERT_ALWAYS(bytesReceived == data.size())
+		ASSERT_ALWAYS(std::equal(data.begin(), data.end(), buf.begin()))
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
+
+
+
+namespace NativeAddressTest{
+void Run(){
+	// conversion round trip
+	{
+		setka::address a("127.0.0.1", 13666);
+		setka::native_address n(a);
+		ASSERT_ALWAYS(n.is_v4())
+		ASSERT_ALWAYS(n.get_size() != 0)
+		setka::address b = n.to_address();
+		ASSERT_ALWAYS(b.host == a.host)
+		ASSERT_ALWAYS(b.port == a.port)
+
+		setka::address m = n.to_v6().to_address();
+		ASSERT_ALWAYS(m.host.is_v4())
+		ASSERT_ALWAYS(m.host.get_v4() == a.host.get_v4())
+		ASSERT_ALWAYS(m.port == a.port)
+	}
+	{
+		setka::address a("1234:5678:9abc:def0:fedc:ba98:7654:3210", 13666);
+		setka::native_address n(a);
+		ASSERT_ALWAYS(!n.is_v4())
+		setka::address b = n.to_address();
+		ASSERT_ALWAYS(b.host == a.host)
+		ASSERT_ALWAYS(b.port == a.port)
+	}
+
+	// undefined native address
+	{
+		setka::native_address n;
+		ASSERT_ALWAYS(!n.is_v4())
+		ASSERT_ALWAYS(n.get_size() == 0)
+		setka::address a = n.to_address();
+		ASSERT_ALWAYS(!a.host.is_valid())
+		ASSERT_ALWAYS(a.port == 0)
+	}
+
+	// sending and receiving using native addresses
+	try{
+		setka::udp_socket sockA;
+		sockA.open(13666);
+
+		setka::udp_socket sockB;
+		sockB.open();
+
+		// nothing received, the sender address remains undefined
+		{
+			setka::native_address sender;
+			std::array<uint8_t, 4> buf;
+			ASSERT_ALWAYS(sockA.recieve(utki::make_span(buf), sender) == 0)
+			ASSERT_ALWAYS(sender.get_size() == 0)
+			ASSERT_ALWAYS(!sender.to_address().host.is_valid())
+		}
+
+		std::array<uint8_t, 4> data = {{'t', 'e', 's', 't'}};
+
+		setka::native_address dst(setka::address("127.0.0.1", 13666));
+
+		size_t bytesSent = 0;
+		for(unsigned i = 0; i < 10 && bytesSent == 0; ++i){
+			bytesSent = sockB.send(utki::make_span(data), dst);
+			if(bytesSent == 0){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+		ASSERT_ALWAYS(bytesSent == data.size())
+
+		setka::native_address sender;
+		std::array<uint8_t, 1024> buf;
+		size_t bytesReceived = 0;
+		for(unsigned i = 0; i < 10 && bytesReceived == 0; ++i){
+			bytesReceived = sockA.recieve(utki::make_span(buf), sender);
+			if(bytesReceived == 0){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+		ASSERT_ALWAYS(bytesReceived == data.size())
+		ASSERT_ALWAYS(std::equal(data.begin(), data.end(), buf.begin()))
+		ASSERT_ALWAYS(sender.to_address().port == sockB.get_local_port())
+
+		// reply using the received native address
+		bytesSent = 0;
+		for(unsigned i = 0; i < 10 && bytesSent == 0; ++i){
+			bytesSent = sockA.send(utki::make_span(data), sender);
+			if(bytesSent == 0){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+		ASSERT_ALWAYS(bytesSent == data.size())
+
+		setka::address addr;
+		bytesReceived = 0;
+		for(unsigned i = 0; i < 10 && bytesReceived == 0; ++i){
+			bytesReceived = sockB.recieve(utki::make_span(buf), addr);
+			if(bytesReceived == 0){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+		ASSERT_ALWAYS(bytesReceived == data.size())
+		ASSERT_ALWAYS(addr.port == 13666)
+
+		// zero-length datagram also reports its sender
+		bytesSent = sockB.send(utki::span<uint8_t>(), dst);
+		ASSERT_ALWAYS(bytesSent == 0)
+
+		setka::address emptySender(setka::address::ip(0), 0);
+		for(unsigned i = 0; i < 10 && emptySender.port == 0; ++i){
+			bytesReceived = sockA.recieve(utki::make_span(buf), emptySender);
+			ASSERT_ALWAYS(bytesReceived == 0)
+			if(emptySender.port == 0){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+		ASSERT_ALWAYS(emptySender.port == sockB.get_local_port())
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
+
+
+
+namespace ZeroCopyTCPTest{
+void Run(){
+	try{
+		setka::tcp_server_socket serverSock;
+		serverSock.open(13666);
+
+		setka::tcp_socket sockS;
+		sockS.open(setka::address("127.0.0.1", 13666));
+
+		setka::tcp_socket sockR;
+		for(unsigned i = 0; i < 10 && !sockR.is_open(); ++i){
+			sockR = serverSock.accept();
+			if(!sockR.is_open()){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+		ASSERT_ALWAYS(sockR.is_open())
+
+		if(!sockS.enable_zerocopy()){
+			// zero-copy sending is not supported
+			return;
+		}
+
+		std::vector<uint8_t> data(0x10000);
+		for(size_t i = 0; i != data.size(); ++i){
+			data[i] = uint8_t(i);
+		}
+
+		// send the data in two chunks to get two completion ids
+		size_t half = data.size() / 2;
+		size_t bytesSent = 0;
+		uint32_t lastId = 0;
+		unsigned numSends = 0;
+		for(unsigned i = 0; i < 100 && bytesSent != data.size(); ++i){
+			size_t end = bytesSent < half ? half : data.size();
+			uint32_t id;
+			size_t res = sockS.send_zerocopy(utki::span<uint8_t>(&data[bytesSent], end - bytesSent), id);
+			if(res == 0){
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				continue;
+			}
+			ASSERT_INFO_ALWAYS(id == numSends, "id = " << id << " numSends = " << numSends)
+			lastId = id;
+			++numSends;
+			bytesSent += res;
+		}
+		ASSERT_ALWAYS(bytesSent == data.size())
+		ASSERT_ALWAYS(numSends >= 2)
+
+		std::vector<uint8_t> buf(data.size());
+		size_t bytesReceived = 0;
+		for(unsigned i = 0; i < 100 && bytesReceived != buf.size(); ++i){
+			size_t res = sockR.recieve(utki::span<uint8_t>(&buf[bytesReceived], buf.size() - bytesReceived));
+			if(res == 0){
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+			bytesReceived += res;
+		}
+		ASSERT_ALWAYS(bytesReceived == buf.size())
+		ASSERT_ALWAYS(buf == data)
+
+		// all sends should complete once the data is received by peer
+		std::array<setka::tcp_socket::zerocopy_completion, 8> completions;
+		uint32_t nextExpectedId = 0;
+		for(unsigned i = 0; i < 100 && nextExpectedId != lastId + 1; ++i){
+			size_t num = sockS.recieve_zerocopy_completions(utki::make_span(completions));
+			if(num == 0){
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+			for(size_t j = 0; j != num; ++j){
+				ASSERT_ALWAYS(completions[j].first_id == nextExpectedId)
+				ASSERT_ALWAYS(completions[j].last_id >= completions[j].first_id)
+				nextExpectedId = completions[j].last_id + 1;
+			}
+		}
+		ASSERT_INFO_ALWAYS(nextExpectedId == lastId + 1, "nextExpectedId = " << nextExpectedId << " lastId = " << lastId)
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
+
+
+
+namespace VectoredTCPTest{
+void Run(){
+	try{
+		setka::tcp_server_socket serverSock;
+		serverSock.open(13666);
+
+		setka::tcp_socket sockS;
+		sockS.open(setka::address("127.0.0.1", 13666));
+
+		setka::tcp_socket sockR;
+		for(unsigned i = 0; i < 10 && !sockR.is_open(); ++i){
+			sockR = serverSock.accept();
+			if(!sockR.is_open()){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+		ASSERT_ALWAYS(sockR.is_open())
+
+		std::array<uint8_t, 4> header = {{'h', 'e', 'a', 'd'}};
+		std::array<uint8_t, 10> payload = {{'0', '1', '2', '3', '4', '5', '6', '7', '8', '9'}};
+
+		std::array<utki::span<uint8_t>, 2> sendBufs = {{
+			utki::make_span(header),
+			utki::make_span(payload)
+		}};
+
+		size_t bytesSent = 0;
+		for(unsigned i = 0; i < 10 && bytesSent == 0; ++i){
+			bytesSent = sockS.send(utki::span<const utki::span<uint8_t>>(sendBufs.data(), sendBufs.size()));
+			if(bytesSent == 0){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+		ASSERT_ALWAYS(bytesSent == header.size() + payload.size())
+
+		// receive into buffers of different sizes
+		std::array<uint8_t, 6> bufA;
+		std::array<uint8_t, 3> bufB;
+		std::array<uint8_t, 100> bufC;
+
+		std::array<utki::span<uint8_t>, 3> recvBufs = {{
+			utki::make_span(bufA),
+			utki::make_span(bufB),
+			utki::make_span(bufC)
+		}};
+
+		size_t bytesReceived = 0;
+		for(unsigned i = 0; i < 10 && bytesReceived == 0; ++i){
+			bytesReceived = sockR.recieve(utki::span<const utki::span<uint8_t>>(recvBufs.data(), recvBufs.size()));
+			if(bytesReceived == 0){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+		ASSERT_INFO_ALWAYS(bytesReceived == header.size() + payload.size(), "bytesReceived = " << bytesReceived)
+
+		std::vector<uint8_t> expected(header.begin(), header.end());
+		expected.insert(expected.end(), payload.begin(), payload.end());
+
+		std::vector<uint8_t> received(bufA.begin(), bufA.end());
+		received.insert(received.end(), bufB.begin(), bufB.end());
+		received.insert(received.end(), bufC.begin(), bufC.begin() + (bytesReceived - bufA.size() - bufB.size()));
+
+		ASSERT_ALWAYS(received == expected)
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
+
+
+
+namespace SendFileTest{
+void Run(){
+#if M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX || M_OS == M_OS_UNIX
+	try{
+		std::vector<uint8_t> data(0x20000);
+		for(size_t i = 0; i != data.size(); ++i){
+			data[i] = uint8_t(i * 7);
+		}
+
+		std::unique_ptr<FILE, decltype(&fclose)> file(tmpfile(), &fclose);
+		ASSERT_ALWAYS(file)
+		FILE* f = file.get();
+
+		ASSERT_ALWAYS(fwrite(data.data(), 1, data.size(), f) == data.size())
+		ASSERT_ALWAYS(fflush(f) == 0)
+
+		setka::tcp_server_socket serverSock;
+		serverSock.open(13666);
+
+		setka::tcp_socket sockS;
+		sockS.open(setka::address("127.0.0.1", 13666));
+
+		setka::tcp_socket sockR;
+		for(unsigned i = 0; i < 10 && !sockR.is_open(); ++i){
+			sockR = serverSock.accept();
+			if(!sockR.is_open()){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+		ASSERT_ALWAYS(sockR.is_open())
+
+		// send the file, except the first 100 bytes, while receiving on the other end
+		const uint64_t start = 100;
+		uint64_t offset = start;
+
+		std::vector<uint8_t> buf(data.size());
+		size_t bytesReceived = 0;
+
+		for(unsigned i = 0; i < 1000 && bytesReceived != data.size() - start; ++i){
+			if(offset != data.size()){
+				size_t res = sockS.send_file(fileno(f), offset, size_t(data.size() - offset));
+				ASSERT_ALWAYS(offset <= data.size())
+				ASSERT_ALWAYS(res <= data.size())
+			}
+
+			size_t res = sockR.recieve(utki::span<uint8_t>(&buf[bytesReceived], buf.size() - bytesReceived));
+			if(res == 0){
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+			bytesReceived += res;
+		}
+		ASSERT_ALWAYS(offset == data.size())
+		ASSERT_INFO_ALWAYS(bytesReceived == data.size() - start, "bytesReceived = " << bytesReceived)
+		ASSERT_ALWAYS(std::equal(data.begin() + start, data.end(), buf.begin()))
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+#endif
+}
+}
+
+
+
+namespace TCPRelayTest{
+setka::tcp_socket Accept(setka::tcp_server_socket& serverSock){
+	setka::tcp_socket ret;
+	for(unsigned i = 0; i < 20 && !ret.is_open(); ++i){
+		ret = serverSock.accept();
+		if(!ret.is_open()){
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+	}
+	ASSERT_ALWAYS(ret.is_open())
+	return ret;
+}
+
+void Run(){
+	try{
+		setka::tcp_server_socket serverSock;
+		serverSock.open(13666);
+
+		// sockA <-> sockRA <relay> sockRB <-> sockB
+		setka::tcp_socket sockA;
+		sockA.open(setka::address("127.0.0.1", 13666));
+		setka::tcp_socket sockRA = Accept(serverSock);
+
+		setka::tcp_socket sockB;
+		sockB.open(setka::address("127.0.0.1", 13666));
+		setka::tcp_socket sockRB = Accept(serverSock);
+
+		setka::tcp_relay relay(sockRA, sockRB);
+
+		opros::wait_set ws(2);
+		ws.add(sockRA, relay.get_waiting_flags(sockRA));
+		ws.add(sockRB, relay.get_waiting_flags(sockRB));
+
+		auto updateRelay = [&](){
+			ws.wait(10);
+			relay.update();
+			ws.change(sockRA, relay.get_waiting_flags(sockRA));
+			ws.change(sockRB, relay.get_waiting_flags(sockRB));
+		};
+
+		// send lots of data from A to B, more than fits into socket buffers, to test backpressure
+		std::vector<uint8_t> data(0x200000);
+		for(size_t i = 0; i != data.size(); ++i){
+			data[i] = uint8_t(i * 13);
+		}
+
+		std::vector<uint8_t> buf(data.size());
+
+		size_t bytesSent = 0;
+		size_t bytesReceived = 0;
+
+		for(unsigned i = 0; i < 10000 && bytesReceived != data.size(); ++i){
+			if(bytesSent != data.size()){
+				bytesSent += sockA.send(utki::span<uint8_t>(&data[bytesSent], data.size() - bytesSent));
+			}
+
+			updateRelay();
+
+			// receive only every other iteration to let the buffers fill up
+			if(i % 2 == 0){
+				bytesReceived += sockB.recieve(utki::span<uint8_t>(&buf[bytesReceived], buf.size() - bytesReceived));
+			}
+		}
+		ASSERT_INFO_ALWAYS(bytesReceived == data.size(), "bytesReceived = " << bytesReceived)
+		ASSERT_ALWAYS(buf == data)
+
+		// send reply from B to A
+		std::array<uint8_t, 5> reply = {{'r', 'e', 'p', 'l', 'y'}};
+		ASSERT_ALWAYS(sockB.send(utki::make_span(reply)) == reply.size())
+
+		std::array<uint8_t, 10> replyBuf;
+		size_t replyReceived = 0;
+		for(unsigned i = 0; i < 100 && replyReceived != reply.size(); ++i){
+			updateRelay();
+			replyReceived += sockA.recieve(utki::span<uint8_t>(&replyBuf[replyReceived], replyBuf.size() - replyReceived));
+		}
+		ASSERT_ALWAYS(replyReceived == reply.size())
+		ASSERT_ALWAYS(std::equal(reply.begin(), reply.end(), replyBuf.begin()))
+
+		// close A, the relay should propagate the half-close to B
+		sockA.close();
+
+		opros::wait_set wsB(1);
+		wsB.add(sockB, utki::make_flags({opros::ready::read}));
+
+		bool closed = false;
+		for(unsigned i = 0; i < 100 && !closed; ++i){
+			updateRelay();
+			if(wsB.wait(10) != 0 && sockB.flags().get(opros::ready::read)){
+				std::array<uint8_t, 1> b;
+				closed = sockB.recieve(utki::make_span(b)) == 0;
+			}
+		}
+		ASSERT_ALWAYS(closed)
+		wsB.remove(sockB);
+
+		ASSERT_ALWAYS(!relay.is_done())
+
+		// close B, the relay is done after that
+		sockB.close();
+
+		for(unsigned i = 0; i < 100 && !relay.is_done(); ++i){
+			updateRelay();
+		}
+		ASSERT_ALWAYS(relay.is_done())
+
+		ws.remove(sockRA);
+		ws.remove(sockRB);
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
+
+
+
+namespace BatchedAcceptTest{
+void Run(){
+	try{
+		setka::tcp_server_socket serverSock;
+		serverSock.open(13666, true);
+
+		// nothing to accept yet
+		{
+			std::array<setka::tcp_socket, 4> socks;
+			ASSERT_ALWAYS(serverSock.accept(utki::make_span(socks)) == 0)
+		}
+
+		const size_t numConnections = 5;
+
+		std::array<setka::tcp_socket, numConnections> clients;
+		for(auto& c : clients){
+			c.open(setka::address("127.0.0.1", 13666));
+		}
+
+		// give some time for the connections to establish
+		std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+		std::array<setka::tcp_socket, 8> accepted;
+
+		// accept at most 3 connections first
+		size_t numAccepted = serverSock.accept(utki::span<setka::tcp_socket>(accepted.data(), 3));
+		ASSERT_INFO_ALWAYS(numAccepted == 3, "numAccepted = " << numAccepted)
+
+		// accept the rest
+		size_t num = serverSock.accept(utki::span<setka::tcp_socket>(&accepted[numAccepted], accepted.size() - numAccepted));
+		ASSERT_INFO_ALWAYS(num == numConnections - numAccepted, "num = " << num)
+		numAccepted += num;
+
+		for(size_t i = 0; i != accepted.size(); ++i){
+			ASSERT_ALWAYS(accepted[i].is_open() == (i < numAccepted))
+		}
+
+		// accepted sockets are in non-blocking mode
+		for(size_t i = 0; i != numAccepted; ++i){
+			std::array<uint8_t, 4> buf;
+			ASSERT_ALWAYS(accepted[i].recieve(utki::make_span(buf)) == 0)
+		}
+
+		// check that data can be transferred over accepted connections
+		for(size_t i = 0; i != numAccepted; ++i){
+			std::array<uint8_t, 1> data = {{uint8_t(i)}};
+			ASSERT_ALWAYS(accepted[i].send(utki::make_span(data)) == 1)
+		}
+
+		std::set<uint8_t> received;
+		for(unsigned i = 0; i < 20 && received.size() != numConnections; ++i){
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			for(auto& c : clients){
+				std::array<uint8_t, 1> buf;
+				if(c.recieve(utki::make_span(buf)) == 1){
+					received.insert(buf[0]);
+				}
+			}
+		}
+		ASSERT_ALWAYS(received.size() == numConnections)
+
+		// nothing is accepted if some of the output sockets is opened
+		{
+			setka::tcp_socket client;
+			client.open(setka::address("127.0.0.1", 13666));
+			std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+			std::array<setka::tcp_socket, 2> socks;
+			socks[1] = std::move(accepted[0]);
+			try{
+				serverSock.accept(utki::make_span(socks));
+				ASSERT_ALWAYS(false)
+			}catch(std::logic_error&){}
+			ASSERT_ALWAYS(!socks[0].is_open())
+
+			ASSERT_ALWAYS(serverSock.accept(utki::span<setka::tcp_socket>(socks.data(), 1)) == 1)
+			ASSERT_ALWAYS(socks[0].is_open())
+		}
+
+#if M_OS == M_OS_LINUX
+		// accepting error is reported if nothing was accepted
+		{
+			// use up all the file descriptors, but one for the client
+			rlimit origLimit;
+			auto fds = useUpFileDescriptors(origLimit, 1);
+
+			setka::tcp_socket client;
+			client.open(setka::address("127.0.0.1", 13666));
+			std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+			std::array<setka::tcp_socket, 2> socks;
+			try{
+				serverSock.accept(utki::make_span(socks));
+				ASSERT_ALWAYS(false)
+			}catch(std::system_error& e){
+				ASSERT_INFO_ALWAYS(e.code() == std::errc::too_many_files_open, e.what())
+			}
+
+			releaseFileDescriptors(fds, origLimit);
+
+			// the pending connection is left in the queue
+			ASSERT_ALWAYS(serverSock.accept(utki::make_span(socks)) == 1)
+			ASSERT_ALWAYS(socks[0].is_open())
+		}
+#endif
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
+
+
+
+namespace ShardedListenersTest{
+void Run(){
+#if M_OS != M_OS_WINDOWS
+	try{
+		const size_t numListeners = 3;
+
+		auto listeners = setka::tcp_server_socket::open_sharded(numListeners, 0);
+		ASSERT_ALWAYS(listeners.size() == numListeners)
+
+		uint16_t port = listeners.front().get_local_port();
+		ASSERT_ALWAYS(port != 0)
+
+		for(auto& l : listeners){
+			ASSERT_ALWAYS(l.is_open())
+			ASSERT_ALWAYS(l.get_local_port() == port)
+		}
+
+#	if M_OS == M_OS_LINUX
+		ASSERT_ALWAYS(listeners.front().attach_cpu_steering(numListeners))
+#	endif
+
+		const size_t numConnections = 10;
+
+		std::array<setka::tcp_socket, numConnections> clients;
+		for(auto& c : clients){
+			c.open(setka::address("127.0.0.1", port));
+		}
+
+		// connections may be distributed among listeners in any way, but all of them should be accepted
+		std::vector<setka::tcp_socket> accepted;
+		for(unsigned i = 0; i < 20 && accepted.size() != numConnections; ++i){
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			for(auto& l : listeners){
+				std::array<setka::tcp_socket, numConnections> socks;
+				size_t num = l.accept(utki::make_span(socks));
+				for(size_t j = 0; j != num; ++j){
+					accepted.push_back(std::move(socks[j]));
+				}
+			}
+		}
+		ASSERT_INFO_ALWAYS(accepted.size() == numConnections, "accepted.size() = " << accepted.size())
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+#endif
+}
+}
+
+
+
+namespace BindToLocalAddressTest{
+void TestTCP(const char* localHost){
+	setka::tcp_server_socket serverSock;
+	serverSock.open(setka::address(localHost, 0));
+
+	uint16_t port = serverSock.get_local_port();
+	ASSERT_ALWAYS(port != 0)
+
+	setka::tcp_socket sockS;
+	sockS.open(setka::address(localHost, port));
+
+	setka::tcp_socket sockR;
+	for(unsigned i = 0; i < 20 && !sockR.is_open(); ++i){
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		sockR = serverSock.accept();
+	}
+	ASSERT_ALWAYS(sockR.is_open())
+
+	setka::address local = sockR.get_local_address();
+	ASSERT_ALWAYS(local.host == setka::address(localHost, 0).host)
+	ASSERT_ALWAYS(local.port == port)
+}
+
+void TestUDP(const char* localHost){
+	setka::udp_socket sockR;
+	sockR.open(setka::address(localHost, 0));
+
+	uint16_t port = sockR.get_local_port();
+	ASSERT_ALWAYS(port != 0)
+
+	setka::udp_socket sockS;
+	sockS.open();
+
+	std::array<uint8_t, 4> data = {{'t', 'e', 's', 't'}};
+
+	size_t bytesSent = 0;
+	for(unsigned i = 0; i < 10 && bytesSent == 0; ++i){
+		bytesSent = sockS.send(utki::make_span(data), setka::address(localHost, port));
+		if(bytesSent == 0){
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+	}
+	ASSERT_ALWAYS(bytesSent == data.size())
+
+	setka::address addr;
+	std::array<uint8_t, 16> buf;
+	size_t bytesReceived = 0;
+	for(unsigned i = 0; i < 10 && bytesReceived == 0; ++i){
+		bytesReceived = sockR.recieve(utki::make_span(buf), addr);
+		if(bytesReceived == 0){
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+	}
+	ASSERT_ALWAYS(bytesReceived == data.size())
+	ASSERT_ALWAYS(std::equal(data.begin(), data.end(), buf.begin()))
+	ASSERT_ALWAYS(addr.port == sockS.get_local_port())
+}
+
+void Run(){
+	try{
+		TestTCP("127.0.0.1");
+		TestUDP("127.0.0.1");
+
+		if(IsIPv6SupportedByOS()){
+			TestTCP("::1");
+			TestUDP("::1");
+		}
+
+		// any address of IPv4 family gives IPv4 only socket
+		{
+			setka::tcp_server_socket serverSock;
+			serverSock.open(setka::address("0.0.0.0", 0));
+			uint16_t port = serverSock.get_local_port();
+			ASSERT_ALWAYS(port != 0)
+
+			if(IsIPv6SupportedByOS()){
+				// IPv6 connection is not accepted
+				setka::tcp_socket sock;
+				sock.open(setka::address("::1", port));
+				std::this_thread::sleep_for(std::chrono::milliseconds(300));
+				ASSERT_ALWAYS(!serverSock.accept().is_open())
+			}
+		}
+
+		// any address of IPv6 family gives IPv6 only socket
+		if(IsIPv6SupportedByOS()){
+			setka::tcp_server_socket serverSock;
+			serverSock.open(setka::address("::", 0));
+			uint16_t port = serverSock.get_local_port();
+			ASSERT_ALWAYS(port != 0)
+
+			// IPv4 connection is not accepted
+			setka::tcp_socket sock;
+			sock.open(setka::address("127.0.0.1", port));
+			std::this_thread::sleep_for(std::chrono::milliseconds(300));
+			ASSERT_ALWAYS(!serverSock.accept().is_open())
+
+			// IPv4 datagram is not received
+			setka::udp_socket sockR;
+			sockR.open(setka::address("::", 13666));
+
+			setka::udp_socket sockS;
+			sockS.open(setka::address("0.0.0.0", 0));
+
+			std::array<uint8_t, 4> data = {{'t', 'e', 's', 't'}};
+			ASSERT_ALWAYS(sockS.send(utki::make_span(data), setka::address("127.0.0.1", 13666)) == data.size())
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(300));
+			std::array<uint8_t, 4> buf;
+			ASSERT_ALWAYS(sockR.recieve(utki::make_span(buf)) == 0)
+		}
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
+
+
+
+namespace DeferredAcceptTest{
+void Run(){
+	try{
+		setka::tcp_server_socket serverSock;
+		serverSock.open(13666);
+
+		bool deferred = serverSock.enable_defer_accept(5);
+#if M_OS == M_OS_LINUX
+		ASSERT_ALWAYS(deferred)
+#endif
+
+		setka::tcp_socket sockS;
+		sockS.open(setka::address("127.0.0.1", 13666));
+
+		std::array<uint8_t, 16> buf;
+		size_t firstDataSize;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+		setka::tcp_socket sockR;
+
+		if(deferred){
+			// no data sent yet, so the connection should not be accepted
+			sockR = serverSock.accept(utki::make_span(buf), firstDataSize);
+			ASSERT_ALWAYS(!sockR.is_open())
+			ASSERT_ALWAYS(firstDataSize == 0)
+		}
+
+		std::array<uint8_t, 5> data = {{'h', 'e', 'l', 'l', 'o'}};
+		ASSERT_ALWAYS(sockS.send(utki::make_span(data)) == data.size())
+
+		for(unsigned i = 0; i < 20 && !sockR.is_open(); ++i){
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			sockR = serverSock.accept(utki::make_span(buf), firstDataSize);
+		}
+		ASSERT_ALWAYS(sockR.is_open())
+
+		// receive the rest, in case the data was not received together with the connection
+		for(unsigned i = 0; i < 20 && firstDataSize != data.size(); ++i){
+			firstDataSize += sockR.recieve(utki::span<uint8_t>(&buf[firstDataSize], buf.size() - firstDataSize));
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+		ASSERT_INFO_ALWAYS(firstDataSize == data.size(), "firstDataSize = " << firstDataSize)
+		ASSERT_ALWAYS(std::equal(data.begin(), data.end(), buf.begin()))
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
+
+
+
+namespace FastOpenTest{
+void Run(){
+	try{
+		setka::tcp_server_socket serverSock;
+		serverSock.open(13666);
+
+		bool fastOpen = serverSock.enable_fast_open(16);
+#if M_OS == M_OS_LINUX
+		ASSERT_ALWAYS(fastOpen)
+#else
+		ASSERT_ALWAYS(!fastOpen)
+#endif
+
+		std::array<uint8_t, 7> data = {{'r', 'e', 'q', 'u', 'e', 's', 't'}};
+
+		// the first connection gets the Fast Open cookie, the second one may use it,
+		// in both cases all the data should be delivered
+		for(unsigned n = 0; n != 2; ++n){
+			setka::tcp_socket sockS;
+			size_t bytesSent = sockS.open(setka::address("127.0.0.1", 13666), utki::make_span(data));
+			ASSERT_ALWAYS(sockS.is_open())
+			ASSERT_ALWAYS(bytesSent <= data.size())
+
+			setka::tcp_socket sockR;
+			for(unsigned i = 0; i < 20 && !sockR.is_open(); ++i){
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+				sockR = serverSock.accept();
+			}
+			ASSERT_ALWAYS(sockR.is_open())
+
+			std::array<uint8_t, 16> buf;
+			size_t bytesReceived = 0;
+			for(unsigned i = 0; i < 20 && bytesReceived != data.size(); ++i){
+				if(bytesSent != data.size()){
+					bytesSent += sockS.send(utki::span<uint8_t>(&data[bytesSent], data.size() - bytesSent));
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+				bytesReceived += sockR.recieve(utki::span<uint8_t>(&buf[bytesReceived], buf.size() - bytesReceived));
+			}
+			ASSERT_INFO_ALWAYS(bytesReceived == data.size(), "bytesReceived = " << bytesReceived)
+			ASSERT_ALWAYS(std::equal(data.begin(), data.end(), buf.begin()))
+		}
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
+
+
+
+namespace ConnectionStateTest{
+setka::tcp_socket::connection_state WaitForConnection(setka::tcp_socket& sock){
+	opros::wait_set ws(1);
+	ws.add(sock, utki::make_flags({opros::ready::write}));
+
+	for(unsigned i = 0; i < 20 && sock.get_connection_state() == setka::tcp_socket::connection_state::pending; ++i){
+		ws.wait(100);
+	}
+
+	ws.remove(sock);
+
+	return sock.get_connection_state();
+}
+
+void Run(){
+	try{
+		// successful connection
+		{
+			setka::tcp_server_socket serverSock;
+			serverSock.open(13666);
+
+			setka::tcp_socket sock;
+			sock.open(setka::address("127.0.0.1", 13666));
+
+			ASSERT_ALWAYS(WaitForConnection(sock) == setka::tcp_socket::connection_state::connected)
+			ASSERT_ALWAYS(!sock.get_connection_error())
+
+			// accepted socket is connected
+			setka::tcp_socket sockR = serverSock.accept();
+			ASSERT_ALWAYS(sockR.is_open())
+			ASSERT_ALWAYS(sockR.get_connection_state() == setka::tcp_socket::connection_state::connected)
+		}
+
+		// connection refused, nobody listens on the port
+		{
+			setka::tcp_socket sock;
+			sock.open(setka::address("127.0.0.1", 13666));
+
+			ASSERT_ALWAYS(WaitForConnection(sock) == setka::tcp_socket::connection_state::failed)
+			ASSERT_INFO_ALWAYS(
+					sock.get_connection_error() == std::errc::connection_refused,
+					"error = " << sock.get_connection_error().message()
+				)
+		}
+
+		// connection timeout
+		{
+			setka::tcp_server_socket serverSock;
+			serverSock.open(13666);
+
+			setka::tcp_socket sock;
+			sock.open(setka::address("127.0.0.1", 13666));
+			ASSERT_ALWAYS(sock.get_time_to_connect_deadline() == std::numeric_limits<uint32_t>::max())
+
+			sock.set_connect_timeout(1000);
+			ASSERT_ALWAYS(sock.get_time_to_connect_deadline() <= 1000)
+
+			sock.set_connect_timeout(0);
+			ASSERT_ALWAYS(sock.get_time_to_connect_deadline() == 0)
+
+			// the socket was not waited for, so the connection is not known to be established and the timeout has expired
+			ASSERT_ALWAYS(sock.get_connection_state() == setka::tcp_socket::connection_state::failed)
+			ASSERT_ALWAYS(sock.get_connection_error() == std::errc::timed_out)
+
+			// the connection request is aborted, so the connection is not usable even if it was established meanwhile
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			std::array<uint8_t, 4> data = {{'t', 'e', 's', 't'}};
+			try{
+				sock.send(utki::make_span(data));
+				ASSERT_ALWAYS(false)
+			}catch(std::system_error&){}
+		}
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
+
+
+
+namespace ConnectorTest{
+void WaitForConnector(opros::wait_set& ws, setka::tcp_connector& connector){
+	for(unsigned i = 0; i < 50; ++i){
+		uint32_t timeout = connector.update();
+		if(connector.get_state() != setka::tcp_connector::state::in_progress){
+			return;
+		}
+		ws.wait(std::min(timeout, uint32_t(100)));
+	}
+}
+
+void Run(){
+	try{
+		// nobody listens on IPv6 loopback, so IPv6 attempt fails and IPv4 one succeeds
+		{
+			setka::tcp_server_socket serverSock;
+			serverSock.open(setka::address("127.0.0.1", 13666));
+
+			opros::wait_set ws(4);
+
+			setka::tcp_connector connector(ws, 100);
+
+			const std::array<setka::address, 2> candidates = {{
+				setka::address("::1", 13666),
+				setka::address("127.0.0.1", 13666)
+			}};
+
+			connector.connect(utki::make_span(candidates));
+			ASSERT_ALWAYS(connector.get_state() == setka::tcp_connector::state::in_progress)
+
+			WaitForConnector(ws, connector);
+
+			ASSERT_INFO_ALWAYS(
+					connector.get_state() == setka::tcp_connector::state::connected,
+					"error = " << connector.get_error().message()
+				)
+
+			setka::tcp_socket sock = connector.get_socket();
+			ASSERT_ALWAYS(sock.is_open())
+			ASSERT_ALWAYS(connector.get_state() == setka::tcp_connector::state::idle)
+			ASSERT_ALWAYS(sock.get_remote_address() == setka::address("127.0.0.1", 13666))
+
+			setka::tcp_socket sockR = serverSock.accept();
+			ASSERT_ALWAYS(sockR.is_open())
+		}
+
+		// all attempts fail
+		{
+			opros::wait_set ws(4);
+
+			setka::tcp_connector connector(ws, 100);
+
+			const std::array<setka::address, 2> candidates = {{
+				setka::address("::1", 13666),
+				setka::address("127.0.0.1", 13666)
+			}};
+
+			connector.connect(utki::make_span(candidates));
+
+			WaitForConnector(ws, connector);
+
+			ASSERT_ALWAYS(connector.get_state() == setka::tcp_connector::state::failed)
+			ASSERT_ALWAYS(connector.get_error())
+		}
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
+
+
+
+namespace ErrorCodeTest{
+void Run(){
+	try{
+		std::array<uint8_t, 4> data = {{'t', 'e', 's', 't'}};
+
+		// closed sockets report error without throwing
+		{
+			std::error_code ec;
+
+			setka::tcp_socket tcpSock;
+			ASSERT_ALWAYS(tcpSock.send(utki::make_span(data), ec) == 0)
+			ASSERT_ALWAYS(ec == std::errc::bad_file_descriptor)
+			ASSERT_ALWAYS(tcpSock.recieve(utki::make_span(data), ec) == 0)
+			ASSERT_ALWAYS(ec == std::errc::bad_file_descriptor)
+
+			setka::udp_socket udpSock;
+			ASSERT_ALWAYS(udpSock.send(utki::make_span(data), setka::address("127.0.0.1", 13666), ec) == 0)
+			ASSERT_ALWAYS(ec == std::errc::bad_file_descriptor)
+			setka::address sender;
+			ASSERT_ALWAYS(udpSock.recieve(utki::make_span(data), sender, ec) == 0)
+			ASSERT_ALWAYS(ec == std::errc::bad_file_descriptor)
+
+			setka::tcp_server_socket serverSock;
+			ASSERT_ALWAYS(!serverSock.accept(ec).is_open())
+			ASSERT_ALWAYS(ec == std::errc::bad_file_descriptor)
+		}
+
+		// sending to the connection closed by peer
+		{
+			setka::tcp_server_socket serverSock;
+			serverSock.open(13666);
+
+			setka::tcp_socket sock;
+			sock.open(setka::address("127.0.0.1", 13666));
+
+			setka::tcp_socket sockR;
+			for(unsigned i = 0; i < 20 && !sockR.is_open(); ++i){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				sockR = serverSock.accept();
+			}
+			ASSERT_ALWAYS(sockR.is_open())
+
+			std::error_code ec;
+
+			// no data available
+			ASSERT_ALWAYS(sock.recieve(utki::make_span(data), ec) == 0)
+			ASSERT_ALWAYS(!ec)
+
+			// no connections pending
+			ASSERT_ALWAYS(!serverSock.accept(ec).is_open())
+			ASSERT_ALWAYS(!ec)
+
+			sockR.close();
+
+			// first sending succeeds and peer responds with reset, following sending fails
+			for(unsigned i = 0; i < 20; ++i){
+				sock.send(utki::make_span(data), ec);
+				if(ec){
+					break;
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+			ASSERT_INFO_ALWAYS(
+					ec == std::errc::broken_pipe || ec == std::errc::connection_reset,
+					"error = " << ec.message()
+				)
+
+			// throwing version reports the same error
+			bool thrown = false;
+			try{
+				sock.send(utki::make_span(data));
+			}catch(std::system_error&){
+				thrown = true;
+			}
+			ASSERT_ALWAYS(thrown)
+		}
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
+
+
+
+namespace TCPStatsTest{
+void Run(){
+	try{
+		setka::tcp_server_socket serverSock;
+		serverSock.open(13666);
+
+		std::array<setka::tcp_socket, 3> socks;
+		socks[0].open(setka::address("127.0.0.1", 13666));
+		socks[1].open(setka::address("127.0.0.1", 13666));
+		// socks[2] is left closed
+
+		setka::tcp_socket sockR;
+		for(unsigned i = 0; i < 20 && !sockR.is_open(); ++i){
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			sockR = serverSock.accept();
+		}
+		ASSERT_ALWAYS(sockR.is_open())
+
+		std::array<uint8_t, 4> data = {{'t', 'e', 's', 't'}};
+		ASSERT_ALWAYS(socks[0].send(utki::make_span(data)) == data.size())
+
+		std::array<setka::tcp_socket::stats, 4> stats;
+
+		try{
+			stats[0] = socks[0].get_stats();
+		}catch(std::system_error& e){
+			if(e.code() == std::errc::not_supported){
+				TRACE_ALWAYS(<< "TCP connection statistics are not supported by OS, skip the test" << std::endl)
+				return;
+			}
+			throw;
+		}
+		ASSERT_ALWAYS(stats[0].mss != 0)
+		ASSERT_ALWAYS(stats[0].congestion_window != 0)
+
+		// null pointers get zero statistics like closed sockets
+		std::array<const setka::tcp_socket*, 4> sockPtrs = {{&socks[0], &socks[1], &socks[2], nullptr}};
+		stats[3].mss = 1;
+		ASSERT_ALWAYS(setka::tcp_socket::get_stats(utki::make_span(sockPtrs), utki::make_span(stats)) == 2)
+		ASSERT_ALWAYS(stats[0].mss != 0)
+		ASSERT_ALWAYS(stats[1].mss != 0)
+		ASSERT_ALWAYS(stats[2].mss == 0)
+		ASSERT_ALWAYS(stats[2].congestion_window == 0)
+		ASSERT_ALWAYS(stats[3].mss == 0)
+
+		// output array shorter than the sockets array
+		stats[1] = setka::tcp_socket::stats();
+		ASSERT_ALWAYS(setka::tcp_socket::get_stats(utki::make_span(sockPtrs), utki::make_span(stats.data(), 1)) == 1)
+		ASSERT_ALWAYS(stats[1].mss == 0)
+
+		// closed socket
+		bool thrown = false;
+		try{
+			socks[2].get_stats();
+		}catch(std::system_error&){
+			thrown = true;
+		}
+		ASSERT_ALWAYS(thrown)
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
+
+
+
+namespace SocketOptionsTest{
+void Run(){
+	try{
+		setka::socket_options options;
+		options.send_buffer_size = 0x10000;
+		options.recieve_buffer_size = 0x10000;
+		options.type_of_service = 0x10;
+		options.keepalive = true;
+		options.keepalive_interval_s = 10;
+		options.keepalive_count = 3;
+
+		setka::tcp_server_socket serverSock;
+		serverSock.open(13666, false, 50, false, options);
+
+		setka::tcp_socket sock;
+		sock.open(setka::address("127.0.0.1", 13666), false, options);
+
+		setka::tcp_socket sockR;
+		for(unsigned i = 0; i < 20 && !sockR.is_open(); ++i){
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			sockR = serverSock.accept();
+		}
+		ASSERT_ALWAYS(sockR.is_open())
+
+		// set options on opened socket, only the options which have value are set
+		{
+			setka::socket_options o;
+			o.recieve_low_watermark = 1;
+			sockR.set_options(o);
+		}
+
+		// invalid option value
+		{
+			setka::socket_options o;
+			o.keepalive_count = -1;
+
+			bool thrown = false;
+			try{
+				sock.set_options(o);
+			}catch(std::system_error&){
+				thrown = true;
+			}
+			ASSERT_ALWAYS(thrown)
+		}
+
+		// UDP socket
+		{
+			setka::socket_options o;
+			o.recieve_buffer_size = 0x10000;
+			o.type_of_service = 0x10;
+
+			setka::udp_socket udpSock;
+			udpSock.open(0, o);
+			ASSERT_ALWAYS(udpSock.is_open())
+		}
+
+		// closed socket
+		{
+			setka::tcp_socket s;
+			bool thrown = false;
+			try{
+				s.set_options(options);
+			}catch(std::logic_error&){
+				thrown = true;
+			}
+			ASSERT_ALWAYS(thrown)
+		}
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
+
+
+
+namespace ReactorTest{
+void Run(){
+	try{
+		setka::reactor reactor;
+
+		setka::tcp_server_socket serverSock;
+		serverSock.open(13666);
+
+		std::list<setka::tcp_socket> conns;
+		size_t numReceived = 0;
+
+		reactor.add(serverSock, [&](){
+			for(;;){
+				setka::tcp_socket s = serverSock.accept();
+				if(!s.is_open()){
+					return true;
+				}
+				conns.push_back(std::move(s));
+				setka::tcp_socket& c = conns.back();
+
+				// read one byte per call to check that the reactor calls the handler again
+				// while it reports that the socket can still be ready
+				reactor.add(c, [&c, &numReceived](){
+					std::array<uint8_t, 1> buf;
+					if(c.recieve(utki::make_span(buf)) == 0){
+						return true;
+					}
+					++numReceived;
+					return false;
+				});
+			}
+		});
+
+		std::array<uint8_t, 4> data = {{'t', 'e', 's', 't'}};
+
+		std::array<setka::tcp_socket, 3> clients;
+		size_t numSent = 0;
+
+		for(auto& c : clients){
+			c.open(setka::address("127.0.0.1", 13666));
+
+			reactor.add(
+					c,
+					nullptr,
+					[&c, &reactor, &data, &numSent](){
+						ASSERT_ALWAYS(c.get_connection_state() == setka::tcp_socket::connection_state::connected)
+						numSent += c.send(utki::make_span(data));
+
+						// socket can be removed from within its handler
+						reactor.remove(c);
+						return true;
+					},
+					true
+				);
+		}
+
+		ASSERT_ALWAYS(reactor.size() == 1 + clients.size())
+
+		for(unsigned i = 0; i != 50 && numReceived != data.size() * clients.size(); ++i){
+			reactor.run_once(100);
+		}
+
+		ASSERT_INFO_ALWAYS(numSent == data.size() * clients.size(), "numSent = " << numSent)
+		ASSERT_INFO_ALWAYS(numReceived == data.size() * clients.size(), "numReceived = " << numReceived)
+		ASSERT_ALWAYS(conns.size() == clients.size())
+		ASSERT_ALWAYS(reactor.size() == 1 + conns.size())
+
+		for(auto& c : conns){
+			reactor.remove(c);
+		}
+		reactor.remove(serverSock);
+		ASSERT_ALWAYS(reactor.size() == 0)
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
+
+
+
+namespace IoRingTest{
+#if M_OS == M_OS_LINUX
+// waits until the expected number of completions is retrieved
+void waitCompletions(setka::io_ring& ring, utki::span<setka::io_ring::completion> completions){
+	opros::wait_set ws(1);
+	ws.add(ring, utki::make_flags({opros::ready::read}));
+
+	size_t num = 0;
+	for(unsigned i = 0; i != 50 && num != completions.size(); ++i){
+		ws.wait(100);
+		num += ring.get_completions(utki::make_span(completions.data() + num, completions.size() - num));
+	}
+
+	ws.remove(ring);
+	ASSERT_INFO_ALWAYS(num == completions.size(), "num = " << num)
+}
+
+void run(bool use_io_uring){
+	setka::io_ring ring(16, use_io_uring);
+
+	// TCP
+	{
+		setka::tcp_server_socket serverSock;
+		serverSock.open(13666);
+
+		setka::tcp_socket sockS;
+
+		ASSERT_ALWAYS(ring.accept(serverSock, 1))
+		ASSERT_ALWAYS(ring.connect(sockS, setka::address("127.0.0.1", 13666), 2))
+		ASSERT_ALWAYS(sockS.is_open())
+		ring.submit();
+
+		std::array<setka::io_ring::completion, 2> completions;
+		waitCompletions(ring, utki::make_span(completions));
+
+		setka::tcp_socket sockR;
+		for(auto& c : completions){
+			ASSERT_INFO_ALWAYS(!c.error, c.error.message())
+			if(c.user_data == 1){
+				ASSERT_ALWAYS(c.op == setka::io_ring::operation::accept)
+				ASSERT_ALWAYS(c.accepted.is_open())
+				sockR = std::move(c.accepted);
+			}else{
+				ASSERT_ALWAYS(c.user_data == 2)
+				ASSERT_ALWAYS(c.op == setka::io_ring::operation::connect)
+			}
+		}
+		ASSERT_ALWAYS(sockR.is_open())
+		ASSERT_ALWAYS(sockS.get_connection_state() == setka::tcp_socket::connection_state::connected)
+
+		if(ring.is_io_uring()){
+			std::array<setka::socket*, 2> socks = {{&sockS, &sockR}};
+			ASSERT_ALWAYS(ring.register_sockets(utki::make_span(socks)))
+		}
+
+		std::array<uint8_t, 4> data = {{'t', 'e', 's', 't'}};
+		std::array<uint8_t, 4> buf;
+
+		// start receiving before sending to check that the operation waits for the data
+		ASSERT_ALWAYS(ring.recieve(sockR, utki::make_span(buf), 3))
+		ring.submit();
+		ASSERT_ALWAYS(ring.send(sockS, utki::make_span(data), 4))
+		ring.submit();
+
+		waitCompletions(ring, utki::make_span(completions));
+
+		for(auto& c : completions){
+			ASSERT_INFO_ALWAYS(!c.error, c.error.message())
+			ASSERT_ALWAYS(c.user_data == 3 || c.user_data == 4)
+			ASSERT_INFO_ALWAYS(c.num_bytes == data.size(), "c.num_bytes = " << c.num_bytes)
+		}
+		ASSERT_ALWAYS(buf == data)
+
+		ring.unregister_sockets();
+	}
+
+	// UDP
+	{
+		setka::udp_socket sendSock;
+		sendSock.open();
+
+		setka::udp_socket recvSock;
+		recvSock.open(13666);
+
+		std::array<uint8_t, 4> data = {{'t', 'e', 's', 't'}};
+		std::array<uint8_t, 8> buf;
+		setka::native_address sender;
+
+		ASSERT_ALWAYS(ring.recieve(recvSock, utki::make_span(buf), sender, 5))
+		ASSERT_ALWAYS(ring.send(sendSock, utki::make_span(data), setka::native_address(setka::address("127.0.0.1", 13666)), 6))
+		ring.submit();
+
+		std::array<setka::io_ring::completion, 2> completions;
+		waitCompletions(ring, utki::make_span(completions));
+
+		for(auto& c : completions){
+			ASSERT_INFO_ALWAYS(!c.error, c.error.message())
+			ASSERT_INFO_ALWAYS(c.num_bytes == data.size(), "c.num_bytes = " << c.num_bytes)
+			if(c.user_data == 5){
+				ASSERT_ALWAYS(c.op == setka::io_ring::operation::recieve_from)
+			}else{
+				ASSERT_ALWAYS(c.user_data == 6)
+				ASSERT_ALWAYS(c.op == setka::io_ring::operation::send_to)
+			}
+		}
+		ASSERT_ALWAYS(std::equal(data.begin(), data.end(), buf.begin()))
+		ASSERT_ALWAYS(sender.to_address().host.get_v4() == 0x7f000001)
+	}
+
+	// connection refused
+	{
+		setka::tcp_socket sock;
+		ASSERT_ALWAYS(ring.connect(sock, setka::address("127.0.0.1", 13667), 7))
+		ring.submit();
+
+		std::array<setka::io_ring::completion, 1> completions;
+		waitCompletions(ring, utki::make_span(completions));
+
+		ASSERT_ALWAYS(completions[0].error == std::errc::connection_refused)
+		ASSERT_ALWAYS(sock.get_connection_state() == setka::tcp_socket::connection_state::failed)
+	}
+
+	// cancelling receiving from idle connection
+	{
+		setka::tcp_server_socket serverSock;
+		serverSock.open(13666);
+
+		setka::tcp_socket sockS;
+		sockS.open(setka::address("127.0.0.1", 13666));
+
+		setka::tcp_socket sockR;
+		for(unsigned i = 0; i != 20 && !sockR.is_open(); ++i){
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			sockR = serverSock.accept();
+		}
+		ASSERT_ALWAYS(sockR.is_open())
+
+		std::array<uint8_t, 4> buf;
+
+		ASSERT_ALWAYS(ring.recieve(sockR, utki::make_span(buf), 8))
+		ring.submit();
+
+		ASSERT_ALWAYS(!ring.cancel(9))
+		ASSERT_ALWAYS(ring.cancel(8))
+
+		std::array<setka::io_ring::completion, 1> completions;
+		waitCompletions(ring, utki::make_span(completions));
+
+		ASSERT_ALWAYS(completions[0].user_data == 8)
+		ASSERT_INFO_ALWAYS(completions[0].error == std::errc::operation_canceled, completions[0].error.message())
+		ASSERT_ALWAYS(!ring.cancel(8))
+
+		// destroying the io_ring cancels the operations in progress
+		{
+			setka::io_ring otherRing(2, use_io_uring);
+			ASSERT_ALWAYS(otherRing.recieve(sockR, utki::make_span(buf), 10))
+			ASSERT_ALWAYS(otherRing.accept(serverSock, 11))
+			otherRing.submit();
+		}
+	}
+
+	// more operations than the submission queue size
+	{
+		setka::io_ring smallRing(2, use_io_uring);
+
+		setka::udp_socket sendSock;
+		sendSock.open();
+
+		setka::udp_socket recvSock;
+		recvSock.open(13666);
+
+		const unsigned numOps = 4;
+
+		std::array<std::array<uint8_t, 8>, numOps> bufs;
+		std::array<setka::native_address, numOps> senders;
+
+		for(unsigned round = 0; round != 2; ++round){
+			// the submission queue is submitted when it gets full
+			for(unsigned i = 0; i != numOps; ++i){
+				ASSERT_ALWAYS(smallRing.recieve(recvSock, utki::make_span(bufs[i]), senders[i], i))
+			}
+
+			// all operations are in progress
+			std::array<uint8_t, 8> extraBuf;
+			setka::native_address extraSender;
+			ASSERT_ALWAYS(!smallRing.recieve(recvSock, utki::make_span(extraBuf), extraSender, numOps))
+
+			setka::tcp_socket sock;
+			ASSERT_ALWAYS(!smallRing.connect(sock, setka::address("127.0.0.1", 13667), numOps))
+			ASSERT_ALWAYS(!sock.is_open())
+
+			smallRing.submit();
+
+			std::array<uint8_t, 4> data = {{'t', 'e', 's', 't'}};
+			for(unsigned i = 0; i != numOps; ++i){
+				ASSERT_ALWAYS(sendSock.send(utki::make_span(data), setka::address("127.0.0.1", 13666)) == data.size())
+			}
+
+			// the operations are started again on the next round, so the slots must be released
+			std::array<setka::io_ring::completion, numOps> completions;
+			waitCompletions(smallRing, utki::make_span(completions));
+			for(auto& c : completions){
+				ASSERT_INFO_ALWAYS(!c.error, c.error.message())
+				ASSERT_ALWAYS(c.num_bytes == data.size())
+			}
+		}
+	}
+}
+#endif
+
+void Run(){
+#if M_OS == M_OS_LINUX
+	try{
+		run(true);
+		run(false);
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+#endif
+}
+}
+
+
+
+namespace EventLoopTest{
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+setka::task serve(setka::event_loop& loop, setka::tcp_server_socket& serverSock, size_t& numEchoed){
+	setka::tcp_socket conn = co_await loop.async_accept(serverSock);
+	loop.attach(conn);
+
+	std::array<uint8_t, 16> buf;
+	for(;;){
+		size_t n = co_await loop.async_recieve(conn, utki::make_span(buf));
+		if(n == 0){
+			break; // connection closed by peer
+		}
+		co_await loop.async_send_all(conn, utki::make_span(buf.data(), n));
+		numEchoed += n;
+	}
+
+	loop.detach(conn);
+}
+
+setka::task request(setka::event_loop& loop, bool& done){
+	setka::tcp_socket sock;
+	co_await loop.async_connect(sock, setka::address("127.0.0.1", 13666));
+
+	std::array<uint8_t, 4> data = {{'t', 'e', 's', 't'}};
+	co_await loop.async_send_all(sock, utki::make_span(data));
+
+	std::array<uint8_t, 4> buf;
+	size_t numReceived = 0;
+	while(numReceived != buf.size()){
+		size_t n = co_await loop.async_recieve(sock, utki::make_span(buf.data() + numReceived, buf.size() - numReceived));
+		ASSERT_ALWAYS(n != 0)
+		numReceived += n;
+	}
+	ASSERT_ALWAYS(buf == data)
+
+	loop.detach(sock);
+	done = true;
+}
+
+setka::task connectRefused(setka::event_loop& loop, bool& done){
+	setka::tcp_socket sock;
+	try{
+		co_await loop.async_connect(sock, setka::address("127.0.0.1", 13667));
+		ASSERT_ALWAYS(false)
+	}catch(std::system_error& e){
+		ASSERT_ALWAYS(e.code() == std::errc::connection_refused)
+	}
+	loop.detach(sock);
+	done = true;
+}
+
+setka::task acceptTimeout(setka::event_loop& loop, setka::tcp_server_socket& serverSock, bool& done){
+	co_await loop.async_sleep(10);
+
+	uint64_t start = setka::timer_wheel::get_ticks_ms();
+	try{
+		// nobody connects
+		co_await loop.async_accept(serverSock, 100);
+		ASSERT_ALWAYS(false)
+	}catch(std::system_error& e){
+		ASSERT_ALWAYS(e.code() == std::errc::timed_out)
+	}
+	ASSERT_ALWAYS(setka::timer_wheel::get_ticks_ms() - start >= 100)
+	done = true;
+}
+
+setka::task lookUp(setka::event_loop& loop, uint16_t dnsPort, bool& done){
+	std::string host = "setka.test";
+	setka::dns_lookup_result res = co_await loop.async_resolve(host, 2000, setka::address("127.0.0.1", dnsPort), setka::ip_version::v4);
+	ASSERT_INFO_ALWAYS(res.result == setka::dns_result::ok, "res.result = " << unsigned(res.result))
+	ASSERT_ALWAYS(res.ip.get_v4() == 0x7f000005)
+	done = true;
+}
+
+// answers any DNS query of record type A with 127.0.0.5
+bool answerDNSQuery(setka::udp_socket& dnsSock){
+	std::array<uint8_t, 512> buf;
+	setka::address sender;
+	size_t len = dnsSock.recieve(utki::make_span(buf), sender);
+	if(len == 0){
+		return true;
+	}
+	ASSERT_ALWAYS(len >= 12)
+
+	std::vector<uint8_t> reply(buf.begin(), buf.begin() + len);
+	reply[2] = 0x81; // response, recursion desired
+	reply[3] = 0x80; // recursion available, no error
+	reply[6] = 0; // one answer
+	reply[7] = 1;
+
+	const std::array<uint8_t, 16> answer = {{
+		0xc0, 0x0c, // reference to the host name in the question
+		0, 1, // type A
+		0, 1, // class IN
+		0, 0, 0, 60, // TTL
+		0, 4, // data length
+		127, 0, 0, 5
+	}};
+	reply.insert(reply.end(), answer.begin(), answer.end());
+
+	ASSERT_ALWAYS(dnsSock.send(utki::make_span(reply), sender) == reply.size())
+	return false;
+}
+#endif
+
+void Run(){
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+	try{
+		setka::event_loop loop;
+
+		setka::tcp_server_socket serverSock;
+		serverSock.open(13666);
+		loop.attach(serverSock);
+
+		setka::tcp_server_socket idleServerSock;
+		idleServerSock.open(13668);
+		loop.attach(idleServerSock);
+
+		// local stub DNS server
+		setka::udp_socket dnsSock;
+		dnsSock.open(13669);
+		loop.get_reactor().add(dnsSock, [&dnsSock](){
+			return answerDNSQuery(dnsSock);
+		});
+
+		size_t numEchoed = 0;
+		bool requestDone = false;
+		bool refusedDone = false;
+		bool timeoutDone = false;
+		bool lookUpDone = false;
+
+		auto serveTask = serve(loop, serverSock, numEchoed);
+		auto requestTask = request(loop, requestDone);
+		auto refusedTask = connectRefused(loop, refusedDone);
+		auto timeoutTask = acceptTimeout(loop, idleServerSock, timeoutDone);
+		auto lookUpTask = lookUp(loop, 13669, lookUpDone);
+
+		for(
+				unsigned i = 0;
+				i != 50 && !(serveTask.is_done() && requestTask.is_done() && refusedTask.is_done() && timeoutTask.is_done() && lookUpTask.is_done());
+				++i
+			)
+		{
+			loop.run_once(100);
+		}
+
+		serveTask.get();
+		requestTask.get();
+		refusedTask.get();
+		timeoutTask.get();
+		lookUpTask.get();
+
+		ASSERT_ALWAYS(requestDone)
+		ASSERT_ALWAYS(refusedDone)
+		ASSERT_ALWAYS(timeoutDone)
+		ASSERT_ALWAYS(lookUpDone)
+		ASSERT_INFO_ALWAYS(numEchoed == 4, "numEchoed = " << numEchoed)
+
+		loop.get_reactor().remove(dnsSock);
+		loop.detach(idleServerSock);
+		loop.detach(serverSock);
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+#endif
+}
+}
+
+
+
+namespace ReactorPoolTest{
+void Run(){
+	try{
+		setka::reactor_pool pool(2);
+		ASSERT_ALWAYS(pool.size() == 2)
+
+		// connections served by each worker, only accessed from the worker's thread
+		std::array<std::list<setka::tcp_socket>, 2> conns;
+
+		std::array<std::atomic<unsigned>, 2> numArrived;
+		for(auto& n : numArrived){
+			n.store(0);
+		}
+		std::atomic<unsigned> numMigrated(0);
+
+		setka::reactor_pool::connection_handler_type handler = [&](setka::tcp_socket&& s, unsigned w){
+			++numArrived[w];
+			conns[w].push_back(std::move(s));
+			setka::tcp_socket& c = conns[w].back();
+
+			pool.get_reactor(w).add(c, [&, w](){
+				// read one byte per call, so that the socket remains ready when migrated
+				std::array<uint8_t, 1> buf;
+				if(c.recieve(utki::make_span(buf)) == 0){
+					return true;
+				}
+				ASSERT_ALWAYS(c.send(utki::make_span(buf)) == 1)
+
+				if(buf[0] == 'm'){
+					// migration request, move the connection to the other worker
+					++numMigrated;
+					pool.migrate(c, w, 1 - w, handler);
+					return true;
+				}
+				return false;
+			});
+		};
+
+		setka::tcp_server_socket serverSock;
+		serverSock.open(13666);
+		pool.serve(serverSock, handler);
+
+		std::array<uint8_t, 5> data = {{'m', 't', 'e', 's', 't'}};
+
+		setka::reactor reactor;
+
+		std::array<setka::tcp_socket, 4> clients;
+		std::array<std::vector<uint8_t>, 4> received;
+
+		for(size_t i = 0; i != clients.size(); ++i){
+			auto& c = clients[i];
+			auto& r = received[i];
+			c.open(setka::address("127.0.0.1", 13666));
+
+			reactor.add(
+					c,
+					[&c, &r](){
+						std::array<uint8_t, 16> buf;
+						size_t n = c.recieve(utki::make_span(buf));
+						r.insert(r.end(), buf.begin(), buf.begin() + n);
+						return n == 0;
+					},
+					[&c, &reactor, &data](){
+						ASSERT_ALWAYS(c.get_connection_state() == setka::tcp_socket::connection_state::connected)
+						ASSERT_ALWAYS(c.send(utki::make_span(data)) == data.size())
+						reactor.set_write_interest(c, false);
+						return true;
+					},
+					true
+				);
+		}
+
+		auto isDone = [&](){
+			for(auto& r : received){
+				if(r.size() != data.size()){
+					return false;
+				}
+			}
+			return true;
+		};
+
+		for(unsigned i = 0; i != 50 && !isDone(); ++i){
+			reactor.run_once(100);
+		}
+
+		for(auto& r : received){
+			ASSERT_INFO_ALWAYS(r.size() == data.size(), "r.size() = " << r.size())
+			ASSERT_ALWAYS(std::equal(r.begin(), r.end(), data.begin()))
+		}
+
+		// round-robin distributes the accepted connections evenly, and each connection is migrated once
+		ASSERT_ALWAYS(numMigrated == clients.size())
+		ASSERT_INFO_ALWAYS(numArrived[0] == clients.size(), "numArrived[0] = " << numArrived[0])
+		ASSERT_INFO_ALWAYS(numArrived[1] == clients.size(), "numArrived[1] = " << numArrived[1])
+
+		for(auto& c : clients){
+			reactor.remove(c);
+		}
+
+		pool.unserve(serverSock);
+		for(unsigned w = 0; w != pool.size(); ++w){
+			pool.call(w, [&pool, &conns, w](){
+				for(auto& c : conns[w]){
+					pool.get_reactor(w).remove(c);
+				}
+				conns[w].clear();
+			});
+		}
+
+#if M_OS == M_OS_LINUX
+		// pending connection is accepted after accepting failed due to too many open files
+		{
+			std::atomic<unsigned> numAccepted(0);
+
+			setka::tcp_server_socket sock;
+			sock.open(13667);
+			pool.serve(sock, [&](setka::tcp_socket&& s, unsigned w){
+				++numAccepted;
+				conns[w].push_back(std::move(s));
+			});
+
+			// use up all the file descriptors, but one for the client
+			rlimit origLimit;
+			auto fds = useUpFileDescriptors(origLimit, 1);
+
+			setka::tcp_socket client;
+			client.open(setka::address("127.0.0.1", 13667));
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(300));
+			ASSERT_ALWAYS(numAccepted == 0)
+
+			releaseFileDescriptors(fds, origLimit);
+
+			// no new connections arrive, the pending one is accepted by retrying
+			for(unsigned i = 0; i != 20 && numAccepted == 0; ++i){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+			ASSERT_ALWAYS(numAccepted == 1)
+
+			pool.unserve(sock);
+			for(unsigned w = 0; w != pool.size(); ++w){
+				pool.call(w, [&conns, w](){
+					conns[w].clear();
+				});
+			}
+		}
+#endif
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
+
+
+
+namespace TimerWheelTest{
+void Run(){
+	try{
+		// start right before 2^32 milliseconds to check cascading through all the wheels
+		uint64_t start = (uint64_t(1) << 32) - 1000;
+		setka::timer_wheel wheel(start);
+
+		std::vector<unsigned> expired;
+		std::array<setka::timer, 5> timers;
+		for(unsigned i = 0; i != timers.size(); ++i){
+			timers[i].handler = [&expired, i](){
+				expired.push_back(i);
+			};
+		}
+
+		wheel.arm_at(timers[0], start + 10);
+		wheel.arm_at(timers[1], start + 300);
+		wheel.arm_at(timers[2], start + 70000);
+		wheel.arm_at(timers[3], start + (uint64_t(1) << 32) + 5);
+		wheel.arm_at(timers[4], start + 20);
+		ASSERT_ALWAYS(wheel.size() == 5)
+
+		wheel.disarm(timers[4]);
+		ASSERT_ALWAYS(!timers[4].is_armed())
+		ASSERT_ALWAYS(wheel.size() == 4)
+
+		ASSERT_INFO_ALWAYS(wheel.get_time_to_next_expiry(start) == 10, "time to next expiry = " << wheel.get_time_to_next_expiry(start))
+
+		ASSERT_ALWAYS(wheel.advance(start + 9) == 0)
+		ASSERT_ALWAYS(expired.empty())
+		ASSERT_ALWAYS(wheel.advance(start + 10) == 1)
+		ASSERT_ALWAYS(expired.size() == 1 && expired.back() == 0)
+		ASSERT_ALWAYS(!timers[0].is_armed())
+
+		ASSERT_ALWAYS(wheel.advance(start + 299) == 0)
+		ASSERT_ALWAYS(wheel.advance(start + 300) == 1)
+		ASSERT_ALWAYS(expired.back() == 1)
+
+		// re-arm the timer from within its handler
+		unsigned numPeriods = 0;
+		timers[1].handler = [&](){
+			++numPeriods;
+			wheel.arm_at(timers[1], timers[1].get_expiry_ms() + 1000);
+		};
+		wheel.arm_at(timers[1], start + 1000);
+
+		ASSERT_ALWAYS(wheel.advance(start + 69999) == 69)
+		ASSERT_ALWAYS(numPeriods == 69)
+		ASSERT_ALWAYS(wheel.advance(start + 70000) == 2)
+		ASSERT_ALWAYS(numPeriods == 70)
+		ASSERT_ALWAYS(expired.back() == 2)
+
+		wheel.disarm(timers[1]);
+		ASSERT_ALWAYS(wheel.size() == 1)
+
+		// the timer which expires later than the wheels span
+		ASSERT_ALWAYS(wheel.advance(start + (uint64_t(1) << 32) + 4) == 0)
+		ASSERT_ALWAYS(wheel.advance(start + (uint64_t(1) << 32) + 5) == 1)
+		ASSERT_ALWAYS(expired.back() == 3)
+		ASSERT_ALWAYS(wheel.size() == 0)
+		ASSERT_ALWAYS(wheel.get_time_to_next_expiry() == std::numeric_limits<uint32_t>::max())
+
+		// the timer armed in the past expires on the next millisecond
+		wheel.arm_at(timers[0], start);
+		ASSERT_ALWAYS(wheel.get_time_to_next_expiry(start + (uint64_t(1) << 32) + 6) == 0)
+		ASSERT_ALWAYS(wheel.advance(start + (uint64_t(1) << 32) + 6) == 1)
+		ASSERT_ALWAYS(expired.back() == 0)
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+
+	// reactor expires timers from within run_once()
+	try{
+		setka::reactor reactor;
+
+		bool expired = false;
+		setka::timer t([&expired](){
+			expired = true;
+		});
+
+		uint64_t start = setka::timer_wheel::get_ticks_ms();
+		reactor.get_timers().arm(t, 50);
+
+		for(unsigned i = 0; i != 10 && !expired; ++i){
+			reactor.run_once(1000);
+		}
+
+		ASSERT_ALWAYS(expired)
+		uint64_t elapsed = setka::timer_wheel::get_ticks_ms() - start;
+		ASSERT_INFO_ALWAYS(elapsed >= 50 && elapsed < 1000, "elapsed = " << elapsed)
+	}catch(std::exception& e){
+		ASSERT_INFO_ALWAYS(false, e.what())
+	}
+}
+}
@@ -49,3 +49,203 @@ namespace TestUDPSocketWaitForWriting{
 void Run();
 
 }//~namespace
+
+
+
+namespace BatchedUDPRecieveTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace BatchedUDPSendTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace SegmentedUDPSendTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace GROUDPRecieveTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace ConnectedUDPTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace NativeAddressTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace ZeroCopyTCPTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace VectoredTCPTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace SendFileTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace TCPRelayTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace BatchedAcceptTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace ShardedListenersTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace BindToLocalAddressTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace DeferredAcceptTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace FastOpenTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace ConnectionStateTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace ConnectorTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace ErrorCodeTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace TCPStatsTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace SocketOptionsTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace ReactorTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace IoRingTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace EventLoopTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace ReactorPoolTest{
+
+void Run();
+
+}//~namespace
+
+
+
+namespace TimerWheelTest{
+
+void Run();
+
+}//~namespace